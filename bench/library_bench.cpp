@@ -0,0 +1,632 @@
+#include "LibrarySystem.hpp"
+#include "TextFold.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <malloc.h>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+// Times LibrarySystem operations at several catalog sizes.
+//
+//   library_bench [--sizes 1000,10000,100000,1000000] [--min-time <secs>]
+//
+// Prints one tab-separated row per benchmark and size to standard output,
+// after a header row, so runs can be compared with diff or loaded into a
+// spreadsheet. Progress goes to standard error. Load, save, export and
+// teardown rows are per record; every other row is per call.
+
+// Counts every heap allocation made by the process, and the bytes in use.
+static std::atomic<uint64_t> allocationCount{0};
+static std::atomic<int64_t> liveBytes{0};
+
+void *operator new(size_t size) {
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  if (void *block = std::malloc(size ? size : 1)) {
+    liveBytes.fetch_add(malloc_usable_size(block), std::memory_order_relaxed);
+    return block;
+  }
+  throw std::bad_alloc();
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *block) noexcept {
+  if (block) {
+    liveBytes.fetch_sub(malloc_usable_size(block), std::memory_order_relaxed);
+  }
+  std::free(block);
+}
+void operator delete[](void *block) noexcept { operator delete(block); }
+void operator delete(void *block, size_t) noexcept { operator delete(block); }
+void operator delete[](void *block, size_t) noexcept {
+  operator delete(block);
+}
+
+// std::pmr::new_delete_resource() allocates through the aligned forms.
+void *operator new(size_t size, std::align_val_t alignment) {
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  size_t align = std::max(static_cast<size_t>(alignment), sizeof(void *));
+  void *block = nullptr;
+  if (posix_memalign(&block, align, size ? size : 1) == 0) {
+    liveBytes.fetch_add(malloc_usable_size(block), std::memory_order_relaxed);
+    return block;
+  }
+  throw std::bad_alloc();
+}
+void *operator new[](size_t size, std::align_val_t alignment) {
+  return operator new(size, alignment);
+}
+void operator delete(void *block, std::align_val_t) noexcept {
+  operator delete(block);
+}
+void operator delete[](void *block, std::align_val_t) noexcept {
+  operator delete(block);
+}
+void operator delete(void *block, size_t, std::align_val_t) noexcept {
+  operator delete(block);
+}
+void operator delete[](void *block, size_t, std::align_val_t) noexcept {
+  operator delete(block);
+}
+
+// Words titles are made of; searches query some of them.
+static const char *const titleWords[] = {
+    "Silent",  "River",   "Garden",  "Shadow",  "Winter",  "Golden",
+    "Empire",  "Secret",  "Journey", "Ocean",   "Forest",  "Letters",
+    "Night",   "Memory",  "Stone",   "Harbor",  "Crimson", "Paper",
+    "Mountain", "Glass",  "Storm",   "Island",  "Broken",  "Light",
+    "Ancient", "City",    "Dream",   "Fire",    "Hidden",  "Kingdom",
+    "Lost",    "Moon"};
+static const size_t titleWordCount = sizeof(titleWords) / sizeof(titleWords[0]);
+static const int categoryCount = 50;
+static const int loanDays = 60; // Loans are spread over this many days.
+
+struct Result {
+  std::string name;
+  size_t books;
+  uint64_t iterations;
+  double seconds;
+  uint64_t allocations;
+};
+
+// Heap bytes held by one way of storing the catalog.
+struct MemoryResult {
+  std::string structure;
+  size_t books;
+  int64_t bytes;
+};
+
+static std::vector<Result> results;
+static std::vector<MemoryResult> memoryResults;
+static double minSeconds = 0.2;
+
+// Records one measurement and reports progress.
+static void report(const std::string &name, size_t books, uint64_t iterations,
+                   double seconds, uint64_t allocations) {
+  results.push_back({name, books, iterations, seconds, allocations});
+  std::cerr << "  " << name << ": " << (seconds * 1e9 / iterations)
+            << " ns/op" << std::endl;
+}
+
+// Runs body(i) for growing iteration counts until one run lasts at least
+// minSeconds, then records that run.
+static void measure(const std::string &name, size_t books,
+                    const std::function<void(uint64_t)> &body) {
+  uint64_t iterations = 1;
+  while (true) {
+    uint64_t allocationsBefore = allocationCount.load();
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < iterations; ++i) {
+      body(i);
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    uint64_t allocations = allocationCount.load() - allocationsBefore;
+    if (elapsed.count() >= minSeconds || iterations >= (1ull << 32)) {
+      report(name, books, iterations, elapsed.count(), allocations);
+      return;
+    }
+    // Aim a little past minSeconds so the next run is usually the last.
+    double scale = elapsed.count() > 0
+                       ? minSeconds * 1.2 / elapsed.count()
+                       : 100.0;
+    iterations = static_cast<uint64_t>(iterations * std::min(scale, 100.0)) + 1;
+  }
+}
+
+// Times one call of body and records it as records operations.
+static void measureOnce(const std::string &name, size_t books,
+                        uint64_t records, const std::function<void()> &body) {
+  uint64_t allocationsBefore = allocationCount.load();
+  auto start = std::chrono::steady_clock::now();
+  body();
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  report(name, books, records, elapsed.count(),
+         allocationCount.load() - allocationsBefore);
+}
+
+// Edit distance between two words, ignoring ASCII case, by the textbook
+// dynamic program.
+static int plainEditDistance(std::string_view word, std::string_view other) {
+  auto lower = [](char c) {
+    return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+  };
+  std::vector<int> column(word.size() + 1);
+  for (size_t i = 0; i <= word.size(); ++i) {
+    column[i] = static_cast<int>(i);
+  }
+  for (size_t j = 0; j < other.size(); ++j) {
+    int diagonal = column[0];
+    column[0] = static_cast<int>(j + 1);
+    for (size_t i = 1; i <= word.size(); ++i) {
+      int above = column[i];
+      int substitution = diagonal + (lower(word[i - 1]) != lower(other[j]));
+      column[i] = std::min({column[i] + 1, column[i - 1] + 1, substitution});
+      diagonal = above;
+    }
+  }
+  return column[word.size()];
+}
+
+// Scores text against the query words the way fuzzySearchBooks does: the
+// total distance from each query word to the closest word of text, or -1
+// if some query word has none within its budget. The scan the fuzzy index
+// is compared against.
+static int plainFuzzyScore(const std::vector<std::string> &queryWords,
+                           std::string_view text) {
+  std::vector<std::string_view> words;
+  size_t pos = 0;
+  while (pos < text.size()) {
+    size_t end = text.find(' ', pos);
+    end = end == std::string_view::npos ? text.size() : end;
+    if (end > pos) {
+      words.push_back(text.substr(pos, end - pos));
+    }
+    pos = end + 1;
+  }
+  int total = 0;
+  for (const auto &query : queryWords) {
+    int best = INT_MAX;
+    for (auto word : words) {
+      best = std::min(best, plainEditDistance(query, word));
+    }
+    if (best > FuzzyIndex::defaultMaxEdits(query.size())) {
+      return -1;
+    }
+    total += best;
+  }
+  return total;
+}
+
+// Writes a deterministic catalog of bookCount books and bookCount / 4 users.
+// Every tenth book is on loan, with borrow dates spread over loanDays days.
+static void writeDataset(size_t bookCount, const std::string &booksFile,
+                         const std::string &usersFile) {
+  std::mt19937_64 random(bookCount);
+  size_t userCount = std::max<size_t>(bookCount / 4, 10);
+  size_t authorCount = std::max<size_t>(bookCount / 20, 1);
+  long long now = std::chrono::duration_cast<std::chrono::seconds>(
+                      std::chrono::system_clock::now().time_since_epoch())
+                      .count();
+
+  std::ofstream books(booksFile);
+  std::vector<std::string> loans(userCount);
+  for (size_t i = 0; i < bookCount; ++i) {
+    bool onLoan = i % 10 == 0;
+    books << 'B' << i << ',' << titleWords[random() % titleWordCount] << ' '
+          << titleWords[random() % titleWordCount] << ' '
+          << titleWords[random() % titleWordCount] << ",Author"
+          << random() % authorCount << ",Category"
+          << random() % categoryCount << ',' << 1900 + random() % 125 << ','
+          << (onLoan ? 0 : 1) << ',' << random() % 50 << '\n';
+    if (onLoan) {
+      std::string &userLoans = loans[(i / 10) % userCount];
+      if (!userLoans.empty()) {
+        userLoans += ';';
+      }
+      userLoans += 'B' + std::to_string(i) + '@' +
+                   std::to_string(now - static_cast<long long>(
+                                            random() % (loanDays * 86400)));
+    }
+  }
+
+  std::ofstream users(usersFile);
+  for (size_t i = 0; i < userCount; ++i) {
+    users << 'U' << i << ",User " << i << ",user" << i << "@example.com,0"
+          << 900000000 + i << ',' << loans[i] << '\n';
+  }
+}
+
+// Runs every benchmark against a catalog of bookCount books.
+static void runSize(size_t bookCount, const std::string &directory) {
+  std::cerr << bookCount << " books" << std::endl;
+  std::string booksFile = directory + "/books.txt";
+  std::string usersFile = directory + "/users.txt";
+  std::string savedFile = directory + "/saved.txt";
+  writeDataset(bookCount, booksFile, usersFile);
+
+  LibrarySystem library;
+  measureOnce("loadItemsFromFile/books", bookCount, bookCount,
+              [&] { library.loadItemsFromFile(booksFile, false); });
+  size_t userCount = std::max<size_t>(bookCount / 4, 10);
+  measureOnce("loadItemsFromFile/users", bookCount, userCount,
+              [&] { library.loadItemsFromFile(usersFile, true); });
+  measureOnce("saveItemsToFile/books", bookCount, bookCount,
+              [&] { library.saveItemsToFile(savedFile, false); });
+  measureOnce("saveItemsToFile/users", bookCount, userCount,
+              [&] { library.saveItemsToFile(savedFile, true); });
+
+  // Streaming the catalog out in each format.
+  for (const char *formatName : {"table", "csv", "jsonl"}) {
+    OutputFormat format;
+    parseOutputFormat(formatName, format);
+    measureOnce(std::string("exportListing/books/") + formatName, bookCount,
+                bookCount, [&] {
+                  std::ofstream out(savedFile, std::ios::binary);
+                  library.exportListing(Listing::Books, 0, out, format);
+                });
+  }
+
+  // Loading both files into a fresh library and destroying it again, with
+  // the items on the heap and in arenas.
+  for (StorageMode mode : {StorageMode::Heap, StorageMode::Arena}) {
+    std::string suffix = mode == StorageMode::Heap ? "/heap" : "/arena";
+    int64_t before = liveBytes.load();
+    auto scratch = std::make_unique<LibrarySystem>(mode);
+    measureOnce("load" + suffix, bookCount, bookCount + userCount, [&] {
+      scratch->loadItemsFromFile(booksFile, false);
+      scratch->loadItemsFromFile(usersFile, true);
+    });
+    memoryResults.push_back(
+        {"library" + suffix, bookCount, liveBytes.load() - before});
+    measureOnce("teardown" + suffix, bookCount, bookCount + userCount,
+                [&] { scratch.reset(); });
+  }
+
+  // Lookups cycle through a shuffled set of existing IDs.
+  std::mt19937_64 random(42);
+  const size_t keyCount = 4096;
+  std::vector<std::string> bookIds, userIds;
+  for (size_t i = 0; i < keyCount; ++i) {
+    bookIds.push_back('B' + std::to_string(random() % bookCount));
+    userIds.push_back('U' + std::to_string(random() % userCount));
+  }
+  size_t found = 0;
+  measure("findBookById", bookCount, [&](uint64_t i) {
+    found += library.findBookById(bookIds[i % keyCount]) != nullptr;
+  });
+  measure("findUserById", bookCount, [&](uint64_t i) {
+    found += library.findUserById(userIds[i % keyCount]) != nullptr;
+  });
+
+  std::vector<std::string> titleQueries, authorQueries, categoryQueries;
+  for (size_t i = 0; i < 64; ++i) {
+    titleQueries.push_back(titleWords[random() % titleWordCount]);
+    authorQueries.push_back("Author" +
+                            std::to_string(random() % (bookCount / 20 + 1)));
+    categoryQueries.push_back("Category" +
+                              std::to_string(random() % categoryCount));
+  }
+  // The title queries in lower case, for the case-insensitive search.
+  std::vector<std::string> lowerTitleQueries;
+  for (const auto &query : titleQueries) {
+    lowerTitleQueries.push_back(foldText(query));
+  }
+  measure("searchBooks/title", bookCount, [&](uint64_t i) {
+    found += library.searchBooks(titleQueries[i % 64], "title").size();
+  });
+  measure("searchBooks/title/normalized", bookCount, [&](uint64_t i) {
+    found += library
+                 .searchBooks(lowerTitleQueries[i % 64], "title",
+                              SearchMode::Normalized)
+                 .size();
+  });
+  measure("searchBooks/author", bookCount, [&](uint64_t i) {
+    found += library.searchBooks(authorQueries[i % 64], "author").size();
+  });
+  measure("searchBooks/category", bookCount, [&](uint64_t i) {
+    found += library.searchBooks(categoryQueries[i % 64], "category").size();
+  });
+  measure("getMostBorrowedBooks/10", bookCount, [&](uint64_t) {
+    found += library.getMostBorrowedBooks(10).size();
+  });
+  measure("getOverdueBooks/14", bookCount, [&](uint64_t) {
+    found += library.getOverdueBooks(14).size();
+  });
+
+  // Pairs of title words with two letters swapped in each, as a patron
+  // might type them, through the fuzzy index and through a scan that runs
+  // the textbook dynamic program on every title.
+  std::vector<std::vector<std::string>> typos;
+  for (size_t i = 0; i < 64; ++i) {
+    typos.push_back({titleQueries[i], titleQueries[(i + 1) % 64]});
+    for (auto &word : typos.back()) {
+      std::swap(word[1], word[2]);
+    }
+  }
+  measure("fuzzySearchBooks/title/top10", bookCount, [&](uint64_t i) {
+    const auto &words = typos[i % 64];
+    found += library.fuzzySearchBooks(words[0] + " " + words[1], "title", 10)
+                 .size();
+  });
+  measure("scan/fuzzy-dp/title/top10", bookCount, [&](uint64_t i) {
+    std::vector<std::pair<int, size_t>> best;
+    const auto &books = library.getBooks();
+    for (size_t doc = 0; doc < books.size(); ++doc) {
+      int distance = plainFuzzyScore(typos[i % 64], books[doc]->getTitleView());
+      if (distance >= 0) {
+        best.emplace_back(distance, doc);
+      }
+    }
+    size_t count = std::min<size_t>(best.size(), 10);
+    std::partial_sort(best.begin(), best.begin() + count, best.end());
+    found += count;
+  });
+  measure("fuzzySearchBooks/author/top10", bookCount, [&](uint64_t i) {
+    found += library.fuzzySearchBooks(authorQueries[i % 64].substr(1), "author",
+                                      10, 1)
+                 .size();
+  });
+
+  // Title prefixes of one, three and six letters, as a search box sends
+  // them while the patron types, through the completion index and through
+  // a scan that folds every title and totals the borrows of each distinct
+  // one that matches. The first call also sorts the entries added by the
+  // load.
+  const size_t prefixLengths[] = {1, 3, 6};
+  std::vector<std::string> prefixes[3];
+  for (size_t j = 0; j < 3; ++j) {
+    for (const auto &query : lowerTitleQueries) {
+      prefixes[j].push_back(query.substr(0, prefixLengths[j]));
+    }
+  }
+  measureOnce("completeBooks/title/first", bookCount, 1, [&] {
+    found += library.completeBooks(prefixes[2][0], "title", 10).size();
+  });
+  for (size_t j = 0; j < 3; ++j) {
+    measure("completeBooks/title/" + std::to_string(prefixLengths[j]),
+            bookCount, [&](uint64_t i) {
+              found +=
+                  library.completeBooks(prefixes[j][i % 64], "title", 10)
+                      .size();
+            });
+  }
+  measure("scan/prefix/title/6", bookCount, [&](uint64_t i) {
+    const std::string &prefix = prefixes[2][i % 64];
+    std::unordered_map<std::string_view, int64_t> borrows;
+    for (const auto &book : library.getBooks()) {
+      std::string_view key = book->getFoldedTitleView();
+      // The generated titles separate their words with single spaces.
+      for (size_t at = 0; at != std::string_view::npos;) {
+        if (key.compare(at, prefix.size(), prefix) == 0) {
+          borrows[book->getTitleView()] += book->getBorrowCount();
+          break;
+        }
+        at = key.find(' ', at);
+        at += at != std::string_view::npos;
+      }
+    }
+    std::vector<std::pair<int64_t, std::string_view>> best;
+    for (const auto &[title, count] : borrows) {
+      best.emplace_back(-count, title);
+    }
+    size_t count = std::min<size_t>(best.size(), 10);
+    std::partial_sort(best.begin(), best.begin() + count, best.end());
+    found += count;
+  });
+  measure("completeBooks/author/8", bookCount, [&](uint64_t i) {
+    found += library
+                 .completeBooks(authorQueries[i % 64].substr(0, 8), "author",
+                                10)
+                 .size();
+  });
+
+  // "Available books in one category from a 15-year span", answered from
+  // the attribute indexes and by scanning every book.
+  std::vector<BookFilter> filters(64);
+  for (auto &filter : filters) {
+    filter.category = "Category" + std::to_string(random() % categoryCount);
+    filter.yearFrom = 1900 + static_cast<int>(random() % 110);
+    filter.yearTo = *filter.yearFrom + 15;
+    filter.available = true;
+  }
+  measure("findBooks/category+years+available", bookCount, [&](uint64_t i) {
+    found += library.findBooks(filters[i % 64]).size();
+  });
+  measure("scan/category+years+available", bookCount, [&](uint64_t i) {
+    const BookFilter &filter = filters[i % 64];
+    for (const auto &book : library.getBooks()) {
+      found += book->getCategoryView() == *filter.category &&
+               book->getYear() >= *filter.yearFrom &&
+               book->getYear() <= *filter.yearTo && book->isAvailable();
+    }
+  });
+  // The same filters plus a title word, through the query planner, in
+  // full and stopping after the first ten results.
+  std::vector<BookQuery> queries(64);
+  for (size_t i = 0; i < queries.size(); ++i) {
+    std::string error;
+    parseBookQuery("title ~ " + titleQueries[i] + " and year >= " +
+                       std::to_string(*filters[i].yearFrom) +
+                       " and available = true",
+                   queries[i], error);
+  }
+  for (size_t limit : {SIZE_MAX, size_t(10)}) {
+    std::string name = limit == SIZE_MAX ? "queryBooks/title+years+available"
+                                         : "queryBooks/title+years+limit10";
+    measure(name, bookCount, [&](uint64_t i) {
+      BookQuery query = queries[i % 64];
+      query.limit = limit;
+      BookCursor cursor = library.queryBooks(query);
+      while (cursor.next()) {
+        ++found;
+      }
+    });
+  }
+  // Predicates most books pass, stopping after ten results: cheap only if
+  // the plan does not list every candidate first.
+  const std::pair<const char *, const char *> broadQueries[] = {
+      {"queryBooks/available+limit10", "available = true limit 10"},
+      {"queryBooks/years+limit10", "year >= 1900 limit 10"}};
+  for (const auto &broad : broadQueries) {
+    BookQuery query;
+    std::string error;
+    parseBookQuery(broad.second, query, error);
+    measure(broad.first, bookCount, [&](uint64_t) {
+      BookCursor cursor = library.queryBooks(query);
+      while (cursor.next()) {
+        ++found;
+      }
+    });
+  }
+  measure("countBooks/years+available", bookCount, [&](uint64_t i) {
+    BookFilter filter = filters[i % 64];
+    filter.category.reset();
+    found += library.countBooks(filter);
+  });
+  measure("getCategoryCounts", bookCount, [&](uint64_t) {
+    found += library.getCategoryCounts().size();
+  });
+  measure("getDecadeCounts", bookCount, [&](uint64_t) {
+    found += library.getDecadeCounts().size();
+  });
+
+  // Heap held by the books as Book objects versus as a CompactCatalog.
+  {
+    int64_t before = liveBytes.load();
+    std::vector<std::shared_ptr<Book>> copies;
+    copies.reserve(library.getBooks().size());
+    for (const auto &book : library.getBooks()) {
+      copies.push_back(std::make_shared<Book>(
+          book->getId(), book->getTitle(), book->getAuthor(),
+          book->getCategory(), book->getYear(), book->isAvailable()));
+    }
+    memoryResults.push_back({"book-objects", bookCount,
+                             liveBytes.load() - before});
+  }
+  int64_t compactBefore = liveBytes.load();
+  CompactCatalog compact = library.getCompactCatalog();
+  memoryResults.push_back({"compact-catalog", bookCount,
+                           liveBytes.load() - compactBefore});
+
+  std::vector<uint32_t> matches;
+  measure("CompactCatalog::search/title", bookCount, [&](uint64_t i) {
+    matches.clear();
+    compact.search(titleQueries[i % 64], CompactCatalog::Field::Title,
+                   matches);
+    found += matches.size();
+  });
+  measure("CompactCatalog::search/author", bookCount, [&](uint64_t i) {
+    matches.clear();
+    compact.search(authorQueries[i % 64], CompactCatalog::Field::Author,
+                   matches);
+    found += matches.size();
+  });
+  measure("CompactCatalog::search/category", bookCount, [&](uint64_t i) {
+    matches.clear();
+    compact.search(categoryQueries[i % 64], CompactCatalog::Field::Category,
+                   matches);
+    found += matches.size();
+  });
+
+  // Borrows and returns rounds of available books until both have run
+  // for minSeconds; every round leaves the catalog as it found it.
+  std::vector<std::pair<std::string, std::string>> loans;
+  for (size_t i = 1; i < bookCount && loans.size() < 100000; ++i) {
+    if (i % 10 != 0) {
+      loans.emplace_back('U' + std::to_string(i % userCount),
+                         'B' + std::to_string(i));
+    }
+  }
+  uint64_t rounds = 0;
+  double borrowSeconds = 0, returnSeconds = 0;
+  uint64_t borrowAllocations = 0, returnAllocations = 0;
+  while (borrowSeconds < minSeconds || returnSeconds < minSeconds) {
+    ++rounds;
+    uint64_t allocationsBefore = allocationCount.load();
+    auto start = std::chrono::steady_clock::now();
+    for (const auto &loan : loans) {
+      found += library.borrowBook(loan.first, loan.second);
+    }
+    auto middle = std::chrono::steady_clock::now();
+    uint64_t allocationsMiddle = allocationCount.load();
+    for (const auto &loan : loans) {
+      found += library.returnBook(loan.first, loan.second);
+    }
+    auto end = std::chrono::steady_clock::now();
+    borrowSeconds += std::chrono::duration<double>(middle - start).count();
+    returnSeconds += std::chrono::duration<double>(end - middle).count();
+    borrowAllocations += allocationsMiddle - allocationsBefore;
+    returnAllocations += allocationCount.load() - allocationsMiddle;
+  }
+  report("borrowBook", bookCount, rounds * loans.size(), borrowSeconds,
+         borrowAllocations);
+  report("returnBook", bookCount, rounds * loans.size(), returnSeconds,
+         returnAllocations);
+
+  if (found == 0) {
+    std::cerr << "Warning: no benchmark found anything" << std::endl;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  std::vector<size_t> sizes = {1000, 10000, 100000, 1000000};
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string option = argv[i];
+    if (option == "--sizes") {
+      sizes.clear();
+      std::stringstream list(argv[i + 1]);
+      std::string size;
+      while (std::getline(list, size, ',')) {
+        sizes.push_back(std::stoul(size));
+      }
+    } else if (option == "--min-time") {
+      minSeconds = std::stod(argv[i + 1]);
+    } else {
+      std::cerr << "Usage: library_bench [--sizes 1000,10000,...] "
+                   "[--min-time <secs>]\n";
+      return 1;
+    }
+  }
+
+  namespace fs = std::filesystem;
+  fs::path directory = fs::temp_directory_path() /
+                       ("library_bench." + std::to_string(getpid()));
+  fs::create_directories(directory);
+  for (size_t size : sizes) {
+    runSize(size, directory.string());
+  }
+  fs::remove_all(directory);
+
+  std::printf("benchmark\tbooks\titerations\tns_per_op\tallocs_per_op\t"
+              "ops_per_sec\n");
+  for (const auto &result : results) {
+    std::printf("%s\t%zu\t%llu\t%.1f\t%.2f\t%.0f\n", result.name.c_str(),
+                result.books,
+                static_cast<unsigned long long>(result.iterations),
+                result.seconds * 1e9 / result.iterations,
+                static_cast<double>(result.allocations) / result.iterations,
+                result.iterations / result.seconds);
+  }
+
+  std::printf("\nstructure\tbooks\tbytes\tbytes_per_book\n");
+  for (const auto &result : memoryResults) {
+    std::printf("%s\t%zu\t%lld\t%.1f\n", result.structure.c_str(),
+                result.books, static_cast<long long>(result.bytes),
+                static_cast<double>(result.bytes) / result.books);
+  }
+  return 0;
+}
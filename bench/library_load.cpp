@@ -0,0 +1,336 @@
+#include "LatencyHistogram.hpp"
+#include "LibrarySystem.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Drives a mixed workload against one in-memory LibrarySystem from many
+// threads, as a crowd of clerks would.
+//
+//   library_load [--threads 1,2,4,8] [--seconds 5] [--books N] [--users N]
+//                [--data <dir>] [--mix borrow,return,search,report]
+//
+// --data loads books.txt / users.txt from a directory (see library_datagen);
+// otherwise a catalog of --books books and --users users is generated. --mix
+// gives the relative weights of the four operations (default 40,30,25,5).
+//
+// For every thread count, prints tab-separated latency percentiles per
+// operation, overall throughput, and the time spent waiting on each library
+// lock. After each run, before the clerks return the books they still hold,
+// every book is checked to be lent to at most one user.
+
+enum Operation { Borrow, Return, Search, Report, OperationCount };
+static const char *const operationNames[] = {"borrow", "return", "search",
+                                             "report"};
+
+static const char *const titleWords[] = {
+    "Silent", "River",  "Garden",  "Shadow", "Winter", "Golden",  "Empire",
+    "Secret", "Ocean",  "Forest",  "Night",  "Memory", "Stone",   "Harbor",
+    "Paper",  "Glass",  "Storm",   "Island", "Light",  "Ancient", "City",
+    "Dream",  "Fire",   "Kingdom", "Moon",   "Letters"};
+static const size_t titleWordCount = sizeof(titleWords) / sizeof(titleWords[0]);
+
+struct Settings {
+  std::vector<size_t> threadCounts = {1, 2, 4, 8};
+  double seconds = 5;
+  size_t books = 100000;
+  size_t users = 25000;
+  std::string dataDirectory;
+  std::array<unsigned, OperationCount> mix = {40, 30, 25, 5};
+};
+
+// What one thread measured, and the loans it still holds at the end.
+struct ThreadResult {
+  std::array<LatencyHistogram, OperationCount> latency;
+  std::vector<std::pair<std::string, std::string>> held;
+};
+
+// Fills the library with a generated catalog.
+static void generateCatalog(LibrarySystem &library, const Settings &settings) {
+  std::mt19937_64 random(7);
+  for (size_t i = 0; i < settings.books; ++i) {
+    std::string title = std::string(titleWords[random() % titleWordCount]) +
+                        ' ' + titleWords[random() % titleWordCount];
+    library.addItem(library.createBook(
+        'B' + std::to_string(i), title,
+        "Author" + std::to_string(random() % (settings.books / 20 + 1)),
+        "Category" + std::to_string(random() % 50),
+        static_cast<int>(1900 + random() % 125), true));
+  }
+  for (size_t i = 0; i < settings.users; ++i) {
+    std::string id = std::to_string(i);
+    library.addItem(library.createUser('U' + id, "User " + id,
+                                       "user" + id + "@example.com",
+                                       "0900000000"));
+  }
+}
+
+// Runs the mix until stop is set. Books this thread borrowed are returned
+// by its own return operations; the rest are left in result.held for the
+// invariant check and handed back afterwards.
+static void runClerk(LibrarySystem &library, const Settings &settings,
+                     unsigned seed, const std::atomic<bool> &stop,
+                     ThreadResult &result) {
+  const auto &books = library.getBooks();
+  const auto &users = library.getUsers();
+  std::mt19937_64 random(seed);
+  unsigned totalWeight = 0;
+  for (unsigned weight : settings.mix) {
+    totalWeight += weight;
+  }
+
+  auto &held = result.held;
+  while (!stop.load(std::memory_order_relaxed)) {
+    unsigned pick = static_cast<unsigned>(random() % totalWeight);
+    int operation = 0;
+    while (pick >= settings.mix[operation]) {
+      pick -= settings.mix[operation++];
+    }
+    if (operation == Return && held.empty()) {
+      operation = Borrow;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    switch (operation) {
+    case Borrow: {
+      const std::string &userId = users[random() % users.size()]->getId();
+      const std::string &bookId = books[random() % books.size()]->getId();
+      if (library.borrowBook(userId, bookId)) {
+        held.emplace_back(userId, bookId);
+      }
+      break;
+    }
+    case Return: {
+      size_t index = random() % held.size();
+      library.returnBook(held[index].first, held[index].second);
+      held[index] = held.back();
+      held.pop_back();
+      break;
+    }
+    case Search: {
+      static const char *const types[] = {"title", "author", "category"};
+      int type = static_cast<int>(random() % 3);
+      const auto &book = books[random() % books.size()];
+      // Searching for a real book's field keeps result sizes realistic.
+      std::string field = type == 0   ? book->getTitle()
+                          : type == 1 ? book->getAuthor()
+                                      : book->getCategory();
+      library.searchBooks(field, types[type]);
+      break;
+    }
+    case Report:
+      if (random() % 2 == 0) {
+        library.getMostBorrowedBooks(10);
+      } else {
+        library.getOverdueBooks(14);
+      }
+      break;
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    result.latency[operation].record(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+            .count());
+  }
+}
+
+// Returns the number of books lent to more than one user, marked
+// unavailable without a borrower or available with one, or listed under
+// the wrong availability by the attribute index.
+static size_t countInvariantViolations(const LibrarySystem &library) {
+  std::unordered_map<std::string, size_t> borrowers;
+  for (const auto &user : library.getUsers()) {
+    for (const auto &bookId : user->getBorrowedBooks()) {
+      ++borrowers[bookId];
+    }
+  }
+  size_t violations = 0;
+  for (const auto &book : library.getBooks()) {
+    auto it = borrowers.find(book->getId());
+    size_t count = it == borrowers.end() ? 0 : it->second;
+    if (count > 1 || (count == 1) == book->isAvailable()) {
+      ++violations;
+    }
+  }
+  BookFilter availableOnly;
+  availableOnly.available = true;
+  auto listed = library.findBooks(availableOnly);
+  size_t listedAvailable = 0;
+  for (const auto &book : listed) {
+    listedAvailable += book->isAvailable();
+  }
+  size_t available = 0;
+  for (const auto &book : library.getBooks()) {
+    available += book->isAvailable();
+  }
+  // Available books missing from the list, plus borrowed ones on it.
+  violations += available - listedAvailable;
+  violations += listed.size() - listedAvailable;
+  return violations;
+}
+
+static void printUsage() {
+  std::cerr << "Usage: library_load [--threads 1,2,4,8] [--seconds 5] "
+               "[--books N] [--users N]\n"
+               "                    [--data <dir>] [--mix "
+               "borrow,return,search,report]\n";
+}
+
+// Splits a comma-separated list of numbers.
+static std::vector<unsigned long> parseList(const std::string &text) {
+  std::vector<unsigned long> values;
+  std::stringstream list(text);
+  std::string value;
+  while (std::getline(list, value, ',')) {
+    values.push_back(std::stoul(value));
+  }
+  return values;
+}
+
+int main(int argc, char *argv[]) {
+  Settings settings;
+  for (int i = 1; i < argc; i += 2) {
+    std::string option = argv[i];
+    if (i + 1 >= argc) {
+      printUsage();
+      return 1;
+    }
+    std::string value = argv[i + 1];
+    if (option == "--threads") {
+      settings.threadCounts.clear();
+      for (unsigned long count : parseList(value)) {
+        settings.threadCounts.push_back(count);
+      }
+    } else if (option == "--seconds") {
+      settings.seconds = std::stod(value);
+    } else if (option == "--books") {
+      settings.books = std::stoul(value);
+    } else if (option == "--users") {
+      settings.users = std::stoul(value);
+    } else if (option == "--data") {
+      settings.dataDirectory = value;
+    } else if (option == "--mix") {
+      auto weights = parseList(value);
+      if (weights.size() != OperationCount) {
+        printUsage();
+        return 1;
+      }
+      uint64_t totalWeight = 0;
+      for (size_t op = 0; op < OperationCount; ++op) {
+        settings.mix[op] = static_cast<unsigned>(weights[op]);
+        totalWeight += settings.mix[op];
+      }
+      if (totalWeight == 0 || totalWeight > UINT32_MAX) {
+        std::cerr << "Error: the mix weights must add up to between 1 and "
+                  << UINT32_MAX << std::endl;
+        return 1;
+      }
+    } else {
+      printUsage();
+      return 1;
+    }
+  }
+
+  LibrarySystem library(StorageMode::Arena); // As the application runs.
+  if (!settings.dataDirectory.empty()) {
+    library.loadItemsFromFile(settings.dataDirectory + "/books.txt", false);
+    library.loadItemsFromFile(settings.dataDirectory + "/users.txt", true);
+  } else {
+    generateCatalog(library, settings);
+  }
+  if (library.getBooks().empty() || library.getUsers().empty()) {
+    std::cerr << "Error: the library needs at least one book and one user"
+              << std::endl;
+    return 1;
+  }
+  std::cerr << library.getBooks().size() << " books, "
+            << library.getUsers().size() << " users" << std::endl;
+
+  std::printf("threads\toperation\tcount\tops_per_sec\tp50_ns\tp99_ns\t"
+              "p999_ns\tmax_ns\n");
+  std::string lockRows;
+  size_t violations = 0;
+  for (size_t threadCount : settings.threadCounts) {
+    std::vector<ThreadResult> results(threadCount);
+    std::vector<std::thread> clerks;
+    std::atomic<bool> stop{false};
+    LibraryLockContention before = library.getLockContention();
+    for (size_t t = 0; t < threadCount; ++t) {
+      clerks.emplace_back(runClerk, std::ref(library), std::cref(settings),
+                          static_cast<unsigned>(t + 1), std::cref(stop),
+                          std::ref(results[t]));
+    }
+    std::this_thread::sleep_for(std::chrono::duration<double>(
+        settings.seconds));
+    stop = true;
+    for (auto &clerk : clerks) {
+      clerk.join();
+    }
+    LibraryLockContention after = library.getLockContention();
+
+    // Check while the clerks' loans are still out, then hand them back so
+    // the next run starts from the same state.
+    violations += countInvariantViolations(library);
+    for (const auto &result : results) {
+      for (const auto &loan : result.held) {
+        library.returnBook(loan.first, loan.second);
+      }
+    }
+
+    LatencyHistogram all;
+    for (int op = 0; op <= OperationCount; ++op) {
+      LatencyHistogram merged;
+      if (op < OperationCount) {
+        for (const auto &result : results) {
+          merged.merge(result.latency[op]);
+        }
+        all.merge(merged);
+      } else {
+        merged = all;
+      }
+      std::printf("%zu\t%s\t%llu\t%.0f\t%llu\t%llu\t%llu\t%llu\n", threadCount,
+                  op < OperationCount ? operationNames[op] : "all",
+                  static_cast<unsigned long long>(merged.count()),
+                  merged.count() / settings.seconds,
+                  static_cast<unsigned long long>(merged.percentile(0.5)),
+                  static_cast<unsigned long long>(merged.percentile(0.99)),
+                  static_cast<unsigned long long>(merged.percentile(0.999)),
+                  static_cast<unsigned long long>(merged.max()));
+    }
+
+    // Wait time as a share of the total thread time of the run.
+    double threadNs = settings.seconds * 1e9 * threadCount;
+    const std::pair<const char *, LockContention LibraryLockContention::*>
+        locks[] = {{"catalog", &LibraryLockContention::catalog},
+                   {"user-stripes", &LibraryLockContention::userStripes},
+                   {"loans", &LibraryLockContention::loans},
+                   {"ranking", &LibraryLockContention::ranking}};
+    for (const auto &lock : locks) {
+      const LockContention &from = before.*lock.second;
+      const LockContention &to = after.*lock.second;
+      char row[160];
+      std::snprintf(row, sizeof(row), "%zu\t%s\t%llu\t%.3f\t%.2f\n",
+                    threadCount, lock.first,
+                    static_cast<unsigned long long>(to.contended -
+                                                    from.contended),
+                    (to.waitNs - from.waitNs) / 1e6,
+                    100.0 * (to.waitNs - from.waitNs) / threadNs);
+      lockRows += row;
+    }
+  }
+
+  std::printf("\nthreads\tlock\tcontended\twait_ms\twait_pct\n%s",
+              lockRows.c_str());
+  std::printf("\ninvariant_violations\t%zu\n", violations);
+  return violations == 0 ? 0 : 2;
+}
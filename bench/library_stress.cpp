@@ -0,0 +1,221 @@
+#include "LibrarySystem.hpp"
+#include <atomic>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Races borrows and returns of a handful of books from many threads, and
+// checks that no book is ever lent to two users at once and that the loan
+// index agrees with the users' borrowed lists.
+//
+//   library_stress [--threads 8] [--books 4] [--rounds 200]
+//
+// Every round has three phases. In the grab phase each thread tries to borrow
+// every book and keeps what it gets; before anything is returned, each book
+// must have been won exactly once, have exactly one borrower, one loan in
+// the loan index and be marked unavailable. In the churn phase the threads
+// borrow and return at random while counting successful borrows minus
+// returns per book, which must never exceed one. In the hand-off phase
+// threads work in pairs: one borrows a book for a run of users, one at a
+// time, while its partner keeps trying to return the current loan. After
+// each phase, with every book back, the loan index must be empty. Prints
+// the number of violations and exits with status 2 if there were any.
+
+struct Settings {
+  size_t threads = 8;
+  size_t books = 4;
+  size_t rounds = 200;
+  size_t churnBorrows = 200; // Borrow attempts per thread per churn phase.
+  size_t handOffs = 50;      // Loans per pair per hand-off phase.
+
+  // Pairs of threads in the hand-off phase, which lends to users numbered
+  // from threads on.
+  size_t pairs() const { return threads < 2 ? 1 : threads / 2; }
+  size_t userCount() const { return threads + pairs() * handOffs; }
+};
+
+static std::string bookId(size_t b) { return 'B' + std::to_string(b); }
+static std::string userId(size_t t) { return 'U' + std::to_string(t); }
+
+// Returns how many loans the loan index lists for each book. Every loan in
+// the run is less than a day old, so all of them fall due within the loan
+// period plus one day.
+static std::vector<size_t> indexedLoans(const LibrarySystem &library,
+                                        const Settings &settings) {
+  std::vector<size_t> loans(settings.books);
+  for (const auto &book :
+       library.getBooksDueWithin(library.getLoanPeriod() + 1)) {
+    ++loans[std::stoul(book->getId().substr(1))];
+  }
+  return loans;
+}
+
+// Counts the books the loan index still lists once all are back.
+static size_t countStaleLoans(const LibrarySystem &library,
+                              const Settings &settings) {
+  size_t violations = 0;
+  auto loans = indexedLoans(library, settings);
+  for (size_t b = 0; b < settings.books; ++b) {
+    if (loans[b] != 0) {
+      std::fprintf(stderr, "%s: %zu loans indexed after its return\n",
+                   bookId(b).c_str(), loans[b]);
+      ++violations;
+    }
+  }
+  return violations;
+}
+
+// Starts one thread per racer running body(t) and waits for all of them.
+template <typename Body> static void race(size_t threads, Body body) {
+  std::vector<std::thread> racers;
+  for (size_t t = 0; t < threads; ++t) {
+    racers.emplace_back(body, t);
+  }
+  for (auto &racer : racers) {
+    racer.join();
+  }
+}
+
+// Every thread tries every book, starting at a different one so that the
+// threads collide. Returns the number of violations, and leaves the library
+// with every book available again.
+static size_t grabPhase(LibrarySystem &library, const Settings &settings) {
+  std::vector<std::atomic<size_t>> wins(settings.books);
+  race(settings.threads, [&](size_t t) {
+    for (size_t i = 0; i < settings.books; ++i) {
+      size_t b = (t + i) % settings.books;
+      if (library.borrowBook(userId(t), bookId(b))) {
+        ++wins[b];
+      }
+    }
+  });
+
+  // Nothing has been returned yet, so each book has exactly one borrower.
+  size_t violations = 0;
+  auto loans = indexedLoans(library, settings);
+  for (size_t b = 0; b < settings.books; ++b) {
+    size_t borrowers = 0;
+    for (size_t t = 0; t < settings.threads; ++t) {
+      borrowers += library.hasBorrowedBook(userId(t), bookId(b));
+    }
+    auto book = library.findBookById(bookId(b));
+    if (wins[b] != 1 || borrowers != 1 || loans[b] != 1 ||
+        book->isAvailable()) {
+      std::fprintf(stderr, "%s: %zu wins, %zu borrowers, %zu loans, %s\n",
+                   bookId(b).c_str(), wins[b].load(), borrowers, loans[b],
+                   book->isAvailable() ? "available" : "unavailable");
+      ++violations;
+    }
+  }
+
+  for (size_t t = 0; t < settings.threads; ++t) {
+    for (size_t b = 0; b < settings.books; ++b) {
+      library.returnBook(userId(t), bookId(b));
+    }
+  }
+  return violations + countStaleLoans(library, settings);
+}
+
+// Threads borrow random books and give them straight back. A winner counts
+// its loan before yielding and uncounts it before returning the book, so the
+// count can only exceed one if two borrows of the same book overlapped.
+static size_t churnPhase(LibrarySystem &library, const Settings &settings,
+                         unsigned seed) {
+  std::vector<std::atomic<size_t>> outstanding(settings.books);
+  std::atomic<size_t> violations{0};
+  race(settings.threads, [&](size_t t) {
+    std::mt19937 random(seed + static_cast<unsigned>(t));
+    for (size_t i = 0; i < settings.churnBorrows; ++i) {
+      size_t b = random() % settings.books;
+      if (!library.borrowBook(userId(t), bookId(b))) {
+        continue;
+      }
+      if (outstanding[b].fetch_add(1) != 0) {
+        std::fprintf(stderr, "%s lent twice at once\n", bookId(b).c_str());
+        ++violations;
+      }
+      std::this_thread::yield(); // Give the other threads a go at the book.
+      outstanding[b].fetch_sub(1);
+      if (!library.returnBook(userId(t), bookId(b))) {
+        std::fprintf(stderr, "%s: return by its borrower failed\n",
+                     bookId(b).c_str());
+        ++violations;
+      }
+    }
+  });
+  return violations + countStaleLoans(library, settings);
+}
+
+// Each pair lends its book to a fresh user per hand-off, and the returner
+// spins on returnBook until the loan exists, so returns race with the end of
+// the borrow. A fresh user per loan keeps any stale loan index entry around
+// for the final check.
+static size_t handOffPhase(LibrarySystem &library, const Settings &settings) {
+  race(settings.pairs() * 2, [&](size_t t) {
+    size_t pair = t / 2;
+    std::string book = bookId(pair % settings.books);
+    size_t firstUser = settings.threads + pair * settings.handOffs;
+    for (size_t i = 0; i < settings.handOffs; ++i) {
+      std::string user = userId(firstUser + i);
+      bool borrower = t % 2 == 0;
+      while (borrower ? !library.borrowBook(user, book)
+                      : !library.returnBook(user, book)) {
+        std::this_thread::yield();
+      }
+    }
+  });
+  return countStaleLoans(library, settings);
+}
+
+static void printUsage() {
+  std::cerr << "Usage: library_stress [--threads 8] [--books 4] "
+               "[--rounds 200]\n";
+}
+
+int main(int argc, char *argv[]) {
+  Settings settings;
+  for (int i = 1; i < argc; i += 2) {
+    std::string option = argv[i];
+    if (i + 1 >= argc) {
+      printUsage();
+      return 1;
+    }
+    size_t value = std::stoul(argv[i + 1]);
+    if (option == "--threads") {
+      settings.threads = value;
+    } else if (option == "--books") {
+      settings.books = value;
+    } else if (option == "--rounds") {
+      settings.rounds = value;
+    } else {
+      printUsage();
+      return 1;
+    }
+  }
+  if (settings.threads == 0 || settings.books == 0) {
+    printUsage();
+    return 1;
+  }
+
+  LibrarySystem library;
+  for (size_t b = 0; b < settings.books; ++b) {
+    library.addItem(library.createBook(bookId(b), "Book " + std::to_string(b),
+                                       "Author", "Category", 2000, true));
+  }
+  for (size_t u = 0; u < settings.userCount(); ++u) {
+    library.addItem(library.createUser(userId(u), "User", "user@example.com",
+                                       "0900000000"));
+  }
+
+  size_t violations = 0;
+  for (size_t round = 0; round < settings.rounds; ++round) {
+    violations += grabPhase(library, settings);
+    violations += churnPhase(library, settings, static_cast<unsigned>(round));
+    violations += handOffPhase(library, settings);
+  }
+  std::printf("invariant_violations\t%zu\n", violations);
+  return violations == 0 ? 0 : 2;
+}
@@ -0,0 +1,103 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Memory resource that hands out pieces of large blocks and frees them all
+// at once when it is destroyed. Deallocation is a no-op, so anything
+// allocated from an arena must be gone before the arena is. Safe to use
+// from several threads.
+class Arena : public std::pmr::memory_resource {
+private:
+  mutable std::mutex mutex;
+  std::vector<std::unique_ptr<char[]>> blocks;
+  char *cursor = nullptr;
+  char *end = nullptr;
+  size_t blockSize;
+  size_t used = 0;
+  size_t reserved = 0;
+
+  void *do_allocate(size_t bytes, size_t alignment) override;
+  void do_deallocate(void *, size_t, size_t) override {}
+  bool do_is_equal(const std::pmr::memory_resource &other) const
+      noexcept override {
+    return this == &other;
+  }
+
+public:
+  // Blocks are blockSize bytes, or larger for a single bigger request.
+  explicit Arena(size_t blockSize = 1 << 20);
+
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  // Bytes handed out / bytes held in blocks.
+  size_t bytesUsed() const;
+  size_t bytesReserved() const;
+
+  // Number of blocks held.
+  size_t blockCount() const;
+};
+
+// Creates a T and its shared_ptr control block in one allocation from
+// resource, passing resource to T's constructor as its last argument.
+template <typename T, typename... Args>
+std::shared_ptr<T> makeShared(std::pmr::memory_resource *resource,
+                              Args &&...args) {
+  return std::allocate_shared<T>(std::pmr::polymorphic_allocator<T>(resource),
+                                 std::forward<Args>(args)..., resource);
+}
+
+// A fixed number of immutable strings stored back to back in one block
+// from a memory resource, instead of one heap buffer per string.
+template <size_t N> class PackedStrings {
+private:
+  std::pmr::memory_resource *resource;
+  char *text = nullptr;
+  std::array<uint32_t, N> ends{}; // End offset of each string in text.
+
+public:
+  PackedStrings(const std::array<std::string_view, N> &values,
+                std::pmr::memory_resource *resource)
+      : resource(resource) {
+    size_t total = 0;
+    for (size_t i = 0; i < N; ++i) {
+      total += values[i].size();
+      ends[i] = static_cast<uint32_t>(total);
+    }
+    if (total == 0) {
+      return;
+    }
+    text = static_cast<char *>(resource->allocate(total, 1));
+    size_t offset = 0;
+    for (const auto &value : values) {
+      value.copy(text + offset, value.size());
+      offset += value.size();
+    }
+  }
+
+  ~PackedStrings() {
+    if (text) {
+      resource->deallocate(text, ends[N - 1], 1);
+    }
+  }
+
+  PackedStrings(const PackedStrings &) = delete;
+  PackedStrings &operator=(const PackedStrings &) = delete;
+
+  // Returns string i; valid for the lifetime of this object.
+  std::string_view get(size_t i) const {
+    uint32_t begin = i == 0 ? 0 : ends[i - 1];
+    return std::string_view(text + begin, ends[i] - begin);
+  }
+};
+
+#endif // ARENA_HPP
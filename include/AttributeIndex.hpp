@@ -0,0 +1,119 @@
+#ifndef ATTRIBUTEINDEX_HPP
+#define ATTRIBUTEINDEX_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Conditions on a book's structured fields. A book matches when it meets
+// every condition that is set; an empty filter matches every book.
+struct BookFilter {
+  std::optional<std::string> category; // Exact, case-sensitive match.
+  std::optional<int> yearFrom;         // Inclusive.
+  std::optional<int> yearTo;           // Inclusive.
+  std::optional<bool> available;
+};
+
+// Number of books, and of those currently available, with one category or
+// published in one decade.
+struct CategoryCount {
+  std::string category;
+  size_t books = 0;
+  size_t available = 0;
+};
+
+struct DecadeCount {
+  int decade = 0; // First year of the decade, e.g. 1990.
+  size_t books = 0;
+  size_t available = 0;
+};
+
+// Secondary indexes over the structured fields of the books: an ordered
+// index on year, a hashed index on category and an availability bitmap.
+// Documents are positions in the book store and must be added in
+// increasing order, which keeps every posting list sorted.
+//
+// Each year and category also counts how many of its books are available,
+// so counts and facets are answered from the indexes without visiting the
+// books. Adding and updating documents needs exclusive access; setAvailable
+// may run concurrently with itself and with queries.
+class AttributeIndex {
+private:
+  struct Posting {
+    std::vector<uint32_t> docs;
+    std::atomic<size_t> available{0};
+  };
+
+  std::map<int, Posting> byYear;
+  std::unordered_map<std::string, Posting> byCategory;
+
+  // Postings each document is listed in. Map nodes never move, so the
+  // pointers stay valid as keys are added.
+  std::vector<Posting *> yearOf;
+  std::vector<Posting *> categoryOf;
+  std::vector<int> yearValues;
+
+  // One bit per document, set while it is available. A deque so the words
+  // never move while the bitmap grows.
+  std::deque<std::atomic<uint64_t>> availableBits;
+  std::atomic<size_t> availableTotal{0};
+
+  // Inserts / removes doc in a sorted posting list.
+  static void insertDoc(Posting &posting, uint32_t doc, bool available);
+  static void eraseDoc(Posting &posting, uint32_t doc, bool available);
+
+  using YearIterator = std::map<int, Posting>::const_iterator;
+
+  // Returns the years within the filter's range.
+  std::pair<YearIterator, YearIterator>
+  yearRange(const BookFilter &filter) const;
+
+  // Returns the category posting the filter asks for, or nullptr if it
+  // sets none. Sets missing if it names a category no book has.
+  const Posting *categoryPosting(const BookFilter &filter,
+                                 bool &missing) const;
+
+  // Returns true if doc meets every condition of filter.
+  bool matches(uint32_t doc, const BookFilter &filter,
+               const Posting *category) const;
+
+public:
+  // Indexes a new document.
+  void add(uint32_t doc, int year, std::string_view category, bool available);
+
+  // Moves an indexed document to a new year and category. Its availability
+  // is unchanged.
+  void update(uint32_t doc, int year, std::string_view category);
+
+  // Records that doc was checked out or returned.
+  void setAvailable(uint32_t doc, bool available);
+
+  // Stores in out, in increasing order, every document matching filter.
+  // The smallest of the category list, the year range and the available
+  // or borrowed set drives the search; the other conditions are checked
+  // per document against the indexes.
+  void find(const BookFilter &filter, std::vector<uint32_t> &out) const;
+
+  // Returns the number of documents matching filter. Filters on year and
+  // availability, or category and availability, are counted from the
+  // indexes alone; category with year intersects the two.
+  size_t count(const BookFilter &filter) const;
+
+  // Return the books per category, in category order, and per decade, in
+  // year order.
+  std::vector<CategoryCount> categoryCounts() const;
+  std::vector<DecadeCount> decadeCounts() const;
+
+  // Approximate heap memory used by the index, in bytes.
+  size_t memoryUsage() const;
+};
+
+#endif // ATTRIBUTEINDEX_HPP
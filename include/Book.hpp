@@ -1,25 +1,32 @@
 #ifndef BOOK_HPP
 #define BOOK_HPP
 
+#include "Arena.hpp"
 #include "Item.hpp"
+#include <atomic>
+#include <memory_resource>
 #include <string>
+#include <string_view>
 
 // Represents a book in the library system, inheriting from Item.
 class Book : public Item {
 private:
-  std::string id;
-  std::string title;
-  std::string author;
-  std::string category;
+  // ID, title, author and category, then the search keys of title, author
+  // and category, in one block from the resource the book was created with.
+  PackedStrings<7> text;
   int year;
-  bool available;
-  int borrowCount;
+  // Availability and borrow count change while other threads read the book,
+  // so they are atomic; the remaining fields never change after
+  // construction.
+  std::atomic<bool> available;
+  std::atomic<int> borrowCount;
 
 public:
-  // Constructor for initializing a Book object.
-  Book(const std::string &id, const std::string &title,
-       const std::string &author, const std::string &category, int year,
-       bool available);
+  // Constructor for initializing a Book object. The text fields are copied
+  // into memory from resource, which must outlive the book.
+  Book(std::string_view id, std::string_view title, std::string_view author,
+       std::string_view category, int year, bool available,
+       std::pmr::memory_resource *resource = std::pmr::new_delete_resource());
 
   // Overrides from Item class.
   std::string getId() const override;
@@ -33,9 +40,28 @@ public:
   bool isAvailable() const;
   void setAvailable(bool availability);
 
+  // Non-copying views of the text fields. They stay valid as long as the
+  // book does, since these fields never change after construction.
+  std::string_view getIdView() const;
+  std::string_view getTitleView() const;
+  std::string_view getAuthorView() const;
+  std::string_view getCategoryView() const;
+
+  // Search keys of the text fields, folded by foldText when the book was
+  // created, so that case- and accent-insensitive searches fold only the
+  // query.
+  std::string_view getFoldedTitleView() const;
+  std::string_view getFoldedAuthorView() const;
+  std::string_view getFoldedCategoryView() const;
+
+  // Atomically marks an available book as borrowed. Returns false if it was
+  // already out, so concurrent borrowers can never both get the same copy.
+  bool tryCheckOut();
+
   // Manage borrow count.
   void incrementBorrowCount();
   int getBorrowCount() const;
+  void setBorrowCount(int count);
 };
 
 #endif // BOOK_HPP
@@ -0,0 +1,95 @@
+#ifndef BOOKQUERY_HPP
+#define BOOKQUERY_HPP
+
+#include "AttributeIndex.hpp"
+#include "Book.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Book fields a query can test.
+enum class QueryField { Title, Author, Category, Year, Available };
+
+// Comparisons a predicate can make. Contains applies to the text fields,
+// Equal to category, year and availability, and the orderings to year.
+enum class QueryOp { Contains, Equal, Less, LessEqual, Greater, GreaterEqual };
+
+// One condition on a book.
+struct QueryPredicate {
+  QueryField field;
+  QueryOp op;
+  std::string text; // Substring for Contains, category name for Equal.
+  int number = 0;   // Year, or 1 / 0 for availability.
+
+  // Returns true if book meets the condition.
+  bool matches(const Book &book) const;
+
+  // Returns the condition in query syntax, e.g. year >= 1990.
+  std::string toString() const;
+};
+
+// A conjunction of predicates over books, and the most results wanted.
+struct BookQuery {
+  std::vector<QueryPredicate> predicates;
+  size_t limit = SIZE_MAX;
+
+  // Returns true if book meets every predicate.
+  bool matches(const Book &book) const;
+
+  // Narrows the category, year and availability predicates into filter.
+  // Returns false if they contradict each other, so nothing can match.
+  bool toFilter(BookFilter &filter) const;
+
+  // Returns the query in query syntax.
+  std::string toString() const;
+};
+
+// Parses a query such as
+//
+//   title ~ night and author ~ "le guin" and year >= 1990 and
+//   available = true limit 20
+//
+// Predicates are <field> <op> <value> joined by "and". Fields are title,
+// author, category, year and available; ops are ~ (contains), =, <, <=, >
+// and >=. Values with spaces are quoted, with "" for a quote inside.
+// Keywords are case-insensitive; values are not. An empty query matches
+// every book. Returns false and describes the problem in error if text is
+// not a valid query.
+bool parseBookQuery(std::string_view text, BookQuery &query,
+                    std::string &error);
+
+// Where the candidates of a query come from.
+enum class QueryAccess {
+  Empty,          // Some predicate matches no book; nothing is read.
+  Scan,           // Every book in catalog order.
+  TitleIndex,     // Trigram index candidates of a title predicate.
+  AuthorIndex,    // Trigram index candidates of an author predicate.
+  CategoryIndex,  // Trigram index candidates of a category predicate.
+  AttributeIndex, // Category, year and availability indexes together.
+};
+
+// How a query is executed, chosen from the estimated number of books each
+// predicate lets through.
+struct QueryPlan {
+  QueryAccess access = QueryAccess::Scan;
+
+  // The predicate whose trigram index drives the query, if one does.
+  size_t driver = SIZE_MAX;
+
+  // Books in the catalog when planned, and the candidates the access path
+  // is expected to produce.
+  size_t books = 0;
+  size_t estimatedCandidates = 0;
+
+  // Per predicate, the index that can answer it ("" if none) and the
+  // number of books it is estimated to let through.
+  std::vector<std::string_view> indexes;
+  std::vector<size_t> estimates;
+
+  // Describes the plan for query, one line per step.
+  std::string explain(const BookQuery &query) const;
+};
+
+#endif // BOOKQUERY_HPP
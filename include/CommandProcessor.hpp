@@ -0,0 +1,81 @@
+#ifndef COMMANDPROCESSOR_HPP
+#define COMMANDPROCESSOR_HPP
+
+#include "LibrarySystem.hpp"
+#include <istream>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+// Executes text commands against a LibrarySystem. A command is one line of
+// comma-separated fields, like the data files:
+//
+//   borrow,<userId>,<bookId>
+//   return,<userId>,<bookId>
+//   add-book,<id>,<title>,<author>,<category>,<year>,<available>
+//   add-user,<id>,<name>,<email>,<phone>
+//   search,<title|author|category>,<query>
+//   search-normalized,<title|author|category>,<query>  ignoring case, accents
+//   fuzzy,<title|author>,<k>,<query>  the k closest, tolerating typos
+//   complete,<title|author>,<k>,<prefix>  the k most borrowed completions
+//   find,<category|*>,<fromYear|*>,<toYear|*>,<available|borrowed|*>
+//   count,<category|*>,<fromYear|*>,<toYear|*>,<available|borrowed|*>
+//   facets,<category|decade>
+//   query,<query>               in the parseBookQuery language
+//   explain,<query>
+//   most-borrowed,<n>
+//   overdue,<days>
+//   due,<days>
+//   import-books,<file>,<reject|upsert>
+//   import-users,<file>,<reject|upsert>
+//   stats
+//
+// Each command produces one tab-separated response line:
+//
+//   ok                         the change was made
+//   ok<TAB><n><TAB><id;id;...> a query and the IDs of its n results
+//   ok<TAB><n>                 count: the number of matching books
+//   ok<TAB><n><TAB><t>=<b>;... complete: each text and its books' total
+//                              borrow count
+//   ok<TAB><v>=<n>/<a>;...     facets: books and available books per
+//                              category or decade
+//   ok<TAB><step> | <step>...  explain: the lines of the query plan
+//   ok<TAB><name>=<value>;...   stats: counters from LibraryMetrics;
+//                              import: added, updated, duplicates, invalid
+//   fail                       the library refused the change, e.g. an
+//                              add whose ID is already taken
+//   error<TAB><message>        the command could not be understood, or
+//                              "journal commit failed": the change could
+//                              not be made durable
+//
+// In batch mode a failed journal commit ends the run with one more line,
+// "<lineNo><TAB>error<TAB>journal commit failed", in place of the results
+// that were not made durable.
+
+// Outcome of a batch run.
+struct BatchResult {
+  size_t executed = 0;   // Number of commands executed.
+  bool committed = true; // False if a journal commit failed.
+};
+
+class CommandProcessor {
+private:
+  LibrarySystem &library;
+
+public:
+  explicit CommandProcessor(LibrarySystem &library);
+
+  // Executes one command and appends its response line, without the
+  // trailing newline, to out. Returns true if the command changed the
+  // library and so appended a journal record.
+  bool execute(std::string_view line, std::string &out);
+
+  // Executes every command read from in and writes "<lineNo><TAB><response>"
+  // per command to out. Blank lines and lines starting with '#' are
+  // skipped. Changes are committed to the journal with a single flush
+  // before each block of results that reports them is written out, so no
+  // "ok" is printed for a change that is not durable.
+  BatchResult runBatch(std::istream &in, std::ostream &out);
+};
+
+#endif // COMMANDPROCESSOR_HPP
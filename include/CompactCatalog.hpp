@@ -0,0 +1,87 @@
+#ifndef COMPACTCATALOG_HPP
+#define COMPACTCATALOG_HPP
+
+#include "Book.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Struct-of-arrays copy of the book catalog for scans and reports. Book
+// objects each live in their own allocation with four separately allocated
+// strings; here every column is one contiguous array:
+//
+//   - IDs and titles are packed back to back into a single text buffer,
+//   - authors and categories are interned, so each book stores only two
+//     32-bit numbers and each distinct name is stored once,
+//   - year, availability and borrow count are plain arrays.
+//
+// A full scan therefore streams through a few dense arrays instead of
+// chasing a pointer per book, and author or category searches test each
+// distinct name once. Text is limited to 4 GiB. Not thread-safe; build one
+// with LibrarySystem::getCompactCatalog and use it from one thread.
+class CompactCatalog {
+public:
+  enum class Field { Title, Author, Category };
+
+private:
+  // Distinct strings of one column, numbered in order of first use.
+  struct StringTable {
+    std::vector<std::string> values;
+    std::unordered_map<std::string, uint32_t> numbers;
+
+    uint32_t intern(std::string_view value);
+    size_t memoryUsage() const;
+  };
+
+  std::string text;
+  // Book i's ID is text[offsets[2i], offsets[2i+1]) and its title runs on
+  // to offsets[2i+2].
+  std::vector<uint32_t> offsets{0};
+  std::vector<uint32_t> authorOf;
+  std::vector<uint32_t> categoryOf;
+  StringTable authors;
+  StringTable categories;
+  std::vector<int32_t> years;
+  std::vector<uint8_t> availability;
+  std::vector<int32_t> borrowCounts;
+
+public:
+  // Copies every book, in order.
+  static CompactCatalog
+  fromBooks(const std::vector<std::shared_ptr<Book>> &books);
+
+  // Reserves room for books books with textBytes bytes of IDs and titles.
+  void reserve(size_t books, size_t textBytes);
+
+  // Appends one book.
+  void add(std::string_view id, std::string_view title,
+           std::string_view author, std::string_view category, int year,
+           bool available, int borrowCount);
+
+  size_t size() const;
+  std::string_view id(size_t book) const;
+  std::string_view title(size_t book) const;
+  std::string_view author(size_t book) const;
+  std::string_view category(size_t book) const;
+  int year(size_t book) const;
+  bool isAvailable(size_t book) const;
+  int borrowCount(size_t book) const;
+
+  // Number of distinct authors / categories.
+  size_t authorCount() const;
+  size_t categoryCount() const;
+
+  // Appends to out, in catalog order, every book whose field contains
+  // query, matching LibrarySystem::searchBooks.
+  void search(std::string_view query, Field field,
+              std::vector<uint32_t> &out) const;
+
+  // Returns the bytes held by all columns and string tables.
+  size_t memoryUsage() const;
+};
+
+#endif // COMPACTCATALOG_HPP
@@ -0,0 +1,146 @@
+#ifndef COMPLETIONINDEX_HPP
+#define COMPLETIONINDEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Prefix completion over one text field of the books, for search boxes
+// that suggest as the patron types. Each distinct value of the field is one
+// completion, whose popularity is the total borrow count of its books. A
+// prefix matches a completion if it starts the search key (see foldText) of
+// the value, or of one of its words: "hob" completes "The Hobbit".
+// Documents are positions in the book store.
+//
+// Every word of every key is an entry in a list sorted by the key from that
+// word on, so the entries a prefix matches are one range, found by binary
+// search. New entries wait in an unsorted list until a search merges them
+// in. A prefix whose range turns out to hold more than cacheThreshold
+// completions, as short ones do, has its best cachedCount completions
+// cached by that search, in a trie of such prefixes, and kept up to date
+// as books are added and borrowed, so later searches for it skip the
+// range.
+class CompletionIndex {
+public:
+  // Completions a prefix must match before its best ones are cached.
+  static const size_t cacheThreshold = 256;
+
+  // Completions kept per cached prefix.
+  static const size_t cachedCount = 16;
+
+  // A completion found by complete. The text stays valid until the index
+  // is next changed.
+  struct Match {
+    std::string_view text;
+    int64_t popularity; // Total borrow count of its books.
+    uint32_t books;
+  };
+
+private:
+  struct Completion {
+    std::string text;
+    std::string key;
+    int64_t popularity = 0;
+    uint32_t books = 0;
+  };
+
+  // Where a word of a completion's key starts. head holds the first eight
+  // bytes from there, big-endian, so most comparisons need no string.
+  struct Entry {
+    uint64_t head;
+    uint32_t id;
+    uint32_t offset;
+  };
+
+  // A node of the trie of cached prefixes. If listed, ids holds the best
+  // completions of its prefix, best first. Stale after a completion lost
+  // books or popularity, and rebuilt from the entries on the next search
+  // for it.
+  struct Cache {
+    std::vector<std::pair<char, uint32_t>> children; // By next byte.
+    std::vector<uint32_t> ids;
+    bool listed = false;
+    bool stale = false;
+  };
+
+  std::deque<Completion> completions; // Never moves, so views stay valid.
+  std::unordered_map<std::string_view, uint32_t> ids; // By text.
+  std::vector<uint32_t> completionOf;                  // By document.
+  std::vector<Entry> sorted;
+  std::vector<Entry> pending;
+  std::vector<Cache> caches; // The trie, root first; empty until needed.
+
+  // Returns the key of entry, from its word on.
+  std::string_view keyOf(const Entry &entry) const;
+
+  // Orders entries by key, then completion.
+  bool entryBefore(const Entry &a, const Entry &b) const;
+
+  // Sorts the entries from first to last, whose keys agree on their first
+  // depth bytes, as entryBefore would.
+  void sortEntries(Entry *first, Entry *last, size_t depth) const;
+
+  // Returns true if completion a ranks above b for prefix.
+  bool rankBefore(uint32_t a, uint32_t b, std::string_view prefix) const;
+
+  // Returns the child of trie node for byte, or 0 if it has none.
+  uint32_t childOf(uint32_t node, char byte) const;
+
+  // Calls visit(prefix, cache) for each listed cache of a prefix that
+  // starts a word of the completion's key; twice if two words start with
+  // it.
+  template <typename Visit> void forEachCache(uint32_t id, Visit visit);
+
+  // Caches the best of a prefix's ranked completions.
+  void cache(std::string_view prefix, const std::vector<uint32_t> &ranked);
+
+  // Moves completion id to its place in every cached list of its prefixes
+  // after it gained books or popularity.
+  void promote(uint32_t id);
+
+  // Marks the cached lists of the completion's prefixes stale after it
+  // lost books or popularity.
+  void demote(uint32_t id);
+
+  // Returns the ID of the completion for text, creating it and its entries
+  // if it is new.
+  uint32_t idOf(std::string_view text, std::string_view key);
+
+  // Sorts the pending entries into the sorted list.
+  void mergePending();
+
+  // Stores in out every completion with books whose key or a word of it
+  // starts with prefix, each once.
+  void candidates(std::string_view prefix, std::vector<uint32_t> &out);
+
+public:
+  // Indexes document doc, with the field's text, its search key and the
+  // book's borrow count.
+  void add(uint32_t doc, std::string_view text, std::string_view key,
+           int borrowCount);
+
+  // Moves document doc to a new text, taking its borrow count along.
+  void replace(uint32_t doc, std::string_view text, std::string_view key,
+               int borrowCount);
+
+  // Counts one more borrow of document doc.
+  void borrowed(uint32_t doc);
+
+  // Stores in out up to k completions of a folded prefix, best first:
+  // those whose whole key starts with it before those matched at a later
+  // word, then the most borrowed, then in order of text. Leading spaces
+  // and punctuation in prefix are ignored. Returns false if nothing else
+  // is left. Searching may merge pending entries and create or rebuild
+  // cached lists, so calls must not overlap each other or changes.
+  bool complete(std::string_view prefix, size_t k, std::vector<Match> &out);
+
+  // Approximate heap memory used by the index, in bytes.
+  size_t memoryUsage() const;
+};
+
+#endif // COMPLETIONINDEX_HPP
@@ -0,0 +1,84 @@
+#ifndef CSVLOADER_HPP
+#define CSVLOADER_HPP
+
+#include "Book.hpp"
+#include "User.hpp"
+#include <chrono>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Splits a line into fields without copying. next() follows std::getline:
+// it yields empty fields between adjacent delimiters and fails once the
+// input is used up, so a trailing delimiter adds no empty field.
+class FieldTokenizer {
+private:
+  std::string_view text;
+  size_t pos = 0;
+
+public:
+  explicit FieldTokenizer(std::string_view text) : text(text) {}
+
+  // Stores the next field in field and returns true, or returns false when
+  // nothing is left.
+  bool next(char delimiter, std::string_view &field);
+};
+
+// Parses books.txt / users.txt images in newline-aligned chunks that can be
+// processed on separate threads and merged in file order.
+class CsvLoader {
+public:
+  // A line that could not be parsed. The line number is relative to the
+  // start of the chunk until the chunks are merged.
+  struct ParseError {
+    size_t line;
+    std::string message;
+  };
+
+  // Books parsed from one chunk.
+  struct BookChunk {
+    std::vector<std::shared_ptr<Book>> books;
+    std::vector<ParseError> errors;
+    size_t lineCount = 0;
+  };
+
+  // One entry of a user's borrowed list: "bookId" or "bookId@seconds".
+  // The book ID points into the mapped file.
+  struct Loan {
+    std::string_view bookId;
+    bool hasDate;
+    std::chrono::system_clock::time_point borrowDate;
+  };
+
+  // Users parsed from one chunk. The loans of users[i] are the next
+  // loanCounts[i] entries of loans; they are applied to the library while
+  // merging.
+  struct UserChunk {
+    std::vector<std::shared_ptr<User>> users;
+    std::vector<Loan> loans;
+    std::vector<size_t> loanCounts;
+    std::vector<ParseError> errors;
+    size_t lineCount = 0;
+  };
+
+  // Splits data into at most chunkCount pieces, each ending on a newline.
+  static std::vector<std::string_view> splitChunks(std::string_view data,
+                                                   size_t chunkCount);
+
+  // Picks a chunk count for a file of the given size.
+  static size_t chunkCountFor(size_t bytes);
+
+  // Parses one chunk of books.txt, creating the books from resource.
+  static BookChunk parseBooks(
+      std::string_view chunk,
+      std::pmr::memory_resource *resource = std::pmr::new_delete_resource());
+
+  // Parses one chunk of users.txt, creating the users from resource.
+  static UserChunk parseUsers(
+      std::string_view chunk,
+      std::pmr::memory_resource *resource = std::pmr::new_delete_resource());
+};
+
+#endif // CSVLOADER_HPP
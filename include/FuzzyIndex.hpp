@@ -0,0 +1,89 @@
+#ifndef FUZZYINDEX_HPP
+#define FUZZYINDEX_HPP
+
+#include "TrigramIndex.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Typo-tolerant word index over one text field of the books. Texts are the
+// search keys made by foldText, split into words; each distinct word is
+// stored once, packed back to back, with the sorted list of documents using
+// it. Documents are positions in the book store.
+//
+// A query word is compared with every distinct word rather than every
+// book, so a catalog of a million titles costs a scan of its vocabulary.
+// Words whose length, or whose set of bytes, differs from the query word's
+// by more than the edit budget are skipped unread. The rest go through
+// Myers' bit-parallel edit distance, a few word operations per byte.
+class FuzzyIndex {
+private:
+  struct Word {
+    uint32_t offset;
+    uint32_t length;
+    uint64_t mask; // One bit per distinct byte value, modulo 64.
+  };
+
+  std::unordered_map<std::string, uint32_t> wordIds;
+  std::string wordText;
+  std::vector<Word> words;
+  std::vector<std::vector<uint32_t>> postings;
+
+  // Stores the distinct words of folded text in out.
+  static void wordsOf(std::string_view text, std::vector<std::string> &out);
+
+  // Returns the byte mask of a folded word.
+  static uint64_t maskOf(std::string_view word);
+
+  // Returns the ID of word, adding it to the vocabulary if it is new.
+  uint32_t idOf(const std::string &word);
+
+public:
+  // Longest query word the index can search for.
+  static const size_t maxWordLength = 64;
+
+  // A document and the sum, over the query words, of the edit distance to
+  // the closest word of its text.
+  struct Match {
+    uint32_t doc;
+    int distance;
+  };
+
+  // Returns the fewest insertions, deletions and substitutions that turn
+  // word into other, or a value above maxEdits once that is certain to
+  // exceed it. Both must already be folded, and word must not be longer
+  // than maxWordLength.
+  static int distance(std::string_view word, std::string_view other,
+                      int maxEdits);
+
+  // Returns the edit budget per word used when a search does not give
+  // one: none up to two bytes, one up to five, then two.
+  static int defaultMaxEdits(size_t wordLength);
+
+  // Indexes the folded text as document doc.
+  void add(uint32_t doc, std::string_view text);
+
+  // Reindexes every changed document, each listed at most once, from its
+  // old and new folded text. Each affected posting list is rewritten once.
+  void replace(const std::vector<TrigramIndex::TextChange> &changes);
+
+  // Stores in out up to k documents whose text has, for every word of
+  // query, a word within maxEdits edits of it, ranked by the total of
+  // those distances and then by document. The query is folded first, so
+  // case and accents do not count as edits. A negative maxEdits uses
+  // defaultMaxEdits of each query word. Returns false if query has no
+  // words or a word longer than maxWordLength.
+  bool search(std::string_view query, int maxEdits, size_t k,
+              std::vector<Match> &out) const;
+
+  // Returns the number of distinct words.
+  size_t vocabularySize() const;
+
+  // Approximate heap memory used by the index, in bytes.
+  size_t memoryUsage() const;
+};
+
+#endif // FUZZYINDEX_HPP
@@ -0,0 +1,132 @@
+#ifndef JOURNAL_HPP
+#define JOURNAL_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// How appended records reach stable storage.
+enum class DurabilityMode {
+  Synchronous, // Every append is written and fsync'ed before returning.
+  GroupCommit, // Appends are batched and fsync'ed together by a flusher.
+  Async        // Like GroupCommit, but batches are written without fsync.
+};
+
+// Tuning knobs for the journal flusher.
+struct DurabilityOptions {
+  DurabilityMode mode = DurabilityMode::Synchronous;
+  // Longest a record waits in the pending batch before it is committed.
+  std::chrono::milliseconds commitInterval{5};
+  // Number of pending records that triggers an early commit.
+  size_t commitBatchSize = 64;
+};
+
+// Counters describing journal commits, for tuning DurabilityOptions.
+struct JournalStats {
+  uint64_t commits = 0;           // Number of batches written.
+  uint64_t records = 0;           // Number of records written.
+  uint64_t largestBatch = 0;      // Most records written by one commit.
+  uint64_t totalCommitLatencyNs = 0; // Sum over commits of the time the
+                                     // oldest record in the batch waited.
+  uint64_t maxCommitLatencyNs = 0;   // Worst such wait.
+  uint64_t bytes = 0;                // Bytes written.
+  uint64_t totalWriteNs = 0;         // Time spent in write and fsync.
+};
+
+// Append-only log of library mutations. Each record is one line of
+// comma-separated fields, replayed on top of the last full snapshot of
+// books.txt and users.txt at startup.
+class Journal {
+private:
+  std::string filename;
+  int fd = -1; // File descriptor opened for appending, -1 when closed.
+
+  DurabilityOptions options;
+  JournalStats stats;
+
+  // Guards the pending batch, sequence numbers, options and stats.
+  mutable std::mutex stateMutex;
+  // Serializes writes to fd so batches reach the file in sequence order.
+  std::mutex ioMutex;
+  std::condition_variable flushRequested;
+  std::condition_variable committed;
+
+  std::string pending;   // Encoded records not yet written.
+  size_t pendingCount = 0;
+  std::chrono::steady_clock::time_point pendingSince;
+  uint64_t appendedSeq = 0;  // Sequence number of the last appended record.
+  uint64_t committedSeq = 0; // Sequence number of the last committed record.
+  // Set once a write or fsync fails. The file may then end in a partial
+  // batch, so nothing more is committed until the journal is reopened.
+  bool failed = false;
+
+  std::thread flusher;
+  bool stopping = false;
+
+  // Background loop committing batches in the non-synchronous modes.
+  void flusherLoop();
+
+  // Writes out everything pending. Must be called without stateMutex held.
+  bool flushPending();
+
+public:
+  Journal() = default;
+  ~Journal();
+
+  Journal(const Journal &) = delete;
+  Journal &operator=(const Journal &) = delete;
+
+  // Opens (creating if needed) the journal file for appending.
+  bool open(const std::string &filename);
+
+  // Commits anything pending and closes the journal file.
+  void close();
+
+  // Returns true while the journal file is open.
+  bool isOpen() const;
+
+  // Returns true once a commit has failed.
+  bool hasFailed() const;
+
+  // Changes how appended records are committed. Takes effect immediately.
+  void setDurability(const DurabilityOptions &options);
+  DurabilityOptions getDurability() const;
+
+  // Appends one record and returns its sequence number, or 0 if the journal
+  // is closed or has failed, so the record will never be committed. In
+  // Synchronous mode the record is committed on return, unless deferCommit
+  // is set so that a bulk change can commit once with sync(); otherwise it
+  // is only in the pending batch.
+  uint64_t append(const std::vector<std::string> &fields,
+                  bool deferCommit = false);
+
+  // Blocks until the record with the given sequence number is committed.
+  // Returns false if it never will be, because the journal failed or closed.
+  bool waitForCommit(uint64_t seq);
+
+  // Blocks until every record appended so far is committed.
+  bool waitForAll();
+
+  // Commits everything pending right away.
+  bool sync();
+
+  // Discards all records, used once they have been folded into a snapshot.
+  bool truncate();
+
+  // Returns a copy of the commit counters.
+  JournalStats getStats() const;
+
+  // Calls apply for every complete record in filename, in order. A torn
+  // final record (no trailing newline) is ignored. Returns the number of
+  // records read.
+  static size_t
+  replay(const std::string &filename,
+         const std::function<void(const std::vector<std::string> &)> &apply);
+};
+
+#endif // JOURNAL_HPP
@@ -0,0 +1,69 @@
+#ifndef LATENCYHISTOGRAM_HPP
+#define LATENCYHISTOGRAM_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Counts latencies in log-linear buckets: each power of two is split into
+// 16 buckets, so any percentile is reported within about 6% while the
+// histogram stays a fixed 8 KiB no matter how many values it holds. Not
+// thread-safe; give each thread its own and merge them, or record into an
+// AtomicLatencyHistogram.
+class LatencyHistogram {
+public:
+  static const size_t subBucketBits = 4;
+  static const size_t subBuckets = size_t(1) << subBucketBits;
+  static const size_t bucketCount = (64 - subBucketBits + 1) * subBuckets;
+
+private:
+  friend class AtomicLatencyHistogram;
+
+  std::array<uint64_t, bucketCount> counts{};
+  uint64_t total = 0;
+  uint64_t largest = 0;
+
+  static size_t bucketOf(uint64_t value);
+  static uint64_t lowestIn(size_t bucket);
+
+public:
+  // Adds one value, normally nanoseconds.
+  void record(uint64_t value);
+
+  // Adds every value recorded in other.
+  void merge(const LatencyHistogram &other);
+
+  // Forgets every value.
+  void clear();
+
+  // Returns the number of values recorded / the largest of them.
+  uint64_t count() const;
+  uint64_t max() const;
+
+  // Returns the value below which the given fraction (0 to 1) of the
+  // recorded values fall, rounded up to its bucket's upper edge.
+  uint64_t percentile(double fraction) const;
+
+  // Returns the number of values below limit. Exact when limit is a power
+  // of two, since those start a bucket.
+  uint64_t countBelow(uint64_t limit) const;
+};
+
+// The same buckets, recorded with relaxed atomic adds so that several
+// threads can share one. Read it by adding it into a LatencyHistogram.
+class AtomicLatencyHistogram {
+private:
+  std::array<std::atomic<uint64_t>, LatencyHistogram::bucketCount> counts{};
+  std::atomic<uint64_t> total{0};
+  std::atomic<uint64_t> largest{0};
+
+public:
+  // Adds one value, normally nanoseconds.
+  void record(uint64_t value);
+
+  // Adds every value recorded so far to histogram.
+  void addTo(LatencyHistogram &histogram) const;
+};
+
+#endif // LATENCYHISTOGRAM_HPP
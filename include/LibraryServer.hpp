@@ -0,0 +1,83 @@
+#ifndef LIBRARYSERVER_HPP
+#define LIBRARYSERVER_HPP
+
+#include "CommandProcessor.hpp"
+#include "LibrarySystem.hpp"
+#include "ThreadPool.hpp"
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Where the server listens.
+struct ServerOptions {
+  std::string socketPath;  // Unix domain socket path; used when not empty.
+  int tcpPort = 0;         // Otherwise a TCP port on 127.0.0.1.
+  size_t workerThreads = 0; // 0 means one per hardware thread.
+};
+
+// Serves the CommandProcessor protocol to many clients at once. Every
+// request is one line and gets one response line, in order, so clients may
+// pipeline requests without waiting for each answer.
+//
+// A single I/O thread polls the listening socket and all connections and
+// splits incoming bytes into request lines. Complete lines are queued on
+// their connection, and a fixed pool of workers executes them: each
+// connection is drained by at most one worker at a time, which keeps its
+// responses in order while different connections run in parallel.
+//
+// A response to a change is only sent once the change's journal record is
+// committed. Workers do not fsync per request: they wait for the journal's
+// group commit, so concurrent clients share each flush.
+class LibraryServer {
+private:
+  // Per-client state. The I/O thread owns inbox; the rest is guarded by
+  // mutex and shared with the worker draining the connection.
+  struct Connection {
+    int fd = -1;
+    std::string inbox;            // Received bytes not yet split into lines.
+    std::mutex mutex;
+    std::deque<std::string> queue; // Complete requests awaiting execution.
+    bool draining = false;         // A worker owns the queue right now.
+
+    ~Connection();
+  };
+
+  LibrarySystem &library;
+  ServerOptions options;
+  CommandProcessor processor;
+  int listenFd = -1;
+  int wakePipe[2] = {-1, -1}; // Written by stop() to interrupt poll().
+  std::atomic<bool> stopping{false};
+  std::map<int, std::shared_ptr<Connection>> connections;
+
+  void acceptClients();
+  // Reads what the client sent; returns false once it has hung up.
+  bool readRequests(const std::shared_ptr<Connection> &connection,
+                    ThreadPool &workers);
+  // Executes queued requests of one connection and writes the responses.
+  void drain(const std::shared_ptr<Connection> &connection);
+
+public:
+  LibraryServer(LibrarySystem &library, const ServerOptions &options);
+  ~LibraryServer();
+
+  LibraryServer(const LibraryServer &) = delete;
+  LibraryServer &operator=(const LibraryServer &) = delete;
+
+  // Binds and listens. Returns false (and reports why) on failure.
+  bool start();
+
+  // Serves clients until stop() is called. Requests already received are
+  // answered before it returns.
+  void run();
+
+  // Asks run() to return. Only writes to a pipe, so it is safe to call from
+  // a signal handler.
+  void stop();
+};
+
+#endif // LIBRARYSERVER_HPP
@@ -1,36 +1,430 @@
 #ifndef LIBRARYSYSTEM_HPP
 #define LIBRARYSYSTEM_HPP
 
+#include "Arena.hpp"
+#include "AttributeIndex.hpp"
 #include "Book.hpp"
+#include "BookQuery.hpp"
+#include "CompactCatalog.hpp"
+#include "CompletionIndex.hpp"
+#include "FuzzyIndex.hpp"
+#include "Journal.hpp"
+#include "LoanIndex.hpp"
+#include "Metrics.hpp"
+#include "PopularityRanking.hpp"
+#include "RecordWriter.hpp"
+#include "TimedMutex.hpp"
+#include "TrigramIndex.hpp"
 #include "User.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <ostream>
+#include <shared_mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+// Time spent waiting on each of the library's locks; see TimedMutex.
+struct LibraryLockContention {
+  LockContention catalog;     // catalogMutex, shared and exclusive.
+  LockContention userStripes; // All user stripes together.
+  LockContention loans;       // loanMutex.
+  LockContention ranking;     // rankingMutex.
+};
+
+// Where books and users, and their text, are allocated.
+enum class StorageMode {
+  Heap,  // One allocation per item and per text block; freed one by one.
+  Arena, // Carved from large blocks owned by the library; freed together.
+};
+
+// Space held by the library's arenas; all zero in heap mode.
+struct ArenaUsage {
+  size_t arenas = 0;
+  size_t blocks = 0;
+  size_t bytesUsed = 0;
+  size_t bytesReserved = 0;
+};
+
+// What a bulk import does with a record whose ID is already taken.
+enum class DuplicatePolicy {
+  Reject, // Keep the existing record and report the new one as a duplicate.
+  Upsert, // Replace the existing record's catalog fields. Loans,
+          // availability and borrow count stay as they were.
+};
+
+// How searchBooks compares the query with the field.
+enum class SearchMode {
+  Exact,      // Byte for byte, as typed.
+  Normalized, // Ignoring case and accents: "nguyen" finds "Nguyễn".
+};
+
+// Outcome of one record of a bulk import.
+enum class ImportStatus {
+  Added,
+  Updated,   // Replaced an existing record under DuplicatePolicy::Upsert.
+  Duplicate, // Rejected: the ID is already taken.
+  Invalid,   // Rejected: null, empty ID, or a user that carries loans.
+};
+
+// Per-record outcomes of a bulk import, in batch order, and their totals.
+struct ImportResult {
+  std::vector<ImportStatus> statuses;
+  size_t added = 0;
+  size_t updated = 0;
+  size_t duplicates = 0;
+  size_t invalid = 0;
+  bool committed = true; // False if the journal commit of the batch failed.
+};
+
+// Listings that can be written a page at a time through a RecordWriter.
+enum class Listing {
+  Books,        // Every book, in catalog order.
+  Users,        // Every user with their borrowed books.
+  MostBorrowed, // The top parameter books by borrow count.
+  Overdue,      // Loans overdue by parameter days, oldest first.
+  DueSoon,      // Loans due within parameter days, soonest first.
+};
+
+// Where a paged listing resumes. Start from a default cursor and pass back
+// the one each page returns until done is set. Records added or removed
+// between pages may be missed or repeated, but nothing else is.
+struct ListCursor {
+  bool started = false;
+  int64_t key = 0;     // Catalog slot, rank, or borrow date, by listing.
+  uint64_t offset = 0; // Loans already listed at the borrow date key.
+  bool done = false;
+};
+
+// A book found by fuzzySearchBooks, and the number of edits between the
+// query's words and the closest words of the searched field.
+struct FuzzyMatch {
+  std::shared_ptr<Book> book;
+  int distance;
+};
+
+// A title or author suggested by completeBooks, with the total borrow count
+// and the number of the books that have it.
+struct BookCompletion {
+  std::string text;
+  int64_t popularity;
+  size_t books;
+};
+
+class LibrarySystem;
+
+// Lazily evaluated results of LibrarySystem::queryBooks, in catalog order.
+// The candidates of the plan's access path are listed when the query is
+// opened; each call to next then checks them against every predicate until
+// one matches, holding the catalog lock shared only meanwhile. A query
+// with a limit stops as soon as it has enough results. A cursor must not
+// outlive its library.
+class BookCursor {
+private:
+  friend class LibrarySystem;
+
+  const LibrarySystem *library = nullptr;
+  BookQuery query;
+  QueryPlan plan;
+  std::vector<uint32_t> candidates; // Unused by a scan.
+  size_t position = 0;              // Next candidate, or next slot to scan.
+  size_t returned = 0;
+
+public:
+  // Returns the next matching book, or nullptr once there are no more or
+  // the limit has been reached.
+  std::shared_ptr<Book> next();
+
+  // Returns the plan the query runs under.
+  const QueryPlan &getPlan() const;
+};
+
 // Manages books and users in the library system.
+//
+// All public methods are safe to call from several threads. Lookups, queries
+// and reports run in parallel, and borrows and returns of different books
+// only meet briefly on the loan index and popularity ranking. The lock order
+// is catalogMutex, then a user stripe, then loanMutex or rankingMutex.
 class LibrarySystem {
 private:
+  friend class BookCursor;
+
+  using CatalogMutex = TimedMutex<std::shared_mutex>;
+  using Mutex = TimedMutex<std::mutex>;
+
+  // Guards the shape of the stores and the ID and search indexes. Held
+  // shared by lookups, queries, borrows and returns; held exclusively only
+  // while items are added, loaded or saved.
+  mutable CatalogMutex catalogMutex;
+
+  // Guard each user's borrowed list and borrow dates, striped by the user's
+  // position in users.
+  mutable std::array<Mutex, 64> userStripes;
+
+  // Guard the loan index, and the popularity ranking and completion
+  // indexes.
+  mutable Mutex loanMutex;
+  mutable Mutex rankingMutex;
+
+  StorageMode storageMode;
+
+  // In arena mode, the blocks every book and user created by the library
+  // lives in: one arena for items added one at a time, plus one per chunk
+  // of each loaded file. Declared before the stores so they are destroyed
+  // after them. Grown with catalogMutex held exclusively.
+  std::vector<std::unique_ptr<Arena>> arenas;
+
+  // Where createBook / createUser allocate: arenas.front() in arena mode,
+  // the global heap otherwise.
+  std::pmr::memory_resource *itemResource;
+
   // List of all items in the library system (books and users).
   std::vector<std::shared_ptr<Item>> items;
 
+  // Typed stores, filled by addItem alongside items so that lookups and
+  // scans never need an RTTI cast.
+  std::vector<std::shared_ptr<Book>> books;
+  std::vector<std::shared_ptr<User>> users;
+
+  // Position in items of every book / user, so an upsert can replace it
+  // there too.
+  std::vector<size_t> bookItemSlots;
+  std::vector<size_t> userItemSlots;
+
+  // ID indexes into the typed stores. IDs are unique: items whose ID is
+  // already taken are never stored.
+  std::unordered_map<std::string, size_t> bookIndex;
+  std::unordered_map<std::string, size_t> userIndex;
+
+  // Substring search indexes over the book text fields, keyed by position
+  // in books.
+  TrigramIndex titleIndex;
+  TrigramIndex authorIndex;
+  TrigramIndex categoryIndex;
+
+  // Case-folded titles and authors for typo-tolerant search, keyed by
+  // position in books.
+  FuzzyIndex titleFuzzyIndex;
+  FuzzyIndex authorFuzzyIndex;
+
+  // Title and author completions ranked by borrow count, keyed by position
+  // in books. Changed with catalogMutex held exclusively or, for borrows,
+  // with rankingMutex. Searching may reorganize them, so completeBooks
+  // holds catalogMutex shared and rankingMutex.
+  mutable CompletionIndex titleCompletions;
+  mutable CompletionIndex authorCompletions;
+
+  // Year, category and availability indexes, keyed by position in books.
+  // Availability is updated with catalogMutex held shared; see
+  // AttributeIndex.
+  AttributeIndex attributeIndex;
+
+  // Books ranked by lifetime borrow count, keyed by position in books.
+  PopularityRanking popularity;
+
+  // Open loans ordered by borrow date.
+  LoanIndex loanIndex;
+
+  // Days a book may be kept before it is due.
+  std::atomic<int> loanPeriodDays{14};
+
+  // Write-ahead log of mutations made since the last compaction.
+  Journal journal;
+
+  // Operation latency and I/O counters; updated by const methods too.
+  mutable Metrics metrics;
+
+  // Files the item into the stores without journaling it. Returns false,
+  // storing nothing, if its ID is already taken. The caller holds
+  // catalogMutex exclusively.
+  bool storeItem(const std::shared_ptr<Item> &item);
+
+  // Replace the book / user at slot with one carrying the same ID, moving
+  // over its loans, availability and borrow count. The caller holds
+  // catalogMutex exclusively. replaceBook returns the book it displaced;
+  // the search indexes still describe that one until reindexBooks.
+  std::shared_ptr<Book> replaceBook(size_t slot,
+                                    const std::shared_ptr<Book> &book);
+  void replaceUser(size_t slot, const std::shared_ptr<User> &user);
+
+  // Brings the search indexes up to date for replaced books, given the
+  // book each slot held when the indexes were last updated.
+  void reindexBooks(
+      const std::unordered_map<size_t, std::shared_ptr<Book>> &replaced);
+
+  // Makes room for extra more items in the stores and ID indexes.
+  void reserveForBooks(size_t extra);
+  void reserveForUsers(size_t extra);
+
+  // Lookups for callers that already hold catalogMutex.
+  std::shared_ptr<Book> lookupBook(const std::string &bookId) const;
+  std::shared_ptr<User> lookupUser(const std::string &userId,
+                                   size_t *slot = nullptr) const;
+
+  // Returns the stripe guarding the loans of the user at slot.
+  Mutex &stripeOf(size_t userSlot) const;
+
+  // Apply a borrow / return / borrow-date change with catalogMutex held. When
+  // journalSeq is given, the change is journaled while the user's stripe is
+  // still held, so records for one loan reach the journal in the order they
+  // happened, and the record's sequence number is stored there.
+  bool applyBorrow(const std::string &userId, const std::string &bookId,
+                   std::chrono::system_clock::time_point borrowDate,
+                   uint64_t *journalSeq = nullptr);
+  bool applyReturn(const std::string &userId, const std::string &bookId,
+                   uint64_t *journalSeq = nullptr);
+  bool applyBorrowDate(const std::string &userId, const std::string &bookId,
+                       std::chrono::system_clock::time_point borrowDate,
+                       uint64_t *journalSeq = nullptr);
+
+  // Maps and parses a books or users file on all cores, reporting malformed
+  // lines, and appends its records to parsedBooks / parsedUsers in file
+  // order. Returns false if the file cannot be opened.
+  bool parseItemsFile(const std::string &filename, bool isUserFile,
+                      std::vector<std::shared_ptr<Book>> &parsedBooks,
+                      std::vector<std::shared_ptr<User>> &parsedUsers,
+                      size_t &bytes);
+
+  // Plans a query with catalogMutex held.
+  QueryPlan planLocked(const BookQuery &query) const;
+
+  // Writes one data file with catalogMutex held.
+  bool writeItemsFile(const std::string &filename, bool isUserFile) const;
+
+  // Applies one journal record on top of the current state.
+  void replayRecord(const std::vector<std::string> &fields);
+
 public:
-  // Adds an item to the library system.
-  void addItem(const std::shared_ptr<Item> &item);
+  // In arena mode, books and users made by the library (through loading,
+  // replay, createBook or createUser) must not be used after the library
+  // is destroyed, even through a shared_ptr kept elsewhere.
+  explicit LibrarySystem(StorageMode mode = StorageMode::Heap);
+
+  // Returns the mode chosen at construction.
+  StorageMode getStorageMode() const;
+
+  // Create a book / user in the library's storage, ready for addItem.
+  std::shared_ptr<Book> createBook(std::string_view id, std::string_view title,
+                                   std::string_view author,
+                                   std::string_view category, int year,
+                                   bool available) const;
+  std::shared_ptr<User> createUser(std::string_view id, std::string_view name,
+                                   std::string_view email,
+                                   std::string_view phone) const;
+
+  // Returns the space held by the arenas.
+  ArenaUsage getArenaUsage() const;
+
+  // Adds an item to the library system. Returns false, changing nothing, if
+  // a book or user with the same ID already exists.
+  bool addItem(const std::shared_ptr<Item> &item);
+
+  // Add a batch of books / users in one exclusive section, resolving IDs
+  // that are already taken, including earlier in the same batch, by
+  // policy. With a journal open, every change is journaled and the batch
+  // is committed once at the end.
+  ImportResult addBooks(const std::vector<std::shared_ptr<Book>> &batch,
+                        DuplicatePolicy policy);
+  ImportResult addUsers(const std::vector<std::shared_ptr<User>> &batch,
+                        DuplicatePolicy policy);
+
+  // Parses a books or users file in the loadItemsFromFile format and passes
+  // its records to addBooks / addUsers. Users listed with loans are
+  // reported as Invalid. Malformed lines are reported and skipped.
+  ImportResult importItemsFromFile(const std::string &filename,
+                                   bool isUserFile, DuplicatePolicy policy);
 
   // Loads items from a file (users or books based on isUserFile).
   void loadItemsFromFile(const std::string &filename, bool isUserFile);
 
   // Saves items to a file (users or books based on isUserFile).
-  void saveItemsToFile(const std::string &filename, bool isUserFile) const;
+  bool saveItemsToFile(const std::string &filename, bool isUserFile) const;
+
+  // Saves all books, users and loans to a binary snapshot file.
+  bool saveSnapshot(const std::string &filename) const;
+
+  // Loads a binary snapshot written by saveSnapshot. Returns false, leaving
+  // the library unchanged, if the file is missing or fails validation.
+  bool loadSnapshot(const std::string &filename);
+
+  // Replays the journal on top of the loaded files and keeps it open so
+  // that every add, borrow and return appends one record to it.
+  bool openJournal(const std::string &filename);
+
+  // Folds the journal into fresh books / users files and empties it.
+  // Refuses after a failed journal commit, so that changes reported as
+  // failed are not saved.
+  bool compactJournal(const std::string &booksFile,
+                      const std::string &usersFile);
+
+  // Finishes or discards a compaction interrupted by a crash. Call before
+  // loading the books / users files.
+  static bool recoverCompaction(const std::string &booksFile,
+                                const std::string &usersFile,
+                                const std::string &journalFile);
+
+  // Selects / reports synchronous, group-commit or async journaling.
+  void setDurability(const DurabilityOptions &options);
+  DurabilityOptions getDurability() const;
+
+  // Commits every pending journal record right away.
+  bool syncJournal();
+
+  // Returns true once a journal commit has failed. From then on every
+  // change is refused, since none of them could be made durable.
+  bool hasJournalFailed() const;
+
+  // Blocks until every journal record appended so far, by any thread, has
+  // been committed by the normal group-commit schedule.
+  bool waitForJournal();
+
+  // Returns journal batch size and commit latency counters.
+  JournalStats getJournalStats() const;
+
+  // Returns the time threads have spent waiting on each library lock.
+  LibraryLockContention getLockContention() const;
+
+  // Returns operation latencies, file I/O, lock waits, journal counters and
+  // catalog sizes.
+  LibraryMetrics getMetrics() const;
+
+  // Writes getMetrics() to filename in Prometheus text format.
+  bool writeMetricsFile(const std::string &filename) const;
 
   // Prints library items with a specified flag for formatting.
   void printLibraryItems(int flag) const;
 
-  // Handles borrowing a book by a user.
-  bool borrowBook(const std::string &userId, const std::string &bookId);
+  // Returns the columns of the records listing writes.
+  static std::vector<RecordColumn> listingColumns(Listing listing);
+
+  // Writes up to limit records of listing, starting at cursor, and returns
+  // the cursor to continue from. parameter is the report's N or days. The
+  // records go straight from the stores into writer's buffer, holding the
+  // catalog lock shared only for this page.
+  ListCursor writeListingPage(Listing listing, int parameter,
+                              const ListCursor &cursor, size_t limit,
+                              RecordWriter &writer) const;
+
+  // Writes the whole of listing to out in format, page by page. Returns
+  // false if the stream failed.
+  bool exportListing(Listing listing, int parameter, std::ostream &out,
+                     OutputFormat format) const;
 
-  // Handles returning a book by a user.
-  bool returnBook(const std::string &userId, const std::string &bookId);
+  // Handles borrowing a book by a user. With a journal open, the change is
+  // in the pending batch on return; pass waitForCommit to block until it
+  // has been committed under the current durability mode. Returns false if
+  // the journal has failed, or fails on this change; the loan then stays in
+  // memory but is not durable.
+  bool borrowBook(const std::string &userId, const std::string &bookId,
+                  bool waitForCommit = false);
+
+  // Handles returning a book by a user. See borrowBook for waitForCommit.
+  bool returnBook(const std::string &userId, const std::string &bookId,
+                  bool waitForCommit = false);
 
   // Finds a user by their ID.
   std::shared_ptr<User> findUserById(const std::string &userId) const;
@@ -39,18 +433,94 @@ public:
   std::shared_ptr<Book> findBookById(const std::string &bookId) const;
 
   // Searches for books based on a query and type (title, author, etc.).
-  std::vector<std::shared_ptr<Book>> searchBooks(const std::string &query,
-                                                 const std::string &type) const;
+  // Normalized mode compares the folded query with the search keys stored
+  // in each book (see foldText), so only the query is folded per search.
+  std::vector<std::shared_ptr<Book>>
+  searchBooks(const std::string &query, const std::string &type,
+              SearchMode mode = SearchMode::Exact) const;
+
+  // Returns up to k books whose title or author (type) has, for every word
+  // of query, a word within maxEdits insertions, deletions or substitutions
+  // of it, ignoring case and accents. Books come closest first by total edits,
+  // then in catalog order. A negative maxEdits picks a budget per word from
+  // its length (FuzzyIndex::defaultMaxEdits). Returns nothing for another
+  // type, a query without words, or a word over FuzzyIndex::maxWordLength
+  // bytes.
+  std::vector<FuzzyMatch> fuzzySearchBooks(const std::string &query,
+                                           const std::string &type, size_t k,
+                                           int maxEdits = -1) const;
+
+  // Returns up to k titles or authors (type) that start with prefix, or
+  // have a word that does, ignoring case and accents: those whose start
+  // matches first, then by total borrow count of their books, then in
+  // text order. Each distinct text is listed once. Returns nothing for
+  // another type or a prefix without letters or digits.
+  std::vector<BookCompletion> completeBooks(const std::string &prefix,
+                                            const std::string &type,
+                                            size_t k) const;
 
-  // Retrieves the top N most borrowed books.
+  // Returns the books matching filter, in catalog order. Answered from the
+  // year, category and availability indexes, visiting only the books in the
+  // smallest of the sets the filter names.
+  std::vector<std::shared_ptr<Book>> findBooks(const BookFilter &filter) const;
+
+  // Returns the number of books matching filter without listing them.
+  size_t countBooks(const BookFilter &filter) const;
+
+  // Return the number of books, and of those available, per category in
+  // category order and per decade in year order. Read from the index
+  // counters, not the books.
+  std::vector<CategoryCount> getCategoryCounts() const;
+  std::vector<DecadeCount> getDecadeCounts() const;
+
+  // Estimates how many books each predicate of query lets through, from the
+  // trigram and attribute indexes, and picks the access path expected to
+  // produce the fewest candidates: the trigram index of one text
+  // predicate, the attribute indexes, or a scan when no index narrows it.
+  QueryPlan planQuery(const BookQuery &query) const;
+
+  // Plans query and opens a cursor over its results; see BookCursor.
+  BookCursor queryBooks(const BookQuery &query) const;
+
+  // Returns a description of the plan queryBooks would use for query.
+  std::string explainQuery(const BookQuery &query) const;
+
+  // Returns a struct-of-arrays copy of every book, for scans and reports
+  // that want dense columns. Later changes are not reflected in it.
+  CompactCatalog getCompactCatalog() const;
+
+  // Returns the approximate memory used by the search indexes, in bytes.
+  size_t getSearchIndexMemoryUsage() const;
+
+  // Retrieves the top N books by lifetime borrow count. Ties keep catalog
+  // order; books never borrowed are not listed.
   std::vector<std::shared_ptr<Book>> getMostBorrowedBooks(int topN) const;
 
-  // Retrieves books that are overdue by a specified number of days.
+  // Retrieves books that are overdue by a specified number of days, oldest
+  // loan first.
   std::vector<std::shared_ptr<Book>> getOverdueBooks(int days) const;
 
-  // Returns a constant reference to all items in the system.
+  // Retrieves books whose loan period ends within the next days days,
+  // soonest first.
+  std::vector<std::shared_ptr<Book>> getBooksDueWithin(int days) const;
+
+  // Sets / gets the number of days a book may be kept.
+  void setLoanPeriod(int days);
+  int getLoanPeriod() const;
+
+  // Changes the recorded borrow date of an open loan. Returns false if the
+  // user does not have the book.
+  bool setBorrowDate(const std::string &userId, const std::string &bookId,
+                     std::chrono::system_clock::time_point borrowDate);
+
+  // Returns a constant reference to all items in the system. The reference
+  // is only stable while no items are being added.
   const std::vector<std::shared_ptr<Item>> &getItems() const;
 
+  // Returns all books / users in insertion order. Same caveat as getItems.
+  const std::vector<std::shared_ptr<Book>> &getBooks() const;
+  const std::vector<std::shared_ptr<User>> &getUsers() const;
+
   // Checks if a user has borrowed a specific book.
   bool hasBorrowedBook(const std::string &userId,
                        const std::string &bookId) const;
@@ -0,0 +1,82 @@
+#ifndef LOANINDEX_HPP
+#define LOANINDEX_HPP
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <unordered_map>
+
+// Open loans ordered by borrow date, so that overdue and due-soon queries
+// are range scans instead of walks over every user.
+class LoanIndex {
+public:
+  using TimePoint = std::chrono::system_clock::time_point;
+
+  // A single open loan.
+  struct Loan {
+    std::string userId;
+    std::string bookId;
+  };
+
+private:
+  using Entries = std::multimap<TimePoint, Loan>;
+
+  Entries byDate;
+  // Locates the entry of each (user, book) pair for removal.
+  std::unordered_map<std::string, Entries::iterator> byKey;
+
+  static std::string keyFor(const std::string &userId,
+                            const std::string &bookId);
+
+public:
+  // Records a loan, replacing any existing entry for the same pair.
+  void add(const std::string &userId, const std::string &bookId,
+           TimePoint borrowDate);
+
+  // Forgets a loan. Returns false if it was not indexed.
+  bool remove(const std::string &userId, const std::string &bookId);
+
+  // Calls fn(borrowDate, loan) for every loan borrowed in [from, to], oldest
+  // first.
+  template <typename Fn>
+  void forEachBorrowedBetween(TimePoint from, TimePoint to, Fn fn) const {
+    auto end = byDate.upper_bound(to);
+    for (auto it = byDate.lower_bound(from); it != end; ++it) {
+      fn(it->first, it->second);
+    }
+  }
+
+  // Calls fn(borrowDate, loan) for every loan borrowed at or before cutoff,
+  // oldest first.
+  template <typename Fn>
+  void forEachBorrowedBefore(TimePoint cutoff, Fn fn) const {
+    auto end = byDate.upper_bound(cutoff);
+    for (auto it = byDate.begin(); it != end; ++it) {
+      fn(it->first, it->second);
+    }
+  }
+
+  // Calls fn(borrowDate, loan) for loans borrowed in [from, to], oldest
+  // first, after passing over the first skip loans borrowed exactly at
+  // from. Stops early once fn returns false. Used to resume a paged
+  // listing.
+  template <typename Fn>
+  void forEachBorrowedFrom(TimePoint from, size_t skip, TimePoint to,
+                           Fn fn) const {
+    auto end = byDate.upper_bound(to);
+    auto it = byDate.lower_bound(from);
+    for (; it != end && skip > 0 && it->first == from; --skip) {
+      ++it;
+    }
+    for (; it != end; ++it) {
+      if (!fn(it->first, it->second)) {
+        return;
+      }
+    }
+  }
+
+  // Returns the number of open loans.
+  size_t size() const;
+};
+
+#endif // LOANINDEX_HPP
@@ -0,0 +1,31 @@
+#ifndef MAPPEDFILE_HPP
+#define MAPPEDFILE_HPP
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Read-only memory mapping of a whole file.
+class MappedFile {
+private:
+  const char *data = nullptr;
+  size_t length = 0;
+
+public:
+  MappedFile() = default;
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  // Maps the file. An empty file maps successfully to an empty view.
+  bool open(const std::string &filename);
+
+  // Unmaps the file.
+  void close();
+
+  // Returns the mapped bytes; valid until close or destruction.
+  std::string_view view() const;
+};
+
+#endif // MAPPEDFILE_HPP
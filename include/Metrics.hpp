@@ -0,0 +1,151 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include "Journal.hpp"
+#include "LatencyHistogram.hpp"
+#include "TimedMutex.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Library operations whose latency is tracked.
+enum class LibraryOperation : size_t {
+  AddItem,
+  Borrow,
+  Return,
+  Search,
+  MostBorrowed,
+  Overdue,
+  DueSoon,
+  Import,
+  Find,
+  Query,
+  FuzzySearch,
+  Complete,
+  Count
+};
+
+// Kinds of file I/O whose volume and duration are tracked.
+enum class IoKind : size_t {
+  LoadFile,
+  SaveFile,
+  LoadSnapshot,
+  SaveSnapshot,
+  Count
+};
+
+static const size_t operationCount =
+    static_cast<size_t>(LibraryOperation::Count);
+static const size_t ioKindCount = static_cast<size_t>(IoKind::Count);
+
+// Counters of one operation, with its latencies in nanoseconds in the same
+// histogram the load driver uses.
+struct OperationMetrics {
+  uint64_t calls = 0;
+  uint64_t failures = 0; // Calls that returned false.
+  uint64_t totalNs = 0;
+  LatencyHistogram latency;
+};
+
+// Counters of one kind of file I/O.
+struct IoMetrics {
+  uint64_t operations = 0;
+  uint64_t bytes = 0;
+  uint64_t totalNs = 0;
+};
+
+// Everything LibrarySystem reports about itself at one point in time.
+struct LibraryMetrics {
+  std::array<OperationMetrics, operationCount> operations;
+  std::array<IoMetrics, ioKindCount> io;
+  std::vector<std::pair<std::string, LockContention>> locks;
+  JournalStats journal;
+  size_t books = 0;
+  size_t users = 0;
+  size_t openLoans = 0;
+
+  // Human-readable table, for the menu.
+  void writeSummary(std::ostream &out) const;
+
+  // Prometheus text exposition format, for scraping from a file.
+  void writePrometheus(std::ostream &out) const;
+
+  // "name=value;..." on one line, for the command protocol.
+  void appendCompact(std::string &out) const;
+};
+
+const char *operationName(LibraryOperation operation);
+const char *ioKindName(IoKind kind);
+
+// Always-on counters for LibrarySystem. Recording is a handful of relaxed
+// atomic adds into one of several cache-line-aligned shards, picked per
+// thread, so concurrent callers rarely share a line. Reading sums the
+// shards, which is slower but only done on request.
+class Metrics {
+private:
+  static const size_t shardCount = 16;
+
+  struct OperationCounters {
+    std::atomic<uint64_t> calls{0};
+    std::atomic<uint64_t> failures{0};
+    std::atomic<uint64_t> totalNs{0};
+    AtomicLatencyHistogram latency;
+  };
+
+  struct alignas(64) Shard {
+    std::array<OperationCounters, operationCount> operations;
+  };
+
+  struct IoCounters {
+    std::atomic<uint64_t> operations{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> totalNs{0};
+  };
+
+  std::array<Shard, shardCount> shards;
+  std::array<IoCounters, ioKindCount> io;
+
+  static size_t shardIndex();
+
+public:
+  using Clock = std::chrono::steady_clock;
+
+  // Records one call of operation that started at start.
+  void record(LibraryOperation operation, Clock::time_point start,
+              bool succeeded);
+
+  // Records one file read or write.
+  void recordIo(IoKind kind, uint64_t bytes, Clock::time_point start);
+
+  // Adds the counters to metrics.
+  void collect(LibraryMetrics &metrics) const;
+};
+
+// Times an operation from construction to destruction. Call fail() on the
+// paths where the operation returns false.
+class OperationTimer {
+private:
+  Metrics &metrics;
+  LibraryOperation operation;
+  Metrics::Clock::time_point start;
+  bool succeeded = true;
+
+public:
+  OperationTimer(Metrics &metrics, LibraryOperation operation)
+      : metrics(metrics), operation(operation),
+        start(Metrics::Clock::now()) {}
+  ~OperationTimer() { metrics.record(operation, start, succeeded); }
+
+  OperationTimer(const OperationTimer &) = delete;
+  OperationTimer &operator=(const OperationTimer &) = delete;
+
+  void fail() { succeeded = false; }
+};
+
+#endif // METRICS_HPP
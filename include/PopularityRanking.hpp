@@ -0,0 +1,44 @@
+#ifndef POPULARITYRANKING_HPP
+#define POPULARITYRANKING_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <vector>
+
+// Books ordered by lifetime borrow count, highest first. Books with the same
+// count keep catalog order. Documents are positions in the book store, and
+// only books borrowed at least once are ranked.
+class PopularityRanking {
+private:
+  struct Entry {
+    int count;
+    uint32_t doc;
+
+    bool operator<(const Entry &other) const {
+      if (count != other.count) {
+        return count > other.count;
+      }
+      return doc < other.doc;
+    }
+  };
+
+  std::set<Entry> ranking;
+  std::vector<int> counts; // Current count of every document.
+
+public:
+  // Registers a new document with its current count.
+  void add(uint32_t doc, int count);
+
+  // Moves a document to its new count in O(log n).
+  void update(uint32_t doc, int count);
+
+  // Calls fn(doc) for the n highest ranked documents, in rank order.
+  template <typename Fn> void forEachTop(size_t n, Fn fn) const {
+    for (auto it = ranking.begin(); it != ranking.end() && n > 0; ++it, --n) {
+      fn(it->doc);
+    }
+  }
+};
+
+#endif // POPULARITYRANKING_HPP
@@ -0,0 +1,78 @@
+#ifndef RECORDWRITER_HPP
+#define RECORDWRITER_HPP
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// How RecordWriter lays out its records.
+enum class OutputFormat {
+  Table,     // Padded columns under a header, for people.
+  Csv,       // RFC 4180 with a header row.
+  JsonLines, // One JSON object per record, keyed by column name.
+};
+
+// Parses "table", "csv" or "jsonl". Returns false for anything else.
+bool parseOutputFormat(std::string_view name, OutputFormat &format);
+
+// One column of a record: its name, used as CSV header and JSON key, and
+// its minimum width in a table.
+struct RecordColumn {
+  std::string_view name;
+  size_t width;
+};
+
+// Formats records field by field into a large buffer and hands the buffer
+// to the stream in blocks, so writing a listing costs a few stream calls
+// per thousand records instead of several per field, and never flushes a
+// line at a time. The header is written with the first record.
+class RecordWriter {
+private:
+  std::ostream &out;
+  OutputFormat format;
+  std::vector<RecordColumn> columns;
+  std::string buffer;
+  size_t column = 0; // Index of the next field in the current record.
+  size_t rows = 0;
+  bool headerWritten = false;
+
+  // Writes the header for the chosen format into the buffer.
+  void writeHeader();
+
+  // Starts the next field: header, separators and JSON key as needed.
+  void beginField();
+
+  // Appends value escaped for the format, then pads table cells.
+  void appendText(std::string_view value, bool quoteInJson);
+
+public:
+  // Bytes buffered before they are written to the stream.
+  static const size_t blockBytes = 64 * 1024;
+
+  RecordWriter(std::ostream &out, OutputFormat format,
+               std::vector<RecordColumn> columns);
+
+  // Writes out anything still buffered.
+  ~RecordWriter();
+
+  RecordWriter(const RecordWriter &) = delete;
+  RecordWriter &operator=(const RecordWriter &) = delete;
+
+  // Add the next field of the current record, in column order.
+  void text(std::string_view value);
+  void number(int64_t value);
+  void flag(bool value);
+
+  // Ends the current record.
+  void endRecord();
+
+  // Writes the buffer to the stream. Returns false if the stream failed.
+  bool flush();
+
+  // Returns the number of records ended so far.
+  size_t recordCount() const;
+};
+
+#endif // RECORDWRITER_HPP
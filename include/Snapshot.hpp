@@ -0,0 +1,108 @@
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+#include "Book.hpp"
+#include "MappedFile.hpp"
+#include "User.hpp"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// On-disk layout of a binary snapshot, in host byte order:
+//
+//   SnapshotHeader
+//   SnapshotBook[bookCount]
+//   SnapshotUser[userCount]
+//   SnapshotLoan[loanCount]
+//   string pool (stringPoolSize bytes)
+//
+// Every record has a fixed width and refers to its text through
+// SnapshotString offsets into the pool, so a mapped file can be read in
+// place. The checksum covers everything after the header.
+
+// Reference to a string in the pool.
+struct SnapshotString {
+  uint32_t offset;
+  uint32_t length;
+};
+
+struct SnapshotHeader {
+  char magic[8]; // "BMSNAP\0\0"
+  uint32_t version;
+  uint32_t headerSize;
+  uint64_t bookCount;
+  uint64_t userCount;
+  uint64_t loanCount;
+  uint64_t stringPoolSize;
+  uint64_t checksum;
+};
+
+struct SnapshotBook {
+  SnapshotString id;
+  SnapshotString title;
+  SnapshotString author;
+  SnapshotString category;
+  int32_t year;
+  int32_t borrowCount;
+  uint8_t available;
+  uint8_t reserved[7];
+};
+
+// A user's loans are loans[firstLoan, firstLoan + loanCount).
+struct SnapshotUser {
+  SnapshotString id;
+  SnapshotString name;
+  SnapshotString email;
+  SnapshotString phone;
+  uint32_t firstLoan;
+  uint32_t loanCount;
+};
+
+struct SnapshotLoan {
+  SnapshotString bookId;
+  int64_t borrowedAt; // Seconds since the epoch.
+};
+
+// Read-only, validated view of a snapshot file used straight from the
+// mapping.
+class SnapshotView {
+private:
+  MappedFile file;
+  const SnapshotHeader *header = nullptr;
+  const SnapshotBook *bookRecords = nullptr;
+  const SnapshotUser *userRecords = nullptr;
+  const SnapshotLoan *loanRecords = nullptr;
+  const char *pool = nullptr;
+
+public:
+  // Maps and validates the file. On failure, error says why.
+  bool open(const std::string &filename, std::string &error);
+
+  size_t bookCount() const;
+  size_t userCount() const;
+  size_t loanCount() const;
+  const SnapshotBook &book(size_t index) const;
+  const SnapshotUser &user(size_t index) const;
+  const SnapshotLoan &loan(size_t index) const;
+
+  // Resolves a string reference against the pool.
+  std::string_view string(SnapshotString ref) const;
+};
+
+// Writes and checks binary snapshots.
+class Snapshot {
+public:
+  static const uint32_t currentVersion = 1;
+
+  // Writes books and users (with their loans) to filename.
+  static bool write(const std::string &filename,
+                    const std::vector<std::shared_ptr<Book>> &books,
+                    const std::vector<std::shared_ptr<User>> &users);
+
+  // Checksum used for the snapshot body.
+  static uint64_t checksum(const char *data, size_t size);
+};
+
+#endif // SNAPSHOT_HPP
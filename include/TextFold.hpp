@@ -0,0 +1,23 @@
+#ifndef TEXTFOLD_HPP
+#define TEXTFOLD_HPP
+
+#include <string>
+#include <string_view>
+
+// Stores in out the search key of UTF-8 text: ASCII letters lowered, Latin
+// letters with diacritics reduced to their base letter ("Nguyễn" becomes
+// "nguyen", "Đà Nẵng" becomes "da nang"), ligatures such as "æ" and "ß"
+// spelled out, and combining accents dropped. Everything else, including
+// bytes that are not valid UTF-8, is copied unchanged. Each character is
+// folded on its own, so if a is a substring of b made of whole characters,
+// the key of a is a substring of the key of b.
+void foldText(std::string_view text, std::string &out);
+
+// Returns the search key of text.
+std::string foldText(std::string_view text);
+
+// Returns true if text is a sequence of whole UTF-8 characters, so that it
+// can only occur in other text at character boundaries.
+bool isWholeUtf8(std::string_view text);
+
+#endif // TEXTFOLD_HPP
@@ -0,0 +1,40 @@
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads running submitted tasks in FIFO order.
+class ThreadPool {
+private:
+  std::vector<std::thread> workers;
+  std::deque<std::function<void()>> tasks;
+  std::mutex mutex;
+  std::condition_variable ready;
+  bool stopping = false;
+
+  // Runs tasks until the pool is stopped and the queue is empty.
+  void workerLoop();
+
+public:
+  // Starts the given number of workers (at least one).
+  explicit ThreadPool(size_t threadCount);
+
+  // Finishes every queued task, then joins the workers.
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  // Queues a task for the next free worker.
+  void submit(std::function<void()> task);
+
+  // Returns the number of workers.
+  size_t size() const;
+};
+
+#endif // THREADPOOL_HPP
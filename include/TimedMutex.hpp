@@ -0,0 +1,68 @@
+#ifndef TIMEDMUTEX_HPP
+#define TIMEDMUTEX_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// How often, and for how long in total, callers had to wait for a lock.
+struct LockContention {
+  uint64_t contended = 0; // Acquisitions that found the lock taken.
+  uint64_t waitNs = 0;    // Time spent blocked in those acquisitions.
+
+  LockContention &operator+=(const LockContention &other) {
+    contended += other.contended;
+    waitNs += other.waitNs;
+    return *this;
+  }
+};
+
+// Wraps std::mutex or std::shared_mutex and records the time callers spend
+// blocked on it. An acquisition first tries the lock; only when that fails
+// is the wait timed and counted, so the uncontended path costs nothing
+// extra and readers never write a shared counter.
+template <typename Mutex> class TimedMutex {
+private:
+  Mutex mutex;
+  std::atomic<uint64_t> contended{0};
+  std::atomic<uint64_t> waitNs{0};
+
+  // Blocks in acquire, charging the wait to this lock.
+  template <typename Acquire> void wait(Acquire acquire) {
+    auto start = std::chrono::steady_clock::now();
+    acquire();
+    auto waited = std::chrono::steady_clock::now() - start;
+    contended.fetch_add(1, std::memory_order_relaxed);
+    waitNs.fetch_add(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(waited).count(),
+        std::memory_order_relaxed);
+  }
+
+public:
+  void lock() {
+    if (!mutex.try_lock()) {
+      wait([this] { mutex.lock(); });
+    }
+  }
+  bool try_lock() { return mutex.try_lock(); }
+  void unlock() { mutex.unlock(); }
+
+  // Shared ownership, for wrapped shared mutexes.
+  void lock_shared() {
+    if (!mutex.try_lock_shared()) {
+      wait([this] { mutex.lock_shared(); });
+    }
+  }
+  bool try_lock_shared() { return mutex.try_lock_shared(); }
+  void unlock_shared() { mutex.unlock_shared(); }
+
+  // Returns the waits recorded so far.
+  LockContention getContention() const {
+    LockContention result;
+    result.contended = contended.load(std::memory_order_relaxed);
+    result.waitNs = waitNs.load(std::memory_order_relaxed);
+    return result;
+  }
+};
+
+#endif // TIMEDMUTEX_HPP
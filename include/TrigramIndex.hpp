@@ -0,0 +1,53 @@
+#ifndef TRIGRAMINDEX_HPP
+#define TRIGRAMINDEX_HPP
+
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Inverted index from every 3-byte substring of a text field to the
+// documents containing it. Documents are identified by their position in
+// the book store and must be added in increasing order, which keeps every
+// posting list sorted.
+class TrigramIndex {
+private:
+  std::unordered_map<uint32_t, std::vector<uint32_t>> postings;
+
+  // Appends the distinct trigrams of text to out.
+  static void trigramsOf(std::string_view text, std::vector<uint32_t> &out);
+
+public:
+  // Shortest query the index can answer; shorter ones need a scan.
+  static const size_t gramLength = 3;
+
+  // Indexes text as document doc.
+  void add(uint32_t doc, std::string_view text);
+
+  // The text of an already added document changing from oldText to newText.
+  struct TextChange {
+    uint32_t doc;
+    std::string_view oldText;
+    std::string_view newText;
+  };
+
+  // Reindexes every changed document, each listed at most once. Only the
+  // trigrams that differ are touched, and each affected posting list is
+  // rewritten once however many documents in it changed.
+  void replace(const std::vector<TextChange> &changes);
+
+  // Stores in out, in increasing order, every document containing all
+  // trigrams of query. These are candidates: callers still check that the
+  // text really contains query. Requires query.size() >= gramLength.
+  void candidates(std::string_view query, std::vector<uint32_t> &out) const;
+
+  // Returns an upper bound on the number of candidates for query: the
+  // length of its shortest posting list, or 0 if a trigram occurs nowhere.
+  // Costs one hash lookup per trigram. Requires query.size() >= gramLength.
+  size_t estimate(std::string_view query) const;
+
+  // Approximate heap memory used by the index, in bytes.
+  size_t memoryUsage() const;
+};
+
+#endif // TRIGRAMINDEX_HPP
@@ -1,31 +1,32 @@
 #ifndef USER_HPP
 #define USER_HPP
 
+#include "Arena.hpp"
 #include "Item.hpp"
 #include <chrono>
+#include <memory_resource>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
-class LibrarySystem; // Forward declaration of LibrarySystem for use in User
-                     // class.
-
 // Represents a user in the library system, inheriting from Item.
 class User : public Item {
 private:
   // Private member variables for storing user attributes and borrowed book
-  std::string id;
-  std::string name;
-  std::string email;
-  std::string phone;
+  // ID, name, email and phone, in one block from the resource the user was
+  // created with. The borrowed list changes, so it stays on the heap.
+  PackedStrings<4> text;
   std::vector<std::string> borrowedBooks;
   std::unordered_map<std::string, std::chrono::system_clock::time_point>
       borrowDates;
 
 public:
-  // Constructor to initialize a User object with its attributes.
-  User(const std::string &id, const std::string &name, const std::string &email,
-       const std::string &phone);
+  // Constructor to initialize a User object with its attributes. The text
+  // fields are copied into memory from resource, which must outlive the user.
+  User(std::string_view id, std::string_view name, std::string_view email,
+       std::string_view phone,
+       std::pmr::memory_resource *resource = std::pmr::new_delete_resource());
 
   // Overrides from Item class.
   std::string getId() const override;
@@ -38,8 +39,19 @@ public:
   void setBorrowedBooks(const std::vector<std::string> &borrowedBooks);
   std::vector<std::string> getBorrowedBooks() const;
 
+  // Non-copying views of the contact fields, valid as long as the user is.
+  std::string_view getIdView() const;
+  std::string_view getNameView() const;
+  std::string_view getEmailView() const;
+  std::string_view getPhoneView() const;
+
+  // The borrowed list itself rather than a copy. Only safe while nothing
+  // can borrow or return for this user, e.g. under its loan stripe.
+  const std::vector<std::string> &getBorrowedBooksView() const;
+
   // Methods to manage borrowed books.
-  void addBorrowedBook(const std::string &bookId, LibrarySystem &librarySystem);
+  void addBorrowedBook(const std::string &bookId,
+                       const std::chrono::system_clock::time_point &date);
   void removeBorrowedBook(const std::string &bookId);
   std::chrono::system_clock::time_point
   getBorrowDate(const std::string &bookId) const;
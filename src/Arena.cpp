@@ -0,0 +1,44 @@
+#include "Arena.hpp"
+#include <algorithm>
+
+// Starts empty; the first allocation takes the first block.
+Arena::Arena(size_t blockSize) : blockSize(std::max<size_t>(blockSize, 64)) {}
+
+// Bumps the cursor within the current block, opening a new block when the
+// request does not fit. The tail of the old block is left unused.
+void *Arena::do_allocate(size_t bytes, size_t alignment) {
+  std::lock_guard<std::mutex> lock(mutex);
+  void *start = cursor;
+  size_t space = static_cast<size_t>(end - cursor);
+  if (!cursor || !std::align(alignment, bytes, start, space)) {
+    size_t size = std::max(blockSize, bytes + alignment);
+    blocks.emplace_back(new char[size]); // Not zeroed, unlike make_unique.
+    reserved += size;
+    cursor = blocks.back().get();
+    end = cursor + size;
+    start = cursor;
+    space = size;
+    std::align(alignment, bytes, start, space);
+  }
+  cursor = static_cast<char *>(start) + bytes;
+  used += bytes;
+  return start;
+}
+
+// Bytes handed out so far.
+size_t Arena::bytesUsed() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return used;
+}
+
+// Bytes held in blocks, including unused tails.
+size_t Arena::bytesReserved() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return reserved;
+}
+
+// Number of blocks held.
+size_t Arena::blockCount() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return blocks.size();
+}
@@ -0,0 +1,309 @@
+#include "AttributeIndex.hpp"
+#include <algorithm>
+
+// Inserts doc in a sorted posting list. New documents have the highest
+// number so far and are appended.
+void AttributeIndex::insertDoc(Posting &posting, uint32_t doc,
+                               bool available) {
+  auto &docs = posting.docs;
+  if (docs.empty() || docs.back() < doc) {
+    docs.push_back(doc);
+  } else {
+    docs.insert(std::lower_bound(docs.begin(), docs.end(), doc), doc);
+  }
+  if (available) {
+    posting.available.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+// Removes doc from a sorted posting list.
+void AttributeIndex::eraseDoc(Posting &posting, uint32_t doc,
+                              bool available) {
+  auto &docs = posting.docs;
+  auto it = std::lower_bound(docs.begin(), docs.end(), doc);
+  if (it != docs.end() && *it == doc) {
+    docs.erase(it);
+    if (available) {
+      posting.available.fetch_sub(1, std::memory_order_relaxed);
+    }
+  }
+}
+
+// Returns true if doc's bit is set in the availability bitmap.
+static bool bitOf(const std::deque<std::atomic<uint64_t>> &bits,
+                  uint32_t doc) {
+  return (bits[doc / 64].load(std::memory_order_relaxed) >> (doc % 64)) & 1;
+}
+
+// Returns the years within the filter's range; empty if it is reversed.
+std::pair<AttributeIndex::YearIterator, AttributeIndex::YearIterator>
+AttributeIndex::yearRange(const BookFilter &filter) const {
+  if (filter.yearFrom && filter.yearTo && *filter.yearFrom > *filter.yearTo) {
+    return {byYear.end(), byYear.end()};
+  }
+  auto begin = filter.yearFrom ? byYear.lower_bound(*filter.yearFrom)
+                               : byYear.begin();
+  auto end =
+      filter.yearTo ? byYear.upper_bound(*filter.yearTo) : byYear.end();
+  return {begin, end};
+}
+
+// Looks up the category the filter asks for.
+const AttributeIndex::Posting *
+AttributeIndex::categoryPosting(const BookFilter &filter,
+                                bool &missing) const {
+  missing = false;
+  if (!filter.category) {
+    return nullptr;
+  }
+  auto it = byCategory.find(*filter.category);
+  if (it == byCategory.end()) {
+    missing = true;
+    return nullptr;
+  }
+  return &it->second;
+}
+
+// Checks doc against every condition of filter. category is the filter's
+// category posting, already looked up.
+bool AttributeIndex::matches(uint32_t doc, const BookFilter &filter,
+                             const Posting *category) const {
+  if (category && categoryOf[doc] != category) {
+    return false;
+  }
+  int year = yearValues[doc];
+  if ((filter.yearFrom && year < *filter.yearFrom) ||
+      (filter.yearTo && year > *filter.yearTo)) {
+    return false;
+  }
+  return !filter.available || bitOf(availableBits, doc) == *filter.available;
+}
+
+// Indexes a new document.
+void AttributeIndex::add(uint32_t doc, int year, std::string_view category,
+                         bool available) {
+  if (doc >= yearValues.size()) {
+    yearOf.resize(doc + 1, nullptr);
+    categoryOf.resize(doc + 1, nullptr);
+    yearValues.resize(doc + 1, 0);
+  }
+  while (availableBits.size() * 64 <= doc) {
+    availableBits.emplace_back(0);
+  }
+
+  Posting &yearPosting = byYear.try_emplace(year).first->second;
+  Posting &categoryPosting =
+      byCategory.try_emplace(std::string(category)).first->second;
+  insertDoc(yearPosting, doc, available);
+  insertDoc(categoryPosting, doc, available);
+  yearOf[doc] = &yearPosting;
+  categoryOf[doc] = &categoryPosting;
+  yearValues[doc] = year;
+  if (available) {
+    availableBits[doc / 64].fetch_or(uint64_t(1) << (doc % 64),
+                                     std::memory_order_relaxed);
+    availableTotal.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+// Moves an indexed document to a new year and category. Only lists whose
+// key actually changed are touched.
+void AttributeIndex::update(uint32_t doc, int year,
+                            std::string_view category) {
+  bool available = bitOf(availableBits, doc);
+  Posting &yearPosting = byYear.try_emplace(year).first->second;
+  if (&yearPosting != yearOf[doc]) {
+    eraseDoc(*yearOf[doc], doc, available);
+    insertDoc(yearPosting, doc, available);
+    yearOf[doc] = &yearPosting;
+    yearValues[doc] = year;
+  }
+  auto it = byCategory.find(std::string(category));
+  if (it == byCategory.end()) {
+    it = byCategory.try_emplace(std::string(category)).first;
+  }
+  if (&it->second != categoryOf[doc]) {
+    eraseDoc(*categoryOf[doc], doc, available);
+    insertDoc(it->second, doc, available);
+    categoryOf[doc] = &it->second;
+  }
+}
+
+// Flips doc's bit and, if it changed, the available counts of its year,
+// its category and the whole catalog.
+void AttributeIndex::setAvailable(uint32_t doc, bool available) {
+  uint64_t mask = uint64_t(1) << (doc % 64);
+  auto &word = availableBits[doc / 64];
+  uint64_t old = available ? word.fetch_or(mask, std::memory_order_relaxed)
+                           : word.fetch_and(~mask, std::memory_order_relaxed);
+  if (((old & mask) != 0) == available) {
+    return;
+  }
+  if (available) {
+    yearOf[doc]->available.fetch_add(1, std::memory_order_relaxed);
+    categoryOf[doc]->available.fetch_add(1, std::memory_order_relaxed);
+    availableTotal.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    yearOf[doc]->available.fetch_sub(1, std::memory_order_relaxed);
+    categoryOf[doc]->available.fetch_sub(1, std::memory_order_relaxed);
+    availableTotal.fetch_sub(1, std::memory_order_relaxed);
+  }
+}
+
+// Picks the smallest candidate set, walks it, and checks the rest of the
+// filter per document. Year ranges span several lists and are sorted
+// afterwards; the other sets are walked in order.
+void AttributeIndex::find(const BookFilter &filter,
+                          std::vector<uint32_t> &out) const {
+  out.clear();
+  bool missing;
+  const Posting *category = categoryPosting(filter, missing);
+  if (missing) {
+    return;
+  }
+
+  size_t total = yearValues.size();
+  bool byYearRange = filter.yearFrom || filter.yearTo;
+  auto [yearBegin, yearEnd] = yearRange(filter);
+  size_t yearSize = total;
+  if (byYearRange) {
+    yearSize = 0;
+    for (auto it = yearBegin; it != yearEnd; ++it) {
+      yearSize += it->second.docs.size();
+    }
+  }
+  size_t bitmapSize = total;
+  if (filter.available) {
+    size_t available =
+        std::min(availableTotal.load(std::memory_order_relaxed), total);
+    bitmapSize = *filter.available ? available : total - available;
+  }
+
+  if (category && category->docs.size() <= yearSize &&
+      category->docs.size() <= bitmapSize) {
+    for (uint32_t doc : category->docs) {
+      if (matches(doc, filter, category)) {
+        out.push_back(doc);
+      }
+    }
+  } else if (byYearRange && yearSize <= bitmapSize) {
+    for (auto it = yearBegin; it != yearEnd; ++it) {
+      for (uint32_t doc : it->second.docs) {
+        if (matches(doc, filter, category)) {
+          out.push_back(doc);
+        }
+      }
+    }
+    std::sort(out.begin(), out.end());
+  } else {
+    // Walk the bitmap a word at a time, skipping words with no candidate.
+    for (size_t w = 0; w * 64 < total; ++w) {
+      uint64_t bits = ~uint64_t(0);
+      if (filter.available) {
+        bits = availableBits[w].load(std::memory_order_relaxed);
+        if (!*filter.available) {
+          bits = ~bits;
+        }
+      }
+      if (total - w * 64 < 64) {
+        bits &= (uint64_t(1) << (total - w * 64)) - 1;
+      }
+      while (bits) {
+        auto doc = static_cast<uint32_t>(w * 64 + __builtin_ctzll(bits));
+        bits &= bits - 1;
+        if (matches(doc, filter, category)) {
+          out.push_back(doc);
+        }
+      }
+    }
+  }
+}
+
+// Counts from the list sizes and available counters where one index
+// covers the filter, and falls back to find for category with year.
+size_t AttributeIndex::count(const BookFilter &filter) const {
+  bool missing;
+  const Posting *category = categoryPosting(filter, missing);
+  if (missing) {
+    return 0;
+  }
+  bool byYearRange = filter.yearFrom || filter.yearTo;
+  if (category && byYearRange) {
+    std::vector<uint32_t> docs;
+    find(filter, docs);
+    return docs.size();
+  }
+
+  size_t books = 0;
+  size_t available = 0;
+  if (category) {
+    books = category->docs.size();
+    available = category->available.load(std::memory_order_relaxed);
+  } else if (byYearRange) {
+    auto [yearBegin, yearEnd] = yearRange(filter);
+    for (auto it = yearBegin; it != yearEnd; ++it) {
+      books += it->second.docs.size();
+      available += it->second.available.load(std::memory_order_relaxed);
+    }
+  } else {
+    books = yearValues.size();
+    available = availableTotal.load(std::memory_order_relaxed);
+  }
+  available = std::min(available, books);
+  if (!filter.available) {
+    return books;
+  }
+  return *filter.available ? available : books - available;
+}
+
+// Returns the books per category, skipping categories no book has anymore.
+std::vector<CategoryCount> AttributeIndex::categoryCounts() const {
+  std::vector<CategoryCount> counts;
+  counts.reserve(byCategory.size());
+  for (const auto &[category, posting] : byCategory) {
+    if (!posting.docs.empty()) {
+      counts.push_back({category, posting.docs.size(),
+                        posting.available.load(std::memory_order_relaxed)});
+    }
+  }
+  std::sort(counts.begin(), counts.end(),
+            [](const CategoryCount &a, const CategoryCount &b) {
+              return a.category < b.category;
+            });
+  return counts;
+}
+
+// Folds the year index into decades, in year order.
+std::vector<DecadeCount> AttributeIndex::decadeCounts() const {
+  std::vector<DecadeCount> counts;
+  for (const auto &[year, posting] : byYear) {
+    if (posting.docs.empty()) {
+      continue;
+    }
+    int decade = year - ((year % 10) + 10) % 10; // Rounds down below zero.
+    if (counts.empty() || counts.back().decade != decade) {
+      counts.push_back({decade, 0, 0});
+    }
+    counts.back().books += posting.docs.size();
+    counts.back().available +=
+        posting.available.load(std::memory_order_relaxed);
+  }
+  return counts;
+}
+
+// Approximate heap memory used by the index, in bytes.
+size_t AttributeIndex::memoryUsage() const {
+  size_t bytes = availableBits.size() * sizeof(uint64_t) +
+                 yearOf.capacity() * sizeof(Posting *) +
+                 categoryOf.capacity() * sizeof(Posting *) +
+                 yearValues.capacity() * sizeof(int);
+  for (const auto &[year, posting] : byYear) {
+    bytes += sizeof(Posting) + 4 * sizeof(void *) +
+             posting.docs.capacity() * sizeof(uint32_t);
+  }
+  for (const auto &[category, posting] : byCategory) {
+    bytes += sizeof(Posting) + sizeof(std::string) + category.capacity() +
+             2 * sizeof(void *) + posting.docs.capacity() * sizeof(uint32_t);
+  }
+  return bytes;
+}
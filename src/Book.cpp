@@ -1,26 +1,53 @@
 #include "Book.hpp"
+#include "TextFold.hpp"
 #include <iostream>
 
+// Packs the text fields of a new book with the search keys of its title,
+// author and category. The keys are folded in per-thread buffers that keep
+// their capacity, so loading a catalog does not allocate for them.
+static PackedStrings<7> packText(std::string_view id, std::string_view title,
+                                 std::string_view author,
+                                 std::string_view category,
+                                 std::pmr::memory_resource *resource) {
+  thread_local std::string keys[3];
+  foldText(title, keys[0]);
+  foldText(author, keys[1]);
+  foldText(category, keys[2]);
+  return PackedStrings<7>(
+      {id, title, author, category, keys[0], keys[1], keys[2]}, resource);
+}
+
 // Constructor to initialize a Book object with its attributes.
-Book::Book(const std::string &id, const std::string &title,
-           const std::string &author, const std::string &category, int year,
-           bool isAvailable)
-    : id(id), title(title), author(author), category(category), year(year),
-      available(isAvailable) {
+Book::Book(std::string_view id, std::string_view title,
+           std::string_view author, std::string_view category, int year,
+           bool isAvailable, std::pmr::memory_resource *resource)
+    : text(packText(id, title, author, category, resource)), year(year),
+      available(isAvailable), borrowCount(0) {
   // Initialization of member variables done through the initializer list.
 }
 
 // Getter for the book ID.
-std::string Book::getId() const { return id; }
+std::string Book::getId() const { return std::string(text.get(0)); }
 
 // Getter for the book title.
-std::string Book::getTitle() const { return title; }
+std::string Book::getTitle() const { return std::string(text.get(1)); }
 
 // Getter for the book author.
-std::string Book::getAuthor() const { return author; }
+std::string Book::getAuthor() const { return std::string(text.get(2)); }
 
 // Getter for the book category.
-std::string Book::getCategory() const { return category; }
+std::string Book::getCategory() const { return std::string(text.get(3)); }
+
+// Non-copying views of the text fields.
+std::string_view Book::getIdView() const { return text.get(0); }
+std::string_view Book::getTitleView() const { return text.get(1); }
+std::string_view Book::getAuthorView() const { return text.get(2); }
+std::string_view Book::getCategoryView() const { return text.get(3); }
+
+// Search keys of the text fields.
+std::string_view Book::getFoldedTitleView() const { return text.get(4); }
+std::string_view Book::getFoldedAuthorView() const { return text.get(5); }
+std::string_view Book::getFoldedCategoryView() const { return text.get(6); }
 
 // Getter for the book publication year.
 int Book::getYear() const { return year; }
@@ -34,13 +61,23 @@ void Book::incrementBorrowCount() { ++borrowCount; }
 // Getter for the borrow count of the book.
 int Book::getBorrowCount() const { return borrowCount; }
 
+// Restores the borrow count, e.g. from a snapshot.
+void Book::setBorrowCount(int count) { borrowCount = count; }
+
 // Display the book's details.
 void Book::display() const {
-  std::cout << "Book ID: " << id << ", Title: " << title
-            << ", Author: " << author << ", Category: " << category
+  std::cout << "Book ID: " << getIdView() << ", Title: " << getTitleView()
+            << ", Author: " << getAuthorView()
+            << ", Category: " << getCategoryView()
             << ", Year: " << year
-            << ", Available: " << (available ? "Yes" : "No") << std::endl;
+            << ", Available: " << (available ? "Yes" : "No") << "\n";
 }
 
 // Setter for updating the availability status of the book.
 void Book::setAvailable(bool availability) { available = availability; }
+
+// Marks the book as borrowed if, and only if, it is currently available.
+bool Book::tryCheckOut() {
+  bool expected = true;
+  return available.compare_exchange_strong(expected, false);
+}
@@ -0,0 +1,389 @@
+#include "BookQuery.hpp"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <climits>
+#include <iomanip>
+#include <sstream>
+
+static const char *const fieldNames[] = {"title", "author", "category", "year",
+                                         "available"};
+static const char *const opNames[] = {"~", "=", "<", "<=", ">", ">="};
+
+// Returns true if book meets the condition.
+bool QueryPredicate::matches(const Book &book) const {
+  switch (field) {
+  case QueryField::Title:
+    return book.getTitleView().find(text) != std::string_view::npos;
+  case QueryField::Author:
+    return book.getAuthorView().find(text) != std::string_view::npos;
+  case QueryField::Category:
+    return op == QueryOp::Equal
+               ? book.getCategoryView() == text
+               : book.getCategoryView().find(text) != std::string_view::npos;
+  case QueryField::Year:
+    switch (op) {
+    case QueryOp::Less:
+      return book.getYear() < number;
+    case QueryOp::LessEqual:
+      return book.getYear() <= number;
+    case QueryOp::Greater:
+      return book.getYear() > number;
+    case QueryOp::GreaterEqual:
+      return book.getYear() >= number;
+    default:
+      return book.getYear() == number;
+    }
+  case QueryField::Available:
+    return book.isAvailable() == (number != 0);
+  }
+  return false;
+}
+
+// Quotes text for query syntax, doubling any quote inside.
+static std::string quoted(const std::string &text) {
+  std::string result = "\"";
+  for (char c : text) {
+    if (c == '"') {
+      result += '"';
+    }
+    result += c;
+  }
+  return result + '"';
+}
+
+// Returns the condition in query syntax.
+std::string QueryPredicate::toString() const {
+  std::string result = fieldNames[static_cast<size_t>(field)];
+  result += ' ';
+  result += opNames[static_cast<size_t>(op)];
+  result += ' ';
+  if (field == QueryField::Year) {
+    result += std::to_string(number);
+  } else if (field == QueryField::Available) {
+    result += number != 0 ? "true" : "false";
+  } else {
+    result += quoted(text);
+  }
+  return result;
+}
+
+// Returns true if book meets every predicate.
+bool BookQuery::matches(const Book &book) const {
+  for (const auto &predicate : predicates) {
+    if (!predicate.matches(book)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Narrows the predicates the attribute index can answer into filter.
+bool BookQuery::toFilter(BookFilter &filter) const {
+  for (const auto &predicate : predicates) {
+    if (predicate.field == QueryField::Category &&
+        predicate.op == QueryOp::Equal) {
+      if (filter.category && *filter.category != predicate.text) {
+        return false;
+      }
+      filter.category = predicate.text;
+    } else if (predicate.field == QueryField::Available) {
+      bool available = predicate.number != 0;
+      if (filter.available && *filter.available != available) {
+        return false;
+      }
+      filter.available = available;
+    } else if (predicate.field == QueryField::Year) {
+      int from = INT_MIN;
+      int to = INT_MAX;
+      switch (predicate.op) {
+      case QueryOp::Less:
+        if (predicate.number == INT_MIN) {
+          return false;
+        }
+        to = predicate.number - 1;
+        break;
+      case QueryOp::LessEqual:
+        to = predicate.number;
+        break;
+      case QueryOp::Greater:
+        if (predicate.number == INT_MAX) {
+          return false;
+        }
+        from = predicate.number + 1;
+        break;
+      case QueryOp::GreaterEqual:
+        from = predicate.number;
+        break;
+      default:
+        from = to = predicate.number;
+        break;
+      }
+      if (from != INT_MIN) {
+        filter.yearFrom = std::max(filter.yearFrom.value_or(INT_MIN), from);
+      }
+      if (to != INT_MAX) {
+        filter.yearTo = std::min(filter.yearTo.value_or(INT_MAX), to);
+      }
+    }
+  }
+  return !filter.yearFrom || !filter.yearTo ||
+         *filter.yearFrom <= *filter.yearTo;
+}
+
+// Returns the query in query syntax.
+std::string BookQuery::toString() const {
+  std::string result;
+  for (const auto &predicate : predicates) {
+    if (!result.empty()) {
+      result += " and ";
+    }
+    result += predicate.toString();
+  }
+  if (limit != SIZE_MAX) {
+    result += result.empty() ? "limit " : " limit ";
+    result += std::to_string(limit);
+  }
+  return result;
+}
+
+// A word, operator or quoted value of a query.
+struct QueryToken {
+  std::string text;
+  bool quoted = false;
+  bool op = false;
+};
+
+// Returns true for the characters operators are made of.
+static bool isOpChar(char c) {
+  return c == '~' || c == '=' || c == '<' || c == '>';
+}
+
+// Splits a query into words, operators and quoted values.
+static bool tokenizeQuery(std::string_view text,
+                          std::vector<QueryToken> &tokens,
+                          std::string &error) {
+  size_t pos = 0;
+  while (pos < text.size()) {
+    char c = text[pos];
+    if (std::isspace(static_cast<unsigned char>(c))) {
+      ++pos;
+      continue;
+    }
+    QueryToken token;
+    if (c == '"') {
+      token.quoted = true;
+      ++pos;
+      while (true) {
+        if (pos >= text.size()) {
+          error = "unterminated quote";
+          return false;
+        }
+        if (text[pos] == '"') {
+          if (pos + 1 < text.size() && text[pos + 1] == '"') {
+            token.text += '"';
+            pos += 2;
+            continue;
+          }
+          ++pos;
+          break;
+        }
+        token.text += text[pos++];
+      }
+    } else if (isOpChar(c)) {
+      token.op = true;
+      token.text += c;
+      ++pos;
+      if ((c == '<' || c == '>') && pos < text.size() && text[pos] == '=') {
+        token.text += '=';
+        ++pos;
+      }
+    } else {
+      while (pos < text.size() &&
+             !std::isspace(static_cast<unsigned char>(text[pos])) &&
+             text[pos] != '"' && !isOpChar(text[pos])) {
+        token.text += text[pos++];
+      }
+    }
+    tokens.push_back(std::move(token));
+  }
+  return true;
+}
+
+// Returns true if token is the unquoted keyword, in any case.
+static bool isKeyword(const QueryToken &token, std::string_view keyword) {
+  if (token.quoted || token.op || token.text.size() != keyword.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < keyword.size(); ++i) {
+    if (std::tolower(static_cast<unsigned char>(token.text[i])) != keyword[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Parses a whole token as a number.
+template <typename T>
+static bool parseWhole(const std::string &text, T &value) {
+  const char *end = text.data() + text.size();
+  auto result = std::from_chars(text.data(), end, value);
+  return result.ec == std::errc() && result.ptr == end && !text.empty();
+}
+
+// Parses one <field> <op> <value> predicate.
+static bool parsePredicate(const QueryToken &fieldToken,
+                           const QueryToken &opToken,
+                           const QueryToken &valueToken,
+                           QueryPredicate &predicate, std::string &error) {
+  size_t field = 0;
+  while (field < 5 && !isKeyword(fieldToken, fieldNames[field])) {
+    ++field;
+  }
+  if (field == 5) {
+    error = "unknown field " + fieldToken.text;
+    return false;
+  }
+  size_t op = 0;
+  while (op < 6 && !(opToken.op && opToken.text == opNames[op])) {
+    ++op;
+  }
+  if (op == 6) {
+    error = "expected an operator after " + fieldToken.text;
+    return false;
+  }
+  if (valueToken.op) {
+    error = "expected a value after " + fieldToken.text + " " + opToken.text;
+    return false;
+  }
+  predicate.field = static_cast<QueryField>(field);
+  predicate.op = static_cast<QueryOp>(op);
+
+  switch (predicate.field) {
+  case QueryField::Title:
+  case QueryField::Author:
+  case QueryField::Category:
+    if (predicate.op != QueryOp::Contains &&
+        !(predicate.field == QueryField::Category &&
+          predicate.op == QueryOp::Equal)) {
+      error = std::string(fieldNames[field]) + " does not support " +
+              opToken.text;
+      return false;
+    }
+    predicate.text = valueToken.text;
+    break;
+  case QueryField::Year:
+    if (predicate.op == QueryOp::Contains ||
+        !parseWhole(valueToken.text, predicate.number)) {
+      error = "year needs a number and one of = < <= > >=";
+      return false;
+    }
+    break;
+  case QueryField::Available:
+    if (predicate.op != QueryOp::Equal) {
+      error = "available only supports =";
+      return false;
+    }
+    if (isKeyword(valueToken, "true") || isKeyword(valueToken, "yes") ||
+        valueToken.text == "1") {
+      predicate.number = 1;
+    } else if (isKeyword(valueToken, "false") ||
+               isKeyword(valueToken, "no") || valueToken.text == "0") {
+      predicate.number = 0;
+    } else {
+      error = "available needs true or false";
+      return false;
+    }
+    break;
+  }
+  return true;
+}
+
+// Parses a query: predicates joined by "and", then an optional limit.
+bool parseBookQuery(std::string_view text, BookQuery &query,
+                    std::string &error) {
+  query = BookQuery();
+  std::vector<QueryToken> tokens;
+  if (!tokenizeQuery(text, tokens, error)) {
+    return false;
+  }
+  size_t i = 0;
+  while (i < tokens.size()) {
+    if (isKeyword(tokens[i], "limit")) {
+      if (i + 2 != tokens.size() ||
+          !parseWhole(tokens[i + 1].text, query.limit)) {
+        error = "limit must end the query and take a number";
+        return false;
+      }
+      break;
+    }
+    if (!query.predicates.empty()) {
+      if (!isKeyword(tokens[i], "and")) {
+        error = "expected and before " + tokens[i].text;
+        return false;
+      }
+      ++i;
+    }
+    if (i + 3 > tokens.size()) {
+      error = "incomplete predicate at the end of the query";
+      return false;
+    }
+    QueryPredicate predicate;
+    if (!parsePredicate(tokens[i], tokens[i + 1], tokens[i + 2], predicate,
+                        error)) {
+      return false;
+    }
+    query.predicates.push_back(std::move(predicate));
+    i += 3;
+  }
+  return true;
+}
+
+// Describes where candidates come from.
+static std::string accessName(const QueryPlan &plan,
+                              const BookQuery &query) {
+  switch (plan.access) {
+  case QueryAccess::Empty:
+    return "nothing";
+  case QueryAccess::Scan:
+    return "a scan of all books";
+  case QueryAccess::AttributeIndex:
+    return "the category, year and availability indexes";
+  default:
+    return "the " + std::string(plan.indexes[plan.driver]) + " of " +
+           query.predicates[plan.driver].toString();
+  }
+}
+
+// Describes the plan, one line per step.
+std::string QueryPlan::explain(const BookQuery &query) const {
+  std::ostringstream out;
+  out << std::fixed << std::setprecision(1);
+  out << "query: "
+      << (query.predicates.empty() && query.limit == SIZE_MAX
+              ? "(all books)"
+              : query.toString())
+      << "\n";
+  out << "books: " << books << "\n";
+  for (size_t i = 0; i < query.predicates.size(); ++i) {
+    out << "  " << query.predicates[i].toString() << ": ";
+    if (indexes[i].empty()) {
+      out << "no index, checked per book\n";
+      continue;
+    }
+    out << indexes[i] << ", ~" << estimates[i] << " books ("
+        << (books == 0 ? 0.0 : 100.0 * estimates[i] / books) << "%)\n";
+  }
+  out << "plan: read candidates from " << accessName(*this, query);
+  if (access != QueryAccess::Empty) {
+    out << " (~" << estimatedCandidates << ")";
+    if (!query.predicates.empty()) {
+      out << ", check every predicate on each";
+    }
+    if (query.limit != SIZE_MAX) {
+      out << ", stop after " << query.limit << " results";
+    }
+  }
+  out << "\n";
+  return out.str();
+}
@@ -0,0 +1,358 @@
+#include "CommandProcessor.hpp"
+#include "CsvLoader.hpp"
+#include <charconv>
+#include <chrono>
+#include <vector>
+
+// Responses are collected and written out in blocks of about this size.
+static const size_t outputBlockBytes = 1 << 16;
+
+// Parses a whole field as an integer.
+static bool parseNumber(std::string_view field, int &value) {
+  const char *end = field.data() + field.size();
+  auto result = std::from_chars(field.data(), end, value);
+  return result.ec == std::errc() && result.ptr == end && !field.empty();
+}
+
+// Appends the response to a change: ok, or why it was not made.
+static void appendChange(bool changed, const LibrarySystem &library,
+                         std::string &out) {
+  if (changed) {
+    out += "ok";
+  } else if (library.hasJournalFailed()) {
+    out += "error\tjournal commit failed";
+  } else {
+    out += "fail";
+  }
+}
+
+// Appends "ok<TAB><n><TAB><id;id;...>" for a query result.
+static void appendBookList(const std::vector<std::shared_ptr<Book>> &books,
+                           std::string &out) {
+  out += "ok\t";
+  out += std::to_string(books.size());
+  out += '\t';
+  for (size_t i = 0; i < books.size(); ++i) {
+    out += books[i]->getIdView();
+    if (i < books.size() - 1) {
+      out += ';';
+    }
+  }
+}
+
+// Parses the four filter fields of find and count, where "*" leaves a
+// condition unset.
+static bool parseBookFilter(const std::vector<std::string> &fields,
+                            BookFilter &filter) {
+  if (fields[1] != "*") {
+    filter.category = fields[1];
+  }
+  int year;
+  if (fields[2] != "*") {
+    if (!parseNumber(fields[2], year)) {
+      return false;
+    }
+    filter.yearFrom = year;
+  }
+  if (fields[3] != "*") {
+    if (!parseNumber(fields[3], year)) {
+      return false;
+    }
+    filter.yearTo = year;
+  }
+  if (fields[4] == "available" || fields[4] == "borrowed") {
+    filter.available = fields[4] == "available";
+  } else if (fields[4] != "*") {
+    return false;
+  }
+  return true;
+}
+
+// Appends "<value>=<books>/<available>" for one facet.
+static void appendFacet(const std::string &value, size_t books,
+                        size_t available, std::string &out) {
+  if (out.back() != '\t') {
+    out += ';';
+  }
+  out += value;
+  out += '=';
+  out += std::to_string(books);
+  out += '/';
+  out += std::to_string(available);
+}
+
+CommandProcessor::CommandProcessor(LibrarySystem &library)
+    : library(library) {}
+
+// Executes one command and appends its response line to out.
+bool CommandProcessor::execute(std::string_view line, std::string &out) {
+  std::vector<std::string> fields;
+  FieldTokenizer tokenizer(line);
+  std::string_view field;
+  while (tokenizer.next(',', field)) {
+    fields.emplace_back(field);
+  }
+  if (fields.empty()) {
+    out += "error\tempty command";
+    return false;
+  }
+
+  const std::string &command = fields[0];
+  auto expect = [&fields, &out](size_t count) {
+    if (fields.size() != count) {
+      out += "error\texpected " + std::to_string(count - 1) + " arguments";
+      return false;
+    }
+    return true;
+  };
+
+  if (command == "borrow") {
+    if (expect(3)) {
+      bool changed = library.borrowBook(fields[1], fields[2]);
+      appendChange(changed, library, out);
+      return changed;
+    }
+  } else if (command == "return") {
+    if (expect(3)) {
+      bool changed = library.returnBook(fields[1], fields[2]);
+      appendChange(changed, library, out);
+      return changed;
+    }
+  } else if (command == "add-book") {
+    int year;
+    if (expect(7)) {
+      if (!parseNumber(fields[5], year) ||
+          (fields[6] != "0" && fields[6] != "1")) {
+        out += "error\tinvalid year or availability";
+        return false;
+      }
+      bool added = library.addItem(library.createBook(
+          fields[1], fields[2], fields[3], fields[4], year, fields[6] == "1"));
+      appendChange(added, library, out);
+      return added;
+    }
+  } else if (command == "add-user") {
+    if (expect(5)) {
+      bool added = library.addItem(
+          library.createUser(fields[1], fields[2], fields[3], fields[4]));
+      appendChange(added, library, out);
+      return added;
+    }
+  } else if (command == "search" || command == "search-normalized") {
+    if (expect(3)) {
+      if (fields[1] != "title" && fields[1] != "author" &&
+          fields[1] != "category") {
+        out += "error\tunknown search type";
+        return false;
+      }
+      SearchMode mode = command == "search" ? SearchMode::Exact
+                                            : SearchMode::Normalized;
+      appendBookList(library.searchBooks(fields[2], fields[1], mode), out);
+    }
+  } else if (command == "fuzzy") {
+    int k;
+    if (expect(4)) {
+      if (fields[1] != "title" && fields[1] != "author") {
+        out += "error\tunknown fuzzy search type";
+        return false;
+      }
+      if (!parseNumber(fields[2], k) || k < 0) {
+        out += "error\tinvalid result count";
+        return false;
+      }
+      std::vector<std::shared_ptr<Book>> results;
+      for (auto &match : library.fuzzySearchBooks(fields[3], fields[1], k)) {
+        results.push_back(std::move(match.book));
+      }
+      appendBookList(results, out);
+    }
+  } else if (command == "complete") {
+    int k;
+    if (expect(4)) {
+      if (fields[1] != "title" && fields[1] != "author") {
+        out += "error\tunknown completion type";
+        return false;
+      }
+      if (!parseNumber(fields[2], k) || k < 0) {
+        out += "error\tinvalid result count";
+        return false;
+      }
+      auto completions = library.completeBooks(fields[3], fields[1], k);
+      out += "ok\t";
+      out += std::to_string(completions.size());
+      out += '\t';
+      for (size_t i = 0; i < completions.size(); ++i) {
+        out += completions[i].text;
+        out += '=';
+        out += std::to_string(completions[i].popularity);
+        if (i < completions.size() - 1) {
+          out += ';';
+        }
+      }
+    }
+  } else if (command == "find" || command == "count") {
+    BookFilter filter;
+    if (expect(5)) {
+      if (!parseBookFilter(fields, filter)) {
+        out += "error\tinvalid year or availability";
+        return false;
+      }
+      if (command == "find") {
+        appendBookList(library.findBooks(filter), out);
+      } else {
+        out += "ok\t" + std::to_string(library.countBooks(filter));
+      }
+    }
+  } else if (command == "query" || command == "explain") {
+    // The query is the rest of the line, commas and all.
+    BookQuery query;
+    std::string error;
+    size_t start = line.find(',');
+    std::string_view text =
+        start == std::string_view::npos ? "" : line.substr(start + 1);
+    if (!parseBookQuery(text, query, error)) {
+      out += "error\t" + error;
+      return false;
+    }
+    if (command == "query") {
+      std::vector<std::shared_ptr<Book>> results;
+      BookCursor cursor = library.queryBooks(query);
+      while (auto book = cursor.next()) {
+        results.push_back(std::move(book));
+      }
+      appendBookList(results, out);
+    } else {
+      // One line per step of the plan, joined with " | ".
+      std::string plan = library.explainQuery(query);
+      plan.pop_back();
+      for (size_t pos; (pos = plan.find('\n')) != std::string::npos;) {
+        plan.replace(pos, 1, " | ");
+      }
+      out += "ok\t" + plan;
+    }
+  } else if (command == "facets") {
+    if (expect(2)) {
+      if (fields[1] == "category") {
+        out += "ok\t";
+        for (const auto &count : library.getCategoryCounts()) {
+          appendFacet(count.category, count.books, count.available, out);
+        }
+      } else if (fields[1] == "decade") {
+        out += "ok\t";
+        for (const auto &count : library.getDecadeCounts()) {
+          appendFacet(std::to_string(count.decade), count.books,
+                      count.available, out);
+        }
+      } else {
+        out += "error\tunknown facet";
+      }
+    }
+  } else if (command == "most-borrowed" || command == "overdue" ||
+             command == "due") {
+    int number;
+    if (expect(2)) {
+      if (!parseNumber(fields[1], number)) {
+        out += "error\tinvalid number";
+        return false;
+      }
+      if (command == "most-borrowed") {
+        appendBookList(library.getMostBorrowedBooks(number), out);
+      } else if (command == "overdue") {
+        appendBookList(library.getOverdueBooks(number), out);
+      } else {
+        appendBookList(library.getBooksDueWithin(number), out);
+      }
+    }
+  } else if (command == "import-books" || command == "import-users") {
+    if (expect(3)) {
+      if (fields[2] != "reject" && fields[2] != "upsert") {
+        out += "error\tunknown duplicate policy";
+        return false;
+      }
+      ImportResult result = library.importItemsFromFile(
+          fields[1], command == "import-users",
+          fields[2] == "upsert" ? DuplicatePolicy::Upsert
+                                : DuplicatePolicy::Reject);
+      if (!result.committed) {
+        out += "error\tjournal commit failed";
+        return false;
+      }
+      out += "ok\tadded=" + std::to_string(result.added) +
+             ";updated=" + std::to_string(result.updated) +
+             ";duplicates=" + std::to_string(result.duplicates) +
+             ";invalid=" + std::to_string(result.invalid);
+      return result.added + result.updated > 0;
+    }
+  } else if (command == "stats") {
+    if (expect(1)) {
+      out += "ok\t";
+      library.getMetrics().appendCompact(out);
+    }
+  } else {
+    out += "error\tunknown command " + command;
+  }
+  return false;
+}
+
+// Executes every command read from in. Journal records are held in one
+// pending batch and committed with a single write and fsync just before the
+// block of results reporting them is written out. A failed commit stops the
+// run, and the block's results are replaced by an error line.
+BatchResult CommandProcessor::runBatch(std::istream &in, std::ostream &out) {
+  auto previous = library.getDurability();
+  DurabilityOptions batched;
+  batched.mode = DurabilityMode::GroupCommit;
+  batched.commitInterval = std::chrono::hours(24);
+  batched.commitBatchSize = SIZE_MAX;
+  library.setDurability(batched);
+
+  BatchResult result;
+  size_t lineNo = 0;
+  size_t blockStart = 0; // Line number of the first result in buffer.
+  bool changed = false;  // Whether buffer reports an uncommitted change.
+  std::string line;
+  std::string buffer;
+  buffer.reserve(outputBlockBytes * 2);
+
+  // Commits the block's changes, then writes it out.
+  auto writeBlock = [&] {
+    if (changed && !library.syncJournal()) {
+      result.committed = false;
+      buffer = std::to_string(blockStart) + "\terror\tjournal commit failed\n";
+    }
+    out.write(buffer.data(), buffer.size());
+    buffer.clear();
+    changed = false;
+    return result.committed;
+  };
+
+  while (std::getline(in, line)) {
+    ++lineNo;
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+
+    if (buffer.empty()) {
+      blockStart = lineNo;
+    }
+    buffer += std::to_string(lineNo);
+    buffer += '\t';
+    changed |= execute(line, buffer);
+    buffer += '\n';
+    ++result.executed;
+
+    if (buffer.size() >= outputBlockBytes && !writeBlock()) {
+      break;
+    }
+  }
+  if (result.committed) {
+    writeBlock();
+  }
+  out.flush();
+
+  library.setDurability(previous);
+  return result;
+}
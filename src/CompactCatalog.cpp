@@ -0,0 +1,153 @@
+#include "CompactCatalog.hpp"
+
+// Returns the number of value, adding it if it is new.
+uint32_t CompactCatalog::StringTable::intern(std::string_view value) {
+  std::string key(value);
+  auto it = numbers.find(key);
+  if (it != numbers.end()) {
+    return it->second;
+  }
+  auto number = static_cast<uint32_t>(values.size());
+  values.push_back(key);
+  numbers.emplace(std::move(key), number);
+  return number;
+}
+
+// Counts the strings twice, once in values and once as map keys, plus a
+// node and bucket per map entry.
+size_t CompactCatalog::StringTable::memoryUsage() const {
+  size_t bytes = values.capacity() * sizeof(std::string) +
+                 numbers.bucket_count() * sizeof(void *) +
+                 numbers.size() * (sizeof(std::string) + 2 * sizeof(void *));
+  const size_t inlineCapacity = std::string().capacity();
+  for (const auto &value : values) {
+    if (value.capacity() > inlineCapacity) {
+      bytes += 2 * (value.capacity() + 1); // Beyond the small buffer.
+    }
+  }
+  return bytes;
+}
+
+// Copies every book, in order.
+CompactCatalog
+CompactCatalog::fromBooks(const std::vector<std::shared_ptr<Book>> &books) {
+  size_t textBytes = 0;
+  for (const auto &book : books) {
+    textBytes += book->getIdView().size() + book->getTitleView().size();
+  }
+  CompactCatalog catalog;
+  catalog.reserve(books.size(), textBytes);
+  for (const auto &book : books) {
+    catalog.add(book->getIdView(), book->getTitleView(),
+                book->getAuthorView(), book->getCategoryView(),
+                book->getYear(), book->isAvailable(), book->getBorrowCount());
+  }
+  return catalog;
+}
+
+// Reserves room for books books with textBytes bytes of IDs and titles.
+void CompactCatalog::reserve(size_t books, size_t textBytes) {
+  text.reserve(textBytes);
+  offsets.reserve(2 * books + 1);
+  authorOf.reserve(books);
+  categoryOf.reserve(books);
+  years.reserve(books);
+  availability.reserve(books);
+  borrowCounts.reserve(books);
+}
+
+// Appends one book.
+void CompactCatalog::add(std::string_view id, std::string_view title,
+                         std::string_view author, std::string_view category,
+                         int year, bool available, int borrowCount) {
+  text += id;
+  offsets.push_back(static_cast<uint32_t>(text.size()));
+  text += title;
+  offsets.push_back(static_cast<uint32_t>(text.size()));
+  authorOf.push_back(authors.intern(author));
+  categoryOf.push_back(categories.intern(category));
+  years.push_back(year);
+  availability.push_back(available ? 1 : 0);
+  borrowCounts.push_back(borrowCount);
+}
+
+size_t CompactCatalog::size() const { return years.size(); }
+
+std::string_view CompactCatalog::id(size_t book) const {
+  return std::string_view(text).substr(
+      offsets[2 * book], offsets[2 * book + 1] - offsets[2 * book]);
+}
+
+std::string_view CompactCatalog::title(size_t book) const {
+  return std::string_view(text).substr(
+      offsets[2 * book + 1], offsets[2 * book + 2] - offsets[2 * book + 1]);
+}
+
+std::string_view CompactCatalog::author(size_t book) const {
+  return authors.values[authorOf[book]];
+}
+
+std::string_view CompactCatalog::category(size_t book) const {
+  return categories.values[categoryOf[book]];
+}
+
+int CompactCatalog::year(size_t book) const { return years[book]; }
+
+bool CompactCatalog::isAvailable(size_t book) const {
+  return availability[book] != 0;
+}
+
+int CompactCatalog::borrowCount(size_t book) const {
+  return borrowCounts[book];
+}
+
+size_t CompactCatalog::authorCount() const { return authors.values.size(); }
+
+size_t CompactCatalog::categoryCount() const {
+  return categories.values.size();
+}
+
+// Titles are scanned in place in the text buffer. Authors and categories
+// are matched once per distinct name; the books are then found by scanning
+// the dense column of name numbers.
+void CompactCatalog::search(std::string_view query, Field field,
+                            std::vector<uint32_t> &out) const {
+  if (field == Field::Title) {
+    for (size_t book = 0; book < size(); ++book) {
+      if (title(book).find(query) != std::string_view::npos) {
+        out.push_back(static_cast<uint32_t>(book));
+      }
+    }
+    return;
+  }
+
+  const StringTable &table = field == Field::Author ? authors : categories;
+  const std::vector<uint32_t> &column =
+      field == Field::Author ? authorOf : categoryOf;
+  std::vector<uint8_t> matches(table.values.size());
+  bool any = false;
+  for (size_t number = 0; number < table.values.size(); ++number) {
+    if (table.values[number].find(query) != std::string::npos) {
+      matches[number] = 1;
+      any = true;
+    }
+  }
+  if (!any) {
+    return;
+  }
+  for (size_t book = 0; book < column.size(); ++book) {
+    if (matches[column[book]]) {
+      out.push_back(static_cast<uint32_t>(book));
+    }
+  }
+}
+
+// Returns the bytes held by all columns and string tables.
+size_t CompactCatalog::memoryUsage() const {
+  return text.capacity() + offsets.capacity() * sizeof(uint32_t) +
+         authorOf.capacity() * sizeof(uint32_t) +
+         categoryOf.capacity() * sizeof(uint32_t) +
+         years.capacity() * sizeof(int32_t) + availability.capacity() +
+         borrowCounts.capacity() * sizeof(int32_t) + authors.memoryUsage() +
+         categories.memoryUsage();
+}
@@ -0,0 +1,407 @@
+#include "CompletionIndex.hpp"
+#include <algorithm>
+#include <iterator>
+
+// Pending entries a search scans in place; beyond this it merges them.
+static const size_t pendingLimit = 1024;
+
+// Returns true for the bytes words are made of: ASCII letters and digits,
+// and every byte of a multi-byte UTF-8 character.
+static bool isWordByte(char c) {
+  auto byte = static_cast<unsigned char>(c);
+  return (byte >= '0' && byte <= '9') || (byte >= 'a' && byte <= 'z') ||
+         (byte >= 'A' && byte <= 'Z') || byte >= 0x80;
+}
+
+// Stores in out the offsets at which words of key start.
+static void wordStarts(std::string_view key, std::vector<uint32_t> &out) {
+  out.clear();
+  for (size_t i = 0; i < key.size(); ++i) {
+    if (isWordByte(key[i]) && (i == 0 || !isWordByte(key[i - 1]))) {
+      out.push_back(static_cast<uint32_t>(i));
+    }
+  }
+}
+
+// Packs the first eight bytes of text big-endian, padding with zeros, so
+// that comparing heads orders texts by their first eight bytes.
+static uint64_t headOf(std::string_view text) {
+  uint64_t head = 0;
+  for (size_t i = 0; i < 8; ++i) {
+    head <<= 8;
+    if (i < text.size()) {
+      head |= static_cast<unsigned char>(text[i]);
+    }
+  }
+  return head;
+}
+
+// Returns true if text starts with prefix.
+static bool startsWith(std::string_view text, std::string_view prefix) {
+  return text.substr(0, prefix.size()) == prefix;
+}
+
+// Returns the key of entry, from its word on.
+std::string_view CompletionIndex::keyOf(const Entry &entry) const {
+  return std::string_view(completions[entry.id].key).substr(entry.offset);
+}
+
+// Compares heads first and whole keys only when they are equal.
+bool CompletionIndex::entryBefore(const Entry &a, const Entry &b) const {
+  if (a.head != b.head) {
+    return a.head < b.head;
+  }
+  int order = keyOf(a).compare(keyOf(b));
+  if (order != 0) {
+    return order < 0;
+  }
+  return a.id != b.id ? a.id < b.id : a.offset < b.offset;
+}
+
+// Sorts by eight bytes of key at a time, held in an integer, and the
+// length so far, and only reads further into the keys of the runs that
+// tie. Comparing whole keys instead costs a cache miss per comparison.
+void CompletionIndex::sortEntries(Entry *first, Entry *last,
+                                  size_t depth) const {
+  if (depth > 0 && last - first <= 16) {
+    // Few enough that comparing whole keys is cheaper than another pass.
+    std::sort(first, last, [this](const Entry &a, const Entry &b) {
+      return entryBefore(a, b);
+    });
+    return;
+  }
+  struct Keyed {
+    uint64_t head;
+    size_t length; // Of the key, capped one past the bytes in head.
+    Entry entry;
+  };
+  std::vector<Keyed> keyed;
+  keyed.reserve(last - first);
+  for (Entry *entry = first; entry != last; ++entry) {
+    std::string_view key = keyOf(*entry);
+    uint64_t head = entry->head;
+    if (depth > 0) {
+      head = headOf(key.substr(std::min(depth, key.size())));
+    }
+    keyed.push_back({head, std::min(key.size(), depth + 9), *entry});
+  }
+  std::sort(keyed.begin(), keyed.end(), [](const Keyed &a, const Keyed &b) {
+    if (a.head != b.head) {
+      return a.head < b.head;
+    }
+    if (a.length != b.length) {
+      return a.length < b.length;
+    }
+    return a.entry.id != b.entry.id ? a.entry.id < b.entry.id
+                                    : a.entry.offset < b.entry.offset;
+  });
+  for (size_t i = 0; i < keyed.size(); ++i) {
+    first[i] = keyed[i].entry;
+  }
+  size_t run = 0;
+  for (size_t i = 1; i <= keyed.size(); ++i) {
+    if (i < keyed.size() && keyed[i].head == keyed[run].head &&
+        keyed[i].length == keyed[run].length) {
+      continue;
+    }
+    // Keys longer than the bytes compared so far may still differ.
+    if (i - run > 1 && keyed[run].length > depth + 8) {
+      sortEntries(first + run, first + i, depth + 8);
+    }
+    run = i;
+  }
+}
+
+// Ranks whole-key matches first, then popularity, then text.
+bool CompletionIndex::rankBefore(uint32_t a, uint32_t b,
+                                 std::string_view prefix) const {
+  const Completion &first = completions[a];
+  const Completion &second = completions[b];
+  bool firstWhole = startsWith(first.key, prefix);
+  bool secondWhole = startsWith(second.key, prefix);
+  if (firstWhole != secondWhole) {
+    return firstWhole;
+  }
+  if (first.popularity != second.popularity) {
+    return first.popularity > second.popularity;
+  }
+  return first.text < second.text;
+}
+
+// Scans the children, of which most nodes have one or two.
+uint32_t CompletionIndex::childOf(uint32_t node, char byte) const {
+  for (const auto &[next, child] : caches[node].children) {
+    if (next == byte) {
+      return child;
+    }
+  }
+  return 0;
+}
+
+// Walks down the trie from each word start, stopping at the first byte
+// without a child.
+template <typename Visit>
+void CompletionIndex::forEachCache(uint32_t id, Visit visit) {
+  if (caches.empty()) {
+    return;
+  }
+  std::string_view key = completions[id].key;
+  for (size_t start = 0; start < key.size(); ++start) {
+    if (!isWordByte(key[start]) || (start > 0 && isWordByte(key[start - 1]))) {
+      continue;
+    }
+    uint32_t node = 0;
+    for (size_t pos = start; pos < key.size(); ++pos) {
+      node = childOf(node, key[pos]);
+      if (node == 0) {
+        break;
+      }
+      if (caches[node].listed) {
+        visit(key.substr(start, pos + 1 - start), caches[node]);
+      }
+    }
+  }
+}
+
+// Adds the trie nodes of the prefix that are missing and lists it.
+void CompletionIndex::cache(std::string_view prefix,
+                            const std::vector<uint32_t> &ranked) {
+  if (caches.empty()) {
+    caches.emplace_back();
+  }
+  uint32_t node = 0;
+  for (char byte : prefix) {
+    uint32_t child = childOf(node, byte);
+    if (child == 0) {
+      child = static_cast<uint32_t>(caches.size());
+      caches[node].children.emplace_back(byte, child);
+      caches.emplace_back();
+    }
+    node = child;
+  }
+  Cache &entry = caches[node];
+  entry.ids.assign(ranked.begin(),
+                   ranked.begin() +
+                       std::min(size_t(cachedCount), ranked.size()));
+  entry.listed = true;
+  entry.stale = false;
+}
+
+// A completion that only gained can only move up, so each list needs at
+// most one removal and one insertion. Most candidates lose to the last
+// entry of a full list and cost one comparison. Visiting a list twice
+// leaves it as the first visit did.
+void CompletionIndex::promote(uint32_t id) {
+  forEachCache(id, [&](std::string_view prefix, Cache &cache) {
+    if (cache.stale) {
+      return;
+    }
+    auto &list = cache.ids;
+    auto it = std::find(list.begin(), list.end(), id);
+    if (it != list.end()) {
+      list.erase(it);
+    } else if (list.size() == cachedCount &&
+               !rankBefore(id, list.back(), prefix)) {
+      return;
+    }
+    auto at = std::find_if(list.begin(), list.end(), [&](uint32_t other) {
+      return rankBefore(id, other, prefix);
+    });
+    list.insert(at, id);
+    if (list.size() > cachedCount) {
+      list.pop_back();
+    }
+  });
+}
+
+// A completion that lost may have to make way for one the list no longer
+// holds, which only the entries can tell.
+void CompletionIndex::demote(uint32_t id) {
+  forEachCache(id, [](std::string_view, Cache &cache) { cache.stale = true; });
+}
+
+// Returns the ID of the completion for text, creating it and its entries
+// if it is new.
+uint32_t CompletionIndex::idOf(std::string_view text, std::string_view key) {
+  auto it = ids.find(text);
+  if (it != ids.end()) {
+    return it->second;
+  }
+  auto id = static_cast<uint32_t>(completions.size());
+  completions.push_back({std::string(text), std::string(key)});
+  ids.emplace(completions.back().text, id);
+  std::vector<uint32_t> starts;
+  wordStarts(key, starts);
+  for (uint32_t start : starts) {
+    pending.push_back({headOf(key.substr(start)), id, start});
+  }
+  return id;
+}
+
+// Sorts the pending entries and merges them into the sorted list.
+void CompletionIndex::mergePending() {
+  auto before = [this](const Entry &a, const Entry &b) {
+    return entryBefore(a, b);
+  };
+  sortEntries(pending.data(), pending.data() + pending.size(), 0);
+  std::vector<Entry> merged;
+  merged.reserve(sorted.size() + pending.size());
+  std::merge(sorted.begin(), sorted.end(), pending.begin(), pending.end(),
+             std::back_inserter(merged), before);
+  sorted.swap(merged);
+  pending.clear();
+  pending.shrink_to_fit();
+}
+
+// Walks the sorted range starting with prefix, and any pending entries.
+void CompletionIndex::candidates(std::string_view prefix,
+                                 std::vector<uint32_t> &out) {
+  out.clear();
+  if (pending.size() > pendingLimit) {
+    mergePending();
+  }
+  auto it = std::lower_bound(sorted.begin(), sorted.end(), prefix,
+                             [this](const Entry &entry, std::string_view p) {
+                               return keyOf(entry) < p;
+                             });
+  for (; it != sorted.end() && startsWith(keyOf(*it), prefix); ++it) {
+    out.push_back(it->id);
+  }
+  for (const auto &entry : pending) {
+    if (startsWith(keyOf(entry), prefix)) {
+      out.push_back(entry.id);
+    }
+  }
+  std::sort(out.begin(), out.end());
+  out.erase(std::unique(out.begin(), out.end()), out.end());
+  out.erase(std::remove_if(out.begin(), out.end(),
+                           [this](uint32_t id) {
+                             return completions[id].books == 0;
+                           }),
+            out.end());
+}
+
+// Indexes document doc under the completion for its text.
+void CompletionIndex::add(uint32_t doc, std::string_view text,
+                          std::string_view key, int borrowCount) {
+  uint32_t id = idOf(text, key);
+  if (doc >= completionOf.size()) {
+    completionOf.resize(doc + 1);
+  }
+  completionOf[doc] = id;
+  Completion &completion = completions[id];
+  bool listed = completion.books > 0;
+  ++completion.books;
+  completion.popularity += borrowCount;
+  // The book count does not rank, so a completion already listed only
+  // moves if its popularity grew.
+  if (!listed || borrowCount > 0) {
+    promote(id);
+  }
+}
+
+// Takes doc and its borrows out of its old completion and adds it to the
+// new one.
+void CompletionIndex::replace(uint32_t doc, std::string_view text,
+                              std::string_view key, int borrowCount) {
+  uint32_t oldId = completionOf[doc];
+  Completion &old = completions[oldId];
+  if (old.text == text) {
+    return;
+  }
+  --old.books;
+  old.popularity -= borrowCount;
+  if (old.books == 0 || borrowCount > 0) {
+    demote(oldId);
+  }
+  add(doc, text, key, borrowCount);
+}
+
+// Counts one more borrow of document doc.
+void CompletionIndex::borrowed(uint32_t doc) {
+  uint32_t id = completionOf[doc];
+  ++completions[id].popularity;
+  promote(id);
+}
+
+// Answers a cached prefix from its list, rebuilding it if stale. Others
+// rank their range, and cache it if it is large.
+bool CompletionIndex::complete(std::string_view prefix, size_t k,
+                               std::vector<Match> &out) {
+  out.clear();
+  while (!prefix.empty() && !isWordByte(prefix.front())) {
+    prefix.remove_prefix(1);
+  }
+  if (prefix.empty()) {
+    return false;
+  }
+  // Moves the best count of ids to the front, in order, and drops the rest.
+  auto keepBest = [&](std::vector<uint32_t> &ids, size_t count) {
+    count = std::min(count, ids.size());
+    std::partial_sort(ids.begin(), ids.begin() + count, ids.end(),
+                      [&](uint32_t a, uint32_t b) {
+                        return rankBefore(a, b, prefix);
+                      });
+    ids.resize(count);
+  };
+  Cache *cached = nullptr;
+  if (k <= cachedCount && !caches.empty()) {
+    uint32_t node = 0;
+    for (char byte : prefix) {
+      node = childOf(node, byte);
+      if (node == 0) {
+        break;
+      }
+    }
+    if (node != 0 && caches[node].listed) {
+      cached = &caches[node];
+    }
+  }
+  std::vector<uint32_t> ranked;
+  if (cached) {
+    if (cached->stale) {
+      candidates(prefix, cached->ids);
+      keepBest(cached->ids, cachedCount);
+      cached->stale = false;
+    }
+    ranked.assign(cached->ids.begin(),
+                  cached->ids.begin() + std::min(k, cached->ids.size()));
+  } else {
+    candidates(prefix, ranked);
+    bool large = k <= cachedCount && ranked.size() > cacheThreshold;
+    keepBest(ranked, large ? cachedCount : k);
+    if (large) {
+      cache(prefix, ranked);
+      ranked.resize(std::min(k, ranked.size()));
+    }
+  }
+  out.reserve(ranked.size());
+  for (uint32_t id : ranked) {
+    const Completion &completion = completions[id];
+    out.push_back({completion.text, completion.popularity, completion.books});
+  }
+  return true;
+}
+
+// Approximate heap memory used by the index, in bytes.
+size_t CompletionIndex::memoryUsage() const {
+  size_t bytes = completionOf.capacity() * sizeof(uint32_t) +
+                 (sorted.capacity() + pending.capacity()) * sizeof(Entry);
+  for (const auto &completion : completions) {
+    bytes += sizeof(Completion);
+    if (completion.text.capacity() > 15) {
+      bytes += completion.text.capacity();
+    }
+    if (completion.key.capacity() > 15) {
+      bytes += completion.key.capacity();
+    }
+  }
+  bytes += ids.size() * (sizeof(std::string_view) + sizeof(uint32_t) +
+                         2 * sizeof(void *));
+  bytes += caches.capacity() * sizeof(Cache);
+  for (const auto &cache : caches) {
+    bytes += cache.children.capacity() * sizeof(cache.children[0]) +
+             cache.ids.capacity() * sizeof(uint32_t);
+  }
+  return bytes;
+}
@@ -0,0 +1,184 @@
+#include "CsvLoader.hpp"
+#include <algorithm>
+#include <charconv>
+#include <thread>
+
+// Smallest chunk worth handing to its own thread.
+static const size_t minChunkBytes = 1 << 20;
+
+// Stores the next field in field and returns true, or returns false when
+// nothing is left.
+bool FieldTokenizer::next(char delimiter, std::string_view &field) {
+  if (pos >= text.size()) {
+    return false;
+  }
+  size_t end = text.find(delimiter, pos);
+  if (end == std::string_view::npos) {
+    end = text.size();
+  }
+  field = text.substr(pos, end - pos);
+  pos = end + 1;
+  return true;
+}
+
+// Calls fn for every line of chunk with its zero-based line number. A
+// trailing '\r' is dropped so CRLF files parse like LF files.
+template <typename Fn> static size_t forEachLine(std::string_view chunk, Fn fn) {
+  size_t lineNo = 0;
+  size_t pos = 0;
+  while (pos < chunk.size()) {
+    size_t end = chunk.find('\n', pos);
+    if (end == std::string_view::npos) {
+      end = chunk.size();
+    }
+    std::string_view line = chunk.substr(pos, end - pos);
+    if (!line.empty() && line.back() == '\r') {
+      line.remove_suffix(1);
+    }
+    fn(line, lineNo);
+    ++lineNo;
+    pos = end + 1;
+  }
+  return lineNo;
+}
+
+// Parses an integer field, allowing leading blanks like operator>> does.
+template <typename Int> static bool parseInt(std::string_view field, Int &value) {
+  while (!field.empty() && (field.front() == ' ' || field.front() == '\t')) {
+    field.remove_prefix(1);
+  }
+  if (!field.empty() && field.front() == '+') {
+    field.remove_prefix(1);
+  }
+  const char *end = field.data() + field.size();
+  auto result = std::from_chars(field.data(), end, value);
+  return result.ec == std::errc() && result.ptr == end && !field.empty();
+}
+
+// Splits data into at most chunkCount pieces, each ending on a newline.
+std::vector<std::string_view> CsvLoader::splitChunks(std::string_view data,
+                                                     size_t chunkCount) {
+  std::vector<std::string_view> chunks;
+  chunkCount = std::max<size_t>(chunkCount, 1);
+  size_t target = data.size() / chunkCount + 1;
+
+  size_t start = 0;
+  while (start < data.size()) {
+    size_t end = std::min(start + target, data.size());
+    if (end < data.size()) {
+      // Extend the chunk to the end of the line it stops in.
+      size_t newline = data.find('\n', end - 1);
+      end = newline == std::string_view::npos ? data.size() : newline + 1;
+    }
+    chunks.push_back(data.substr(start, end - start));
+    start = end;
+  }
+  return chunks;
+}
+
+// Picks a chunk count for a file of the given size.
+size_t CsvLoader::chunkCountFor(size_t bytes) {
+  size_t threads = std::max(1u, std::thread::hardware_concurrency());
+  return std::max<size_t>(1, std::min(threads, bytes / minChunkBytes));
+}
+
+// Parses one chunk of books.txt.
+CsvLoader::BookChunk
+CsvLoader::parseBooks(std::string_view chunk,
+                      std::pmr::memory_resource *resource) {
+  BookChunk result;
+  result.lineCount =
+      forEachLine(chunk, [&result, resource](std::string_view line,
+                                             size_t lineNo) {
+        if (line.empty()) {
+          return;
+        }
+
+        FieldTokenizer fields(line);
+        std::string_view id, title, author, category, year, available, count;
+        fields.next(',', id);
+        fields.next(',', title);
+        fields.next(',', author);
+        fields.next(',', category);
+        bool hasYear = fields.next(',', year);
+        bool hasAvailable = fields.next(',', available);
+        bool hasCount = fields.next(',', count); // Absent in older files.
+
+        int yearValue = 0;
+        int availableValue = 0;
+        int countValue = 0;
+        if (!hasYear || !parseInt(year, yearValue)) {
+          result.errors.push_back({lineNo, "invalid or missing year"});
+          return;
+        }
+        if (!hasAvailable || !parseInt(available, availableValue) ||
+            (availableValue != 0 && availableValue != 1)) {
+          result.errors.push_back({lineNo, "invalid or missing availability"});
+          return;
+        }
+        if (hasCount && (!parseInt(count, countValue) || countValue < 0)) {
+          result.errors.push_back({lineNo, "invalid borrow count"});
+          return;
+        }
+
+        auto book = makeShared<Book>(resource, id, title, author, category,
+                                     yearValue, availableValue == 1);
+        book->setBorrowCount(countValue);
+        result.books.push_back(book);
+      });
+  return result;
+}
+
+// Parses one chunk of users.txt.
+CsvLoader::UserChunk
+CsvLoader::parseUsers(std::string_view chunk,
+                      std::pmr::memory_resource *resource) {
+  UserChunk result;
+  result.lineCount =
+      forEachLine(chunk, [&result, resource](std::string_view line,
+                                             size_t lineNo) {
+        if (line.empty()) {
+          return;
+        }
+
+        FieldTokenizer fields(line);
+        std::string_view id, name, email, phone, borrowed;
+        fields.next(',', id);
+        fields.next(',', name);
+        fields.next(',', email);
+        fields.next(',', phone);
+        if (id.empty()) {
+          result.errors.push_back({lineNo, "missing user ID"});
+          return;
+        }
+
+        size_t loanCount = 0;
+        if (fields.next(',', borrowed)) {
+          FieldTokenizer loans(borrowed);
+          std::string_view entry;
+          while (loans.next(';', entry)) {
+            Loan loan{entry, false, {}};
+            size_t at = entry.find('@');
+            if (at != std::string_view::npos) {
+              long long seconds = 0;
+              if (!parseInt(entry.substr(at + 1), seconds)) {
+                result.errors.push_back({lineNo, "invalid borrow date"});
+                result.loans.resize(result.loans.size() - loanCount);
+                return;
+              }
+              loan.bookId = entry.substr(0, at);
+              loan.hasDate = true;
+              loan.borrowDate = std::chrono::system_clock::time_point(
+                  std::chrono::seconds(seconds));
+            }
+            result.loans.push_back(loan);
+            ++loanCount;
+          }
+        }
+
+        result.users.push_back(
+            makeShared<User>(resource, id, name, email, phone));
+        result.loanCounts.push_back(loanCount);
+      });
+  return result;
+}
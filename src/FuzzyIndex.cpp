@@ -0,0 +1,294 @@
+#include "FuzzyIndex.hpp"
+#include "TextFold.hpp"
+#include <algorithm>
+#include <iterator>
+
+// Bit vectors of a query word for Myers' algorithm: bit i of match[c] is
+// set where byte i of the word is c.
+struct FuzzyPattern {
+  uint64_t match[256];
+  uint64_t last; // Bit of the word's last byte.
+  int length;
+};
+
+// Builds the bit vectors of a folded word of 1 to 64 bytes.
+static void buildPattern(std::string_view word, FuzzyPattern &pattern) {
+  std::fill(std::begin(pattern.match), std::end(pattern.match), 0);
+  for (size_t i = 0; i < word.size(); ++i) {
+    pattern.match[static_cast<unsigned char>(word[i])] |= uint64_t(1) << i;
+  }
+  pattern.last = uint64_t(1) << (word.size() - 1);
+  pattern.length = static_cast<int>(word.size());
+}
+
+// Myers' bit-parallel edit distance between the pattern's word and text.
+// A column of the dynamic programming matrix is held as vertical deltas in
+// two words and advanced one byte of text at a time, while the score
+// tracks its last row. Stops with a score above maxEdits once the rest of
+// the text cannot bring it down far enough.
+static int myersDistance(const FuzzyPattern &pattern, const char *text,
+                         size_t length, int maxEdits) {
+  uint64_t positive = ~uint64_t(0);
+  uint64_t negative = 0;
+  int score = pattern.length;
+  for (size_t i = 0; i < length; ++i) {
+    uint64_t eq = pattern.match[static_cast<unsigned char>(text[i])];
+    uint64_t xv = eq | negative;
+    uint64_t xh = (((eq & positive) + positive) ^ positive) | eq;
+    uint64_t ph = negative | ~(xh | positive);
+    uint64_t mh = positive & xh;
+    // Branch-free, since which way the score moves is unpredictable.
+    score += static_cast<int>((ph & pattern.last) != 0) -
+             static_cast<int>((mh & pattern.last) != 0);
+    // The first row counts the text bytes consumed so far.
+    ph = (ph << 1) | 1;
+    mh <<= 1;
+    positive = mh | ~(xv | ph);
+    negative = ph & xv;
+    // The score falls by at most one per remaining byte.
+    if (score - static_cast<int>(length - i - 1) > maxEdits) {
+      return maxEdits + 1;
+    }
+  }
+  return score;
+}
+
+// Returns true for the bytes words are made of: ASCII letters and digits,
+// and every byte of a multi-byte UTF-8 character.
+static bool isWordByte(char c) {
+  auto byte = static_cast<unsigned char>(c);
+  return (byte >= '0' && byte <= '9') || (byte >= 'a' && byte <= 'z') ||
+         (byte >= 'A' && byte <= 'Z') || byte >= 0x80;
+}
+
+// Splits text into words and keeps the distinct ones.
+void FuzzyIndex::wordsOf(std::string_view text,
+                         std::vector<std::string> &out) {
+  out.clear();
+  size_t pos = 0;
+  while (pos < text.size()) {
+    while (pos < text.size() && !isWordByte(text[pos])) {
+      ++pos;
+    }
+    size_t start = pos;
+    while (pos < text.size() && isWordByte(text[pos])) {
+      ++pos;
+    }
+    if (pos > start) {
+      out.emplace_back(text.substr(start, pos - start));
+    }
+  }
+  std::sort(out.begin(), out.end());
+  out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+// Sets one bit per distinct byte value, modulo 64. Bytes that share a bit
+// only make the filter less selective, never wrong.
+uint64_t FuzzyIndex::maskOf(std::string_view word) {
+  uint64_t mask = 0;
+  for (char c : word) {
+    mask |= uint64_t(1) << (static_cast<unsigned char>(c) % 64);
+  }
+  return mask;
+}
+
+// Returns the ID of word, adding it to the vocabulary if it is new.
+uint32_t FuzzyIndex::idOf(const std::string &word) {
+  auto [it, added] =
+      wordIds.emplace(word, static_cast<uint32_t>(words.size()));
+  if (added) {
+    words.push_back({static_cast<uint32_t>(wordText.size()),
+                     static_cast<uint32_t>(word.size()), maskOf(word)});
+    wordText += word;
+    postings.emplace_back();
+  }
+  return it->second;
+}
+
+// Returns the edit distance between two folded words.
+int FuzzyIndex::distance(std::string_view word, std::string_view other,
+                         int maxEdits) {
+  if (word.empty()) {
+    return static_cast<int>(other.size());
+  }
+  FuzzyPattern pattern;
+  buildPattern(word.substr(0, maxWordLength), pattern);
+  return myersDistance(pattern, other.data(), other.size(), maxEdits);
+}
+
+// Returns none up to two bytes, one up to five, then two.
+int FuzzyIndex::defaultMaxEdits(size_t wordLength) {
+  return wordLength <= 2 ? 0 : wordLength <= 5 ? 1 : 2;
+}
+
+// Indexes text as document doc.
+void FuzzyIndex::add(uint32_t doc, std::string_view text) {
+  std::vector<std::string> found;
+  wordsOf(text, found);
+  for (const auto &word : found) {
+    auto &docs = postings[idOf(word)];
+    if (docs.empty() || docs.back() < doc) {
+      docs.push_back(doc);
+    } else {
+      docs.insert(std::lower_bound(docs.begin(), docs.end(), doc), doc);
+    }
+  }
+}
+
+// Collects the documents leaving and joining each word's list, then
+// rewrites every touched list in one merge.
+void FuzzyIndex::replace(
+    const std::vector<TrigramIndex::TextChange> &changes) {
+  std::unordered_map<uint32_t, std::vector<uint32_t>> removed, inserted;
+  std::vector<std::string> oldWords, newWords, gone, added;
+  for (const auto &change : changes) {
+    wordsOf(change.oldText, oldWords);
+    wordsOf(change.newText, newWords);
+    gone.clear();
+    added.clear();
+    std::set_difference(oldWords.begin(), oldWords.end(), newWords.begin(),
+                        newWords.end(), std::back_inserter(gone));
+    std::set_difference(newWords.begin(), newWords.end(), oldWords.begin(),
+                        oldWords.end(), std::back_inserter(added));
+    for (const auto &word : gone) {
+      removed[idOf(word)].push_back(change.doc);
+    }
+    for (const auto &word : added) {
+      inserted[idOf(word)].push_back(change.doc);
+    }
+  }
+
+  std::vector<uint32_t> kept;
+  for (auto &[id, docs] : removed) {
+    std::sort(docs.begin(), docs.end());
+    auto &list = postings[id];
+    kept.clear();
+    std::set_difference(list.begin(), list.end(), docs.begin(), docs.end(),
+                        std::back_inserter(kept));
+    list.swap(kept);
+  }
+  std::vector<uint32_t> merged;
+  for (auto &[id, docs] : inserted) {
+    std::sort(docs.begin(), docs.end());
+    auto &list = postings[id];
+    merged.clear();
+    std::merge(list.begin(), list.end(), docs.begin(), docs.end(),
+               std::back_inserter(merged));
+    list.swap(merged);
+  }
+}
+
+// Finds, for each query word, every document with a close word and its
+// best distance; intersects those lists, shortest first, summing the
+// distances; and keeps the k best.
+bool FuzzyIndex::search(std::string_view query, int maxEdits, size_t k,
+                        std::vector<Match> &out) const {
+  out.clear();
+  std::vector<std::string> queryWords;
+  wordsOf(foldText(query), queryWords);
+  if (queryWords.empty()) {
+    return false;
+  }
+  for (const auto &word : queryWords) {
+    if (word.size() > maxWordLength) {
+      return false;
+    }
+  }
+
+  std::vector<std::vector<Match>> perWord;
+  std::vector<std::pair<uint32_t, int>> close;
+  for (const auto &word : queryWords) {
+    int budget = maxEdits < 0 ? defaultMaxEdits(word.size()) : maxEdits;
+    FuzzyPattern pattern;
+    buildPattern(word, pattern);
+    uint64_t mask = maskOf(word);
+    int length = static_cast<int>(word.size());
+
+    close.clear();
+    for (size_t id = 0; id < words.size(); ++id) {
+      const Word &entry = words[id];
+      int other = static_cast<int>(entry.length);
+      if (other > length + budget || other < length - budget ||
+          __builtin_popcountll(mask & ~entry.mask) > budget ||
+          __builtin_popcountll(entry.mask & ~mask) > budget ||
+          postings[id].empty()) {
+        continue;
+      }
+      int distance = myersDistance(pattern, wordText.data() + entry.offset,
+                                   entry.length, budget);
+      if (distance <= budget) {
+        close.emplace_back(static_cast<uint32_t>(id), distance);
+      }
+    }
+
+    std::vector<Match> docs;
+    for (const auto &[id, distance] : close) {
+      for (uint32_t doc : postings[id]) {
+        docs.push_back({doc, distance});
+      }
+    }
+    if (close.size() > 1) {
+      // Several words' lists: order by document, closest word first, and
+      // keep each document once.
+      std::sort(docs.begin(), docs.end(), [](const Match &a, const Match &b) {
+        return a.doc != b.doc ? a.doc < b.doc : a.distance < b.distance;
+      });
+      docs.erase(std::unique(docs.begin(), docs.end(),
+                             [](const Match &a, const Match &b) {
+                               return a.doc == b.doc;
+                             }),
+                 docs.end());
+    }
+    if (docs.empty()) {
+      return true; // Some query word is close to nothing.
+    }
+    perWord.push_back(std::move(docs));
+  }
+
+  std::sort(perWord.begin(), perWord.end(),
+            [](const auto &a, const auto &b) { return a.size() < b.size(); });
+  std::vector<Match> matches = std::move(perWord[0]);
+  for (size_t i = 1; i < perWord.size() && !matches.empty(); ++i) {
+    const auto &list = perWord[i];
+    size_t kept = 0;
+    auto from = list.begin();
+    for (const Match &match : matches) {
+      from = std::lower_bound(
+          from, list.end(), match.doc,
+          [](const Match &a, uint32_t doc) { return a.doc < doc; });
+      if (from == list.end()) {
+        break;
+      }
+      if (from->doc == match.doc) {
+        matches[kept++] = {match.doc, match.distance + from->distance};
+      }
+    }
+    matches.resize(kept);
+  }
+
+  auto better = [](const Match &a, const Match &b) {
+    return a.distance != b.distance ? a.distance < b.distance : a.doc < b.doc;
+  };
+  size_t count = std::min(k, matches.size());
+  std::partial_sort(matches.begin(), matches.begin() + count, matches.end(),
+                    better);
+  matches.resize(count);
+  out = std::move(matches);
+  return true;
+}
+
+// Returns the number of distinct words.
+size_t FuzzyIndex::vocabularySize() const { return words.size(); }
+
+// Approximate heap memory used by the index, in bytes.
+size_t FuzzyIndex::memoryUsage() const {
+  size_t bytes = wordText.capacity() + words.capacity() * sizeof(Word) +
+                 postings.capacity() * sizeof(std::vector<uint32_t>);
+  for (const auto &list : postings) {
+    bytes += list.capacity() * sizeof(uint32_t);
+  }
+  for (const auto &[word, id] : wordIds) {
+    bytes += sizeof(word) + word.capacity() + sizeof(id) + 2 * sizeof(void *);
+  }
+  return bytes;
+}
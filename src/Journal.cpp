@@ -0,0 +1,306 @@
+#include "Journal.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+
+// Commits anything pending and closes the journal file on destruction.
+Journal::~Journal() { close(); }
+
+// Opens (creating if needed) the journal file for appending.
+bool Journal::open(const std::string &name) {
+  close();
+  int newFd = ::open(name.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+  if (newFd < 0) {
+    std::cerr << "Error opening journal for writing: " << name << std::endl;
+    return false;
+  }
+
+  {
+    std::lock_guard<std::mutex> io(ioMutex);
+    std::lock_guard<std::mutex> lock(stateMutex);
+    filename = name;
+    fd = newFd;
+    stopping = false;
+    failed = false;
+  }
+  flusher = std::thread(&Journal::flusherLoop, this);
+  return true;
+}
+
+// Commits anything pending and closes the journal file.
+void Journal::close() {
+  {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    if (fd < 0) {
+      return;
+    }
+    stopping = true;
+  }
+  flushRequested.notify_all();
+  if (flusher.joinable()) {
+    flusher.join();
+  }
+  flushPending();
+
+  {
+    std::lock_guard<std::mutex> io(ioMutex);
+    std::lock_guard<std::mutex> lock(stateMutex);
+    ::close(fd);
+    fd = -1;
+  }
+  committed.notify_all(); // Release anyone still waiting for a commit.
+}
+
+// Returns true while the journal file is open.
+bool Journal::isOpen() const {
+  std::lock_guard<std::mutex> lock(stateMutex);
+  return fd >= 0;
+}
+
+// Returns true once a commit has failed.
+bool Journal::hasFailed() const {
+  std::lock_guard<std::mutex> lock(stateMutex);
+  return failed;
+}
+
+// Changes how appended records are committed.
+void Journal::setDurability(const DurabilityOptions &newOptions) {
+  {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    options = newOptions;
+  }
+  flushRequested.notify_all();
+  if (newOptions.mode == DurabilityMode::Synchronous) {
+    flushPending(); // Nothing may stay pending in synchronous mode.
+  }
+}
+
+// Returns the current durability options.
+DurabilityOptions Journal::getDurability() const {
+  std::lock_guard<std::mutex> lock(stateMutex);
+  return options;
+}
+
+// Appends one record to the pending batch and returns its sequence number.
+uint64_t Journal::append(const std::vector<std::string> &fields,
+                         bool deferCommit) {
+  std::string line;
+  for (size_t i = 0; i < fields.size(); ++i) {
+    line += fields[i];
+    if (i < fields.size() - 1) {
+      line += ','; // Separator between fields.
+    }
+  }
+  line += '\n';
+
+  uint64_t seq;
+  bool commitNow;
+  {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    if (fd < 0 || failed) {
+      return 0;
+    }
+    if (pendingCount == 0) {
+      pendingSince = std::chrono::steady_clock::now();
+    }
+    pending += line;
+    ++pendingCount;
+    seq = ++appendedSeq;
+
+    commitNow = options.mode == DurabilityMode::Synchronous && !deferCommit;
+    if (!commitNow &&
+        (pendingCount == 1 || pendingCount >= options.commitBatchSize)) {
+      // Start the commit timer for a new batch, or commit a full one early.
+      flushRequested.notify_one();
+    }
+  }
+
+  if (commitNow && !flushPending()) {
+    return 0;
+  }
+  return seq;
+}
+
+// Blocks until the record with the given sequence number is committed.
+bool Journal::waitForCommit(uint64_t seq) {
+  std::unique_lock<std::mutex> lock(stateMutex);
+  committed.wait(lock,
+                 [&] { return committedSeq >= seq || failed || fd < 0; });
+  return committedSeq >= seq;
+}
+
+// Blocks until every record appended so far is committed.
+bool Journal::waitForAll() {
+  uint64_t seq;
+  {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    seq = appendedSeq;
+  }
+  return waitForCommit(seq);
+}
+
+// Commits everything pending right away.
+bool Journal::sync() { return flushPending(); }
+
+// Writes the pending batch to the file, fsync'ing it unless in Async mode.
+bool Journal::flushPending() {
+  // Holding ioMutex while taking the batch keeps batches in sequence order.
+  std::lock_guard<std::mutex> io(ioMutex);
+
+  std::string batch;
+  size_t count;
+  uint64_t lastSeq;
+  std::chrono::steady_clock::time_point since;
+  DurabilityMode mode;
+  {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    if (pendingCount == 0 || fd < 0) {
+      return !failed;
+    }
+    batch.swap(pending);
+    count = pendingCount;
+    pendingCount = 0;
+    lastSeq = appendedSeq;
+    since = pendingSince;
+    mode = options.mode;
+    if (failed) {
+      return false; // The batch is dropped; its waiters already gave up.
+    }
+  }
+
+  // The whole batch goes out in as few writes as possible so that O_APPEND
+  // keeps it contiguous.
+  bool ok = true;
+  auto writeStart = std::chrono::steady_clock::now();
+  const char *data = batch.data();
+  size_t remaining = batch.size();
+  while (remaining > 0) {
+    ssize_t written = ::write(fd, data, remaining);
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written < 0) {
+      std::cerr << "Error writing journal: " << filename << std::endl;
+      ok = false;
+      break;
+    }
+    data += written;
+    remaining -= written;
+  }
+  if (ok && mode != DurabilityMode::Async) {
+    int result;
+    do {
+      result = ::fsync(fd);
+    } while (result != 0 && errno == EINTR);
+    if (result != 0) {
+      std::cerr << "Error syncing journal: " << filename << std::endl;
+      ok = false;
+    }
+  }
+
+  auto writeEnd = std::chrono::steady_clock::now();
+  uint64_t latencyNs =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(writeEnd - since)
+          .count();
+  uint64_t writeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         writeEnd - writeStart)
+                         .count();
+  {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    if (!ok) {
+      failed = true; // Wakes this batch's waiters with an error.
+    } else {
+      committedSeq = lastSeq;
+      ++stats.commits;
+      stats.records += count;
+      stats.largestBatch = std::max<uint64_t>(stats.largestBatch, count);
+      stats.totalCommitLatencyNs += latencyNs;
+      stats.maxCommitLatencyNs = std::max(stats.maxCommitLatencyNs, latencyNs);
+      stats.bytes += batch.size();
+      stats.totalWriteNs += writeNs;
+    }
+  }
+  committed.notify_all();
+  return ok;
+}
+
+// Commits a batch whenever it is full or its oldest record has waited for
+// the commit interval.
+void Journal::flusherLoop() {
+  std::unique_lock<std::mutex> lock(stateMutex);
+  while (!stopping) {
+    flushRequested.wait(lock, [&] {
+      return stopping ||
+             (options.mode != DurabilityMode::Synchronous && pendingCount > 0);
+    });
+    if (stopping) {
+      break;
+    }
+
+    auto deadline = pendingSince + options.commitInterval;
+    flushRequested.wait_until(lock, deadline, [&] {
+      return stopping || pendingCount >= options.commitBatchSize;
+    });
+
+    lock.unlock();
+    flushPending();
+    lock.lock();
+  }
+}
+
+// Discards all records, used once they have been folded into a snapshot.
+bool Journal::truncate() {
+  flushPending();
+
+  std::lock_guard<std::mutex> io(ioMutex);
+  if (fd < 0) {
+    return false;
+  }
+  if (::ftruncate(fd, 0) != 0) {
+    std::cerr << "Error truncating journal: " << filename << std::endl;
+    return false;
+  }
+  return ::fsync(fd) == 0;
+}
+
+// Returns a copy of the commit counters.
+JournalStats Journal::getStats() const {
+  std::lock_guard<std::mutex> lock(stateMutex);
+  return stats;
+}
+
+// Calls apply for every complete record in the journal file, in order.
+size_t Journal::replay(
+    const std::string &name,
+    const std::function<void(const std::vector<std::string> &)> &apply) {
+  std::ifstream file(name);
+  if (!file.is_open()) {
+    return 0; // No journal yet, nothing to replay.
+  }
+
+  size_t count = 0;
+  std::string line;
+  while (std::getline(file, line)) {
+    if (file.eof()) {
+      break; // Torn final record from an interrupted write.
+    }
+
+    std::vector<std::string> fields;
+    std::istringstream iss(line);
+    std::string field;
+    while (std::getline(iss, field, ',')) {
+      fields.push_back(field);
+    }
+    if (!line.empty() && line.back() == ',') {
+      fields.emplace_back(); // Keep a trailing empty field.
+    }
+
+    apply(fields);
+    ++count;
+  }
+  return count;
+}
@@ -0,0 +1,100 @@
+#include "LatencyHistogram.hpp"
+#include <algorithm>
+
+// Values below subBuckets get a bucket each; above that, the top
+// subBucketBits bits after the leading one pick the bucket within the value's
+// power of two.
+size_t LatencyHistogram::bucketOf(uint64_t value) {
+  if (value < subBuckets) {
+    return static_cast<size_t>(value);
+  }
+  size_t exponent = 63 - __builtin_clzll(value);
+  size_t shift = exponent - subBucketBits;
+  size_t sub = static_cast<size_t>(value >> shift) & (subBuckets - 1);
+  return (shift + 1) * subBuckets + sub;
+}
+
+// Returns the smallest value that falls into bucket.
+uint64_t LatencyHistogram::lowestIn(size_t bucket) {
+  if (bucket < subBuckets) {
+    return bucket;
+  }
+  size_t shift = bucket / subBuckets - 1;
+  uint64_t sub = bucket % subBuckets;
+  return (subBuckets + sub) << shift;
+}
+
+// Adds one value.
+void LatencyHistogram::record(uint64_t value) {
+  ++counts[bucketOf(value)];
+  ++total;
+  largest = std::max(largest, value);
+}
+
+// Adds every value recorded in other.
+void LatencyHistogram::merge(const LatencyHistogram &other) {
+  for (size_t i = 0; i < bucketCount; ++i) {
+    counts[i] += other.counts[i];
+  }
+  total += other.total;
+  largest = std::max(largest, other.largest);
+}
+
+// Forgets every value.
+void LatencyHistogram::clear() {
+  counts.fill(0);
+  total = 0;
+  largest = 0;
+}
+
+uint64_t LatencyHistogram::count() const { return total; }
+uint64_t LatencyHistogram::max() const { return largest; }
+
+// Walks the buckets until the requested share of values is covered.
+uint64_t LatencyHistogram::percentile(double fraction) const {
+  if (total == 0) {
+    return 0;
+  }
+  uint64_t rank = static_cast<uint64_t>(fraction * total);
+  rank = std::min(std::max<uint64_t>(rank, 1), total);
+  uint64_t seen = 0;
+  for (size_t i = 0; i < bucketCount; ++i) {
+    seen += counts[i];
+    if (seen >= rank) {
+      uint64_t upper =
+          i + 1 < bucketCount ? lowestIn(i + 1) - 1 : UINT64_MAX;
+      return std::min(upper, largest);
+    }
+  }
+  return largest;
+}
+
+// Sums the buckets that lie wholly below limit.
+uint64_t LatencyHistogram::countBelow(uint64_t limit) const {
+  uint64_t below = 0;
+  for (size_t i = 0; i < bucketCount && lowestIn(i) < limit; ++i) {
+    below += counts[i];
+  }
+  return below;
+}
+
+// Adds one value.
+void AtomicLatencyHistogram::record(uint64_t value) {
+  counts[LatencyHistogram::bucketOf(value)].fetch_add(
+      1, std::memory_order_relaxed);
+  total.fetch_add(1, std::memory_order_relaxed);
+  uint64_t seen = largest.load(std::memory_order_relaxed);
+  while (value > seen && !largest.compare_exchange_weak(
+                             seen, value, std::memory_order_relaxed)) {
+  }
+}
+
+// Adds every value recorded so far to histogram.
+void AtomicLatencyHistogram::addTo(LatencyHistogram &histogram) const {
+  for (size_t i = 0; i < LatencyHistogram::bucketCount; ++i) {
+    histogram.counts[i] += counts[i].load(std::memory_order_relaxed);
+  }
+  histogram.total += total.load(std::memory_order_relaxed);
+  histogram.largest =
+      std::max(histogram.largest, largest.load(std::memory_order_relaxed));
+}
@@ -0,0 +1,308 @@
+#include "LibraryServer.hpp"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Bytes read from a client per call.
+static const size_t readChunkBytes = 1 << 16;
+// A request line longer than this closes the connection.
+static const size_t maxRequestBytes = 1 << 20;
+// A client that stops reading its responses for this long is dropped.
+static const int sendTimeoutSecs = 5;
+
+// Writes all of data to fd. Gives up if the client has gone away.
+static bool writeAll(int fd, const std::string &data) {
+  size_t done = 0;
+  while (done < data.size()) {
+    ssize_t written =
+        send(fd, data.data() + done, data.size() - done, MSG_NOSIGNAL);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    done += static_cast<size_t>(written);
+  }
+  return true;
+}
+
+LibraryServer::Connection::~Connection() {
+  if (fd >= 0) {
+    ::close(fd);
+  }
+}
+
+LibraryServer::LibraryServer(LibrarySystem &library,
+                             const ServerOptions &options)
+    : library(library), options(options), processor(library) {}
+
+LibraryServer::~LibraryServer() {
+  if (listenFd >= 0) {
+    ::close(listenFd);
+    if (!options.socketPath.empty()) {
+      unlink(options.socketPath.c_str());
+    }
+  }
+  for (int fd : wakePipe) {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+}
+
+// Binds and listens on the configured Unix socket or localhost TCP port.
+bool LibraryServer::start() {
+  if (pipe(wakePipe) != 0) {
+    std::cerr << "Error creating wake-up pipe: " << std::strerror(errno)
+              << std::endl;
+    return false;
+  }
+  fcntl(wakePipe[0], F_SETFL, O_NONBLOCK);
+  fcntl(wakePipe[1], F_SETFL, O_NONBLOCK);
+
+  if (!options.socketPath.empty()) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (options.socketPath.size() >= sizeof(address.sun_path)) {
+      std::cerr << "Socket path too long: " << options.socketPath
+                << std::endl;
+      return false;
+    }
+    std::strcpy(address.sun_path, options.socketPath.c_str());
+    listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd >= 0) {
+      unlink(options.socketPath.c_str()); // Left behind by an earlier run.
+      if (bind(listenFd, reinterpret_cast<sockaddr *>(&address),
+               sizeof(address)) != 0) {
+        std::cerr << "Error binding " << options.socketPath << ": "
+                  << std::strerror(errno) << std::endl;
+        ::close(listenFd);
+        listenFd = -1;
+        return false;
+      }
+    }
+  } else {
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(options.tcpPort));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenFd >= 0) {
+      int reuse = 1;
+      setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+      if (bind(listenFd, reinterpret_cast<sockaddr *>(&address),
+               sizeof(address)) != 0) {
+        std::cerr << "Error binding port " << options.tcpPort << ": "
+                  << std::strerror(errno) << std::endl;
+        ::close(listenFd);
+        listenFd = -1;
+        return false;
+      }
+    }
+  }
+
+  if (listenFd < 0 || listen(listenFd, SOMAXCONN) != 0) {
+    std::cerr << "Error listening: " << std::strerror(errno) << std::endl;
+    return false;
+  }
+  fcntl(listenFd, F_SETFL, O_NONBLOCK);
+  return true;
+}
+
+// Asks run() to return; async-signal-safe.
+void LibraryServer::stop() {
+  stopping = true;
+  char byte = 0;
+  ssize_t ignored = write(wakePipe[1], &byte, 1);
+  (void)ignored;
+}
+
+// Accepts every pending client.
+void LibraryServer::acceptClients() {
+  while (true) {
+    int fd = accept(listenFd, nullptr, nullptr);
+    if (fd < 0) {
+      return; // EAGAIN: no more pending clients.
+    }
+    timeval timeout{sendTimeoutSecs, 0};
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    auto connection = std::make_shared<Connection>();
+    connection->fd = fd;
+    connections[fd] = connection;
+  }
+}
+
+// Reads what the client sent and queues each complete line. Starts a worker
+// on the connection unless one is already draining it.
+bool LibraryServer::readRequests(const std::shared_ptr<Connection> &connection,
+                                 ThreadPool &workers) {
+  char buffer[readChunkBytes];
+  ssize_t received = read(connection->fd, buffer, sizeof(buffer));
+  if (received < 0) {
+    return errno == EINTR || errno == EAGAIN;
+  }
+  if (received == 0) {
+    return false; // Hung up; queued requests are still answered.
+  }
+
+  std::string &inbox = connection->inbox;
+  inbox.append(buffer, static_cast<size_t>(received));
+  std::deque<std::string> lines;
+  size_t start = 0;
+  size_t end;
+  while ((end = inbox.find('\n', start)) != std::string::npos) {
+    size_t length = end - start;
+    if (length > 0 && inbox[end - 1] == '\r') {
+      --length;
+    }
+    if (length > 0) {
+      lines.emplace_back(inbox, start, length);
+    }
+    start = end + 1;
+  }
+  inbox.erase(0, start);
+  if (inbox.size() > maxRequestBytes) {
+    std::cerr << "Dropping client: request line too long" << std::endl;
+    return false;
+  }
+  if (lines.empty()) {
+    return true;
+  }
+
+  bool startWorker;
+  {
+    std::lock_guard<std::mutex> lock(connection->mutex);
+    for (auto &line : lines) {
+      connection->queue.push_back(std::move(line));
+    }
+    startWorker = !connection->draining;
+    connection->draining = true;
+  }
+  if (startWorker) {
+    workers.submit([this, connection] { drain(connection); });
+  }
+  return true;
+}
+
+// Replaces the response of every request that changed the library with an
+// error, once the journal commit covering those changes has failed.
+static void failChanges(std::string &responses,
+                        const std::vector<bool> &changes) {
+  std::string failed;
+  size_t start = 0;
+  for (bool changed : changes) {
+    size_t end = responses.find('\n', start) + 1;
+    if (changed) {
+      failed += "error\tjournal commit failed\n";
+    } else {
+      failed.append(responses, start, end - start);
+    }
+    start = end;
+  }
+  responses.swap(failed);
+}
+
+// Executes the connection's queued requests in order. Requests that arrived
+// together are answered together, after one wait for the journal commit
+// covering all of their changes; if that commit fails, the changes are
+// answered with an error instead.
+void LibraryServer::drain(const std::shared_ptr<Connection> &connection) {
+  std::deque<std::string> requests;
+  std::string responses;
+  std::vector<bool> changes;
+  while (true) {
+    {
+      std::lock_guard<std::mutex> lock(connection->mutex);
+      if (connection->queue.empty()) {
+        connection->draining = false;
+        return;
+      }
+      requests.swap(connection->queue);
+    }
+
+    bool changed = false;
+    changes.clear();
+    responses.clear();
+    for (const auto &request : requests) {
+      changes.push_back(processor.execute(request, responses));
+      changed |= changes.back();
+      responses += '\n';
+    }
+    requests.clear();
+
+    if (changed && !library.waitForJournal()) {
+      failChanges(responses, changes);
+    }
+    if (!writeAll(connection->fd, responses)) {
+      shutdown(connection->fd, SHUT_RDWR); // The I/O thread sees the hang-up.
+    }
+  }
+}
+
+// Polls the listening socket and every connection until stop() is called.
+void LibraryServer::run() {
+  // Responses wait for the journal commit; group commit lets concurrent
+  // clients share each fsync instead of paying for one per request.
+  auto previous = library.getDurability();
+  if (previous.mode == DurabilityMode::Synchronous) {
+    DurabilityOptions grouped;
+    grouped.mode = DurabilityMode::GroupCommit;
+    library.setDurability(grouped);
+  }
+
+  size_t threadCount = options.workerThreads;
+  if (threadCount == 0) {
+    threadCount = std::thread::hardware_concurrency();
+  }
+
+  {
+    ThreadPool workers(threadCount);
+    std::vector<pollfd> fds;
+    std::vector<std::shared_ptr<Connection>> polled;
+    while (!stopping) {
+      fds.clear();
+      polled.clear();
+      fds.push_back({wakePipe[0], POLLIN, 0});
+      fds.push_back({listenFd, POLLIN, 0});
+      for (const auto &entry : connections) {
+        fds.push_back({entry.first, POLLIN, 0});
+        polled.push_back(entry.second);
+      }
+
+      if (poll(fds.data(), fds.size(), -1) < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        std::cerr << "Error polling: " << std::strerror(errno) << std::endl;
+        break;
+      }
+      if (fds[1].revents & POLLIN) {
+        acceptClients();
+      }
+      for (size_t i = 0; i < polled.size(); ++i) {
+        if (fds[i + 2].revents == 0) {
+          continue;
+        }
+        if (!readRequests(polled[i], workers)) {
+          // Dropping our reference; a worker still answering its last
+          // requests keeps the socket open until it is done.
+          connections.erase(fds[i + 2].fd);
+        }
+      }
+    }
+    // Leaving the scope lets the workers finish what was already queued.
+  }
+  connections.clear();
+
+  library.setDurability(previous);
+}
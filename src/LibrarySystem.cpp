@@ -1,294 +1,1755 @@
 #include "LibrarySystem.hpp"
+#include "CsvLoader.hpp"
+#include "MappedFile.hpp"
+#include "Snapshot.hpp"
+#include "TextFold.hpp"
 #include <algorithm>
 #include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
-#include <mutex>
-#include <sstream>
+#include <thread>
 #include <unordered_map>
+#include <fcntl.h>
+#include <unistd.h>
 
-// Mutex to ensure thread safety in library operations.
-std::mutex libraryMutex;
+// Returns the size of filename in bytes, or 0 if it cannot be read.
+static uint64_t fileSize(const std::string &filename) {
+  std::error_code ec;
+  auto size = std::filesystem::file_size(filename, ec);
+  return ec ? 0 : size;
+}
+
+// Converts a borrow date to the seconds-since-epoch form used on disk.
+static std::string toEpochSeconds(std::chrono::system_clock::time_point date) {
+  return std::to_string(std::chrono::duration_cast<std::chrono::seconds>(
+                            date.time_since_epoch())
+                            .count());
+}
+
+// Converts a seconds-since-epoch string back into a borrow date.
+static std::chrono::system_clock::time_point
+fromEpochSeconds(const std::string &seconds) {
+  return std::chrono::system_clock::time_point(
+      std::chrono::seconds(std::stoll(seconds)));
+}
+
+// Flushes filename, which may be a directory, to stable storage.
+static bool syncFile(const std::string &filename) {
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  bool ok = ::fsync(fd) == 0;
+  ::close(fd);
+  return ok;
+}
+
+// Flushes the directory holding filename, making renames in it durable.
+static bool syncDirectory(const std::string &filename) {
+  auto dir = std::filesystem::path(filename).parent_path();
+  return syncFile(dir.empty() ? "." : dir.string());
+}
+
+// Names the file whose presence means a compaction's new books / users
+// files are complete and the journal is already folded into them.
+static std::string compactionMarker(const std::string &booksFile) {
+  return booksFile + ".compact";
+}
+
+// Creates the compaction marker and makes it durable.
+static bool writeMarker(const std::string &marker) {
+  int fd = ::open(marker.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  bool ok = ::fsync(fd) == 0;
+  ::close(fd);
+  return ok && syncDirectory(marker);
+}
+
+// Removes the compaction marker and makes the removal durable.
+static bool removeMarker(const std::string &marker) {
+  return std::remove(marker.c_str()) == 0 && syncDirectory(marker);
+}
+
+// Renames whichever compacted files are still beside their targets over
+// them. Safe to repeat after a crash part way through.
+static bool installCompactedFiles(const std::string &booksFile,
+                                  const std::string &usersFile) {
+  for (const auto *target : {&booksFile, &usersFile}) {
+    const std::string tmp = *target + ".tmp";
+    std::error_code ec;
+    if (std::filesystem::exists(tmp, ec) &&
+        std::rename(tmp.c_str(), target->c_str()) != 0) {
+      return false;
+    }
+  }
+  return syncDirectory(booksFile) && syncDirectory(usersFile);
+}
+
+// Sets up the storage for the chosen mode.
+LibrarySystem::LibrarySystem(StorageMode mode)
+    : storageMode(mode), itemResource(std::pmr::new_delete_resource()) {
+  if (mode == StorageMode::Arena) {
+    arenas.push_back(std::make_unique<Arena>());
+    itemResource = arenas.front().get();
+  }
+}
+
+// Returns the storage mode.
+StorageMode LibrarySystem::getStorageMode() const { return storageMode; }
+
+// Creates a book, with its control block and text, from itemResource.
+std::shared_ptr<Book>
+LibrarySystem::createBook(std::string_view id, std::string_view title,
+                          std::string_view author, std::string_view category,
+                          int year, bool available) const {
+  return makeShared<Book>(itemResource, id, title, author, category, year,
+                          available);
+}
+
+// Creates a user, with its control block and text, from itemResource.
+std::shared_ptr<User> LibrarySystem::createUser(std::string_view id,
+                                                std::string_view name,
+                                                std::string_view email,
+                                                std::string_view phone) const {
+  return makeShared<User>(itemResource, id, name, email, phone);
+}
+
+// Sums the space held by every arena.
+ArenaUsage LibrarySystem::getArenaUsage() const {
+  std::shared_lock<CatalogMutex> lock(catalogMutex);
+  ArenaUsage usage;
+  usage.arenas = arenas.size();
+  for (const auto &arena : arenas) {
+    usage.blocks += arena->blockCount();
+    usage.bytesUsed += arena->bytesUsed();
+    usage.bytesReserved += arena->bytesReserved();
+  }
+  return usage;
+}
+
+// Builds the journal record that adds (AB) or upserts (UB) book.
+static std::vector<std::string> bookRecord(const char *type, const Book &book) {
+  return {type,
+          book.getId(),
+          book.getTitle(),
+          book.getAuthor(),
+          book.getCategory(),
+          std::to_string(book.getYear()),
+          book.isAvailable() ? "1" : "0"};
+}
+
+// Builds the journal record that adds (AU) or upserts (UU) user.
+static std::vector<std::string> userRecord(const char *type, const User &user) {
+  return {type, user.getId(), user.getName(), user.getEmail(),
+          user.getPhone()};
+}
+
+// Adds an item (book or user) to the library system, unless its ID is
+// already taken.
+bool LibrarySystem::addItem(const std::shared_ptr<Item> &item) {
+  OperationTimer timer(metrics, LibraryOperation::AddItem);
+  std::unique_lock<CatalogMutex> lock(catalogMutex);
+  if (journal.hasFailed() || !storeItem(item)) {
+    timer.fail();
+    return false;
+  }
+
+  // Journal while still exclusive so the record precedes any borrow of it.
+  if (!journal.isOpen()) {
+    return true;
+  }
+  uint64_t seq = 0;
+  if (auto book = std::dynamic_pointer_cast<Book>(item)) {
+    seq = journal.append(bookRecord("AB", *book));
+  } else if (auto user = std::dynamic_pointer_cast<User>(item)) {
+    seq = journal.append(userRecord("AU", *user));
+  }
+  if (seq == 0) {
+    timer.fail();
+    return false;
+  }
+  return true;
+}
 
-// Adds an item (book or user) to the library system.
-void LibrarySystem::addItem(const std::shared_ptr<Item> &item) {
+// Files an item into the typed stores without journaling it.
+bool LibrarySystem::storeItem(const std::shared_ptr<Item> &item) {
+  // Resolve the concrete type once here so that lookups never have to.
+  if (auto book = std::dynamic_pointer_cast<Book>(item)) {
+    auto doc = static_cast<uint32_t>(books.size());
+    if (!bookIndex.emplace(book->getId(), doc).second) {
+      return false;
+    }
+    titleIndex.add(doc, book->getFoldedTitleView());
+    authorIndex.add(doc, book->getFoldedAuthorView());
+    categoryIndex.add(doc, book->getFoldedCategoryView());
+    titleFuzzyIndex.add(doc, book->getFoldedTitleView());
+    authorFuzzyIndex.add(doc, book->getFoldedAuthorView());
+    titleCompletions.add(doc, book->getTitleView(), book->getFoldedTitleView(),
+                         book->getBorrowCount());
+    authorCompletions.add(doc, book->getAuthorView(),
+                          book->getFoldedAuthorView(), book->getBorrowCount());
+    attributeIndex.add(doc, book->getYear(), book->getCategoryView(),
+                       book->isAvailable());
+    popularity.add(doc, book->getBorrowCount());
+    books.push_back(book);
+    bookItemSlots.push_back(items.size());
+  } else if (auto user = std::dynamic_pointer_cast<User>(item)) {
+    auto userId = user->getId();
+    if (!userIndex.emplace(userId, users.size()).second) {
+      return false;
+    }
+    // Index loans restored from storage before the user was stored.
+    for (const auto &bookId : user->getBorrowedBooksView()) {
+      loanIndex.add(userId, bookId, user->getBorrowDate(bookId));
+    }
+    users.push_back(user);
+    userItemSlots.push_back(items.size());
+  } else {
+    return false;
+  }
   items.push_back(item);
+  return true;
+}
+
+// Swaps in a new version of the book at slot. Its availability and borrow
+// count describe the copy on the shelf, not the catalog entry, so they are
+// carried over.
+std::shared_ptr<Book>
+LibrarySystem::replaceBook(size_t slot, const std::shared_ptr<Book> &book) {
+  auto old = books[slot];
+  if (old != book) {
+    book->setAvailable(old->isAvailable());
+    book->setBorrowCount(old->getBorrowCount());
+    items[bookItemSlots[slot]] = book;
+    books[slot] = book;
+  }
+  return old;
+}
+
+// Reindexes the text of every replaced book in one pass per index, so a
+// large upsert rewrites each affected posting list once.
+void LibrarySystem::reindexBooks(
+    const std::unordered_map<size_t, std::shared_ptr<Book>> &replaced) {
+  std::vector<TrigramIndex::TextChange> titles, authors, categories;
+  for (const auto &[slot, old] : replaced) {
+    auto doc = static_cast<uint32_t>(slot);
+    const auto &book = books[slot];
+    titles.push_back(
+        {doc, old->getFoldedTitleView(), book->getFoldedTitleView()});
+    authors.push_back(
+        {doc, old->getFoldedAuthorView(), book->getFoldedAuthorView()});
+    categories.push_back(
+        {doc, old->getFoldedCategoryView(), book->getFoldedCategoryView()});
+    attributeIndex.update(doc, book->getYear(), book->getCategoryView());
+    titleCompletions.replace(doc, book->getTitleView(),
+                             book->getFoldedTitleView(),
+                             book->getBorrowCount());
+    authorCompletions.replace(doc, book->getAuthorView(),
+                              book->getFoldedAuthorView(),
+                              book->getBorrowCount());
+  }
+  titleIndex.replace(titles);
+  authorIndex.replace(authors);
+  titleFuzzyIndex.replace(titles);
+  authorFuzzyIndex.replace(authors);
+  categoryIndex.replace(categories);
+}
+
+// Swaps in a new version of the user at slot, moving its open loans over.
+// The loan index is keyed by IDs, which do not change.
+void LibrarySystem::replaceUser(size_t slot,
+                                const std::shared_ptr<User> &user) {
+  const auto &old = users[slot];
+  if (old == user) {
+    return;
+  }
+  for (const auto &bookId : old->getBorrowedBooksView()) {
+    user->addBorrowedBook(bookId, old->getBorrowDate(bookId));
+  }
+  items[userItemSlots[slot]] = user;
+  users[slot] = user;
+}
+
+// Grows a vector to hold extra more elements, at least doubling it so that
+// a run of small batches still costs amortized constant time per element.
+template <typename T>
+static void reserveGrowing(std::vector<T> &values, size_t extra) {
+  if (values.size() + extra > values.capacity()) {
+    values.reserve(std::max(values.size() + extra, values.capacity() * 2));
+  }
+}
+
+// Same for the ID indexes, so they rehash at most once per doubling.
+static void reserveGrowing(std::unordered_map<std::string, size_t> &index,
+                           size_t extra) {
+  if (index.size() + extra > index.bucket_count() * index.max_load_factor()) {
+    index.reserve(std::max(index.size() + extra, index.size() * 2));
+  }
+}
+
+// Makes room for extra more books.
+void LibrarySystem::reserveForBooks(size_t extra) {
+  reserveGrowing(items, extra);
+  reserveGrowing(books, extra);
+  reserveGrowing(bookItemSlots, extra);
+  reserveGrowing(bookIndex, extra);
+}
+
+// Makes room for extra more users.
+void LibrarySystem::reserveForUsers(size_t extra) {
+  reserveGrowing(items, extra);
+  reserveGrowing(users, extra);
+  reserveGrowing(userItemSlots, extra);
+  reserveGrowing(userIndex, extra);
+}
+
+// Tallies one import outcome.
+static void countImport(ImportResult &result, ImportStatus status) {
+  result.statuses.push_back(status);
+  switch (status) {
+  case ImportStatus::Added:
+    ++result.added;
+    break;
+  case ImportStatus::Updated:
+    ++result.updated;
+    break;
+  case ImportStatus::Duplicate:
+    ++result.duplicates;
+    break;
+  case ImportStatus::Invalid:
+    ++result.invalid;
+    break;
+  }
+}
+
+// Adds a batch of books under one exclusive lock. Duplicates are found
+// through bookIndex, so the batch costs the same per book however large
+// the catalog is. The journal is committed once, after the lock is gone.
+ImportResult
+LibrarySystem::addBooks(const std::vector<std::shared_ptr<Book>> &batch,
+                        DuplicatePolicy policy) {
+  OperationTimer timer(metrics, LibraryOperation::Import);
+  ImportResult result;
+  result.statuses.reserve(batch.size());
+  bool journaled = false;
+  std::unordered_map<size_t, std::shared_ptr<Book>> replaced;
+  {
+    std::unique_lock<CatalogMutex> lock(catalogMutex);
+    reserveForBooks(batch.size());
+    for (const auto &book : batch) {
+      if (!book || book->getIdView().empty()) {
+        countImport(result, ImportStatus::Invalid);
+        continue;
+      }
+      ImportStatus status = ImportStatus::Added;
+      auto it = bookIndex.find(book->getId());
+      if (it == bookIndex.end()) {
+        storeItem(book);
+      } else if (policy == DuplicatePolicy::Upsert) {
+        // Keep the first displaced book: the indexes still describe it.
+        replaced.emplace(it->second, replaceBook(it->second, book));
+        status = ImportStatus::Updated;
+      } else {
+        countImport(result, ImportStatus::Duplicate);
+        continue;
+      }
+      countImport(result, status);
+      if (journal.isOpen()) {
+        journal.append(
+            bookRecord(status == ImportStatus::Added ? "AB" : "UB", *book),
+            true);
+        journaled = true;
+      }
+    }
+    reindexBooks(replaced);
+  }
+  if (journaled) {
+    result.committed = journal.sync();
+  }
+  return result;
+}
+
+// Adds a batch of users under one exclusive lock; see addBooks. Loans are
+// only ever made through borrowBook, so users that arrive carrying some
+// are rejected.
+ImportResult
+LibrarySystem::addUsers(const std::vector<std::shared_ptr<User>> &batch,
+                        DuplicatePolicy policy) {
+  OperationTimer timer(metrics, LibraryOperation::Import);
+  ImportResult result;
+  result.statuses.reserve(batch.size());
+  bool journaled = false;
+  {
+    std::unique_lock<CatalogMutex> lock(catalogMutex);
+    reserveForUsers(batch.size());
+    for (const auto &user : batch) {
+      if (!user || user->getIdView().empty() ||
+          !user->getBorrowedBooksView().empty()) {
+        countImport(result, ImportStatus::Invalid);
+        continue;
+      }
+      ImportStatus status = ImportStatus::Added;
+      auto it = userIndex.find(user->getId());
+      if (it == userIndex.end()) {
+        storeItem(user);
+      } else if (policy == DuplicatePolicy::Upsert) {
+        replaceUser(it->second, user);
+        status = ImportStatus::Updated;
+      } else {
+        countImport(result, ImportStatus::Duplicate);
+        continue;
+      }
+      countImport(result, status);
+      if (journal.isOpen()) {
+        journal.append(
+            userRecord(status == ImportStatus::Added ? "AU" : "UU", *user),
+            true);
+        journaled = true;
+      }
+    }
+  }
+  if (journaled) {
+    result.committed = journal.sync();
+  }
+  return result;
+}
+
+// Parses the file like loadItemsFromFile, then imports it as one batch.
+ImportResult LibrarySystem::importItemsFromFile(const std::string &filename,
+                                                bool isUserFile,
+                                                DuplicatePolicy policy) {
+  auto start = Metrics::Clock::now();
+  std::vector<std::shared_ptr<Book>> parsedBooks;
+  std::vector<std::shared_ptr<User>> parsedUsers;
+  size_t bytes = 0;
+  if (!parseItemsFile(filename, isUserFile, parsedBooks, parsedUsers, bytes)) {
+    return ImportResult();
+  }
+  ImportResult result = isUserFile ? addUsers(parsedUsers, policy)
+                                   : addBooks(parsedBooks, policy);
+  metrics.recordIo(IoKind::LoadFile, bytes, start);
+  return result;
 }
 
-// Loads items (books or users) from a file into the library system.
+// Runs parse(chunk, index) over every chunk, one thread per chunk, and
+// returns the results in chunk order.
+template <typename Result, typename Parse>
+static std::vector<Result>
+parseChunksInParallel(const std::vector<std::string_view> &chunks,
+                      Parse parse) {
+  std::vector<Result> results(chunks.size());
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < chunks.size(); ++i) {
+    workers.emplace_back(
+        [&results, &chunks, &parse, i]() { results[i] = parse(chunks[i], i); });
+  }
+  if (!chunks.empty()) {
+    results[0] = parse(chunks[0], 0); // The calling thread takes the first.
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  return results;
+}
+
+// Reports a malformed line with its line number in the file.
+static void reportParseErrors(const std::string &filename,
+                              const std::vector<CsvLoader::ParseError> &errors,
+                              size_t firstLine) {
+  for (const auto &error : errors) {
+    std::cerr << filename << ":" << firstLine + error.line + 1
+              << ": skipping malformed line (" << error.message << ")"
+              << std::endl;
+  }
+}
+
+// Maps a books or users file and parses it in newline-aligned chunks on all
+// cores, reporting malformed lines. In arena mode each chunk allocates from
+// an arena of its own, so the parsers never share a lock. Users get their
+// listed loans attached.
+bool LibrarySystem::parseItemsFile(
+    const std::string &filename, bool isUserFile,
+    std::vector<std::shared_ptr<Book>> &parsedBooks,
+    std::vector<std::shared_ptr<User>> &parsedUsers, size_t &bytes) {
+  MappedFile file;
+  if (!file.open(filename)) {
+    std::cerr << "Error opening file for reading: " << filename << std::endl;
+    return false;
+  }
+
+  auto data = file.view();
+  bytes = data.size();
+  auto chunks =
+      CsvLoader::splitChunks(data, CsvLoader::chunkCountFor(data.size()));
+
+  std::vector<std::unique_ptr<Arena>> chunkArenas;
+  std::vector<std::pmr::memory_resource *> resources;
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    if (storageMode == StorageMode::Arena) {
+      chunkArenas.push_back(std::make_unique<Arena>());
+      resources.push_back(chunkArenas.back().get());
+    } else {
+      resources.push_back(std::pmr::new_delete_resource());
+    }
+  }
+  if (!chunkArenas.empty()) {
+    // Owned by the library from now on, whatever becomes of the items.
+    std::unique_lock<CatalogMutex> lock(catalogMutex);
+    for (auto &arena : chunkArenas) {
+      arenas.push_back(std::move(arena));
+    }
+  }
+
+  size_t firstLine = 0;
+  if (isUserFile) {
+    auto parsed = parseChunksInParallel<CsvLoader::UserChunk>(
+        chunks, [&resources](std::string_view chunk, size_t i) {
+          return CsvLoader::parseUsers(chunk, resources[i]);
+        });
+    size_t total = 0;
+    for (const auto &chunk : parsed) {
+      total += chunk.users.size();
+    }
+    parsedUsers.reserve(parsedUsers.size() + total);
+
+    for (const auto &chunk : parsed) {
+      reportParseErrors(filename, chunk.errors, firstLine);
+      firstLine += chunk.lineCount;
+
+      size_t loan = 0;
+      for (size_t i = 0; i < chunk.users.size(); ++i) {
+        const auto &user = chunk.users[i];
+        // Restore borrowed books. Entries from files written before borrow
+        // dates were stored count from now, as they always did.
+        for (size_t n = 0; n < chunk.loanCounts[i]; ++n, ++loan) {
+          const auto &entry = chunk.loans[loan];
+          user->addBorrowedBook(std::string(entry.bookId),
+                                entry.hasDate
+                                    ? entry.borrowDate
+                                    : std::chrono::system_clock::now());
+        }
+        parsedUsers.push_back(user);
+      }
+    }
+  } else {
+    auto parsed = parseChunksInParallel<CsvLoader::BookChunk>(
+        chunks, [&resources](std::string_view chunk, size_t i) {
+          return CsvLoader::parseBooks(chunk, resources[i]);
+        });
+    size_t total = 0;
+    for (const auto &chunk : parsed) {
+      total += chunk.books.size();
+    }
+    parsedBooks.reserve(parsedBooks.size() + total);
+
+    for (const auto &chunk : parsed) {
+      reportParseErrors(filename, chunk.errors, firstLine);
+      firstLine += chunk.lineCount;
+      parsedBooks.insert(parsedBooks.end(), chunk.books.begin(),
+                         chunk.books.end());
+    }
+  }
+  return true;
+}
+
+// Loads items (books or users) from a file into the library system, adding
+// the parsed records in file order. Records whose ID is already taken, by an
+// earlier line or an item already in the library, are reported and skipped.
 void LibrarySystem::loadItemsFromFile(const std::string &filename,
                                       bool isUserFile) {
-  std::ifstream file(filename);
-  if (!file.is_open()) {
-    std::cerr << "Error opening file for reading: " << filename << std::endl;
+  auto start = Metrics::Clock::now();
+  std::vector<std::shared_ptr<Book>> parsedBooks;
+  std::vector<std::shared_ptr<User>> parsedUsers;
+  size_t bytes = 0;
+  if (!parseItemsFile(filename, isUserFile, parsedBooks, parsedUsers, bytes)) {
     return;
   }
 
-  std::string line;
-  while (std::getline(file, line)) {
-    std::istringstream iss(line);
+  size_t duplicates = 0;
+  {
+    std::unique_lock<CatalogMutex> lock(catalogMutex);
     if (isUserFile) {
-      // Read user information.
-      std::string id, name, email, phone;
-      std::getline(iss, id, ',');
-      std::getline(iss, name, ',');
-      std::getline(iss, email, ',');
-      std::getline(iss, phone, ',');
-
-      auto user = std::make_shared<User>(id, name, email, phone);
-
-      // Read borrowed books.
-      std::string borrowedBooksStr;
-      if (std::getline(iss, borrowedBooksStr, ',')) {
-        std::istringstream borrowedBooksStream(borrowedBooksStr);
-        std::string bookId;
-        while (std::getline(borrowedBooksStream, bookId, ';')) {
-          user->addBorrowedBook(bookId, *this); // Adds borrowed book.
-        }
+      reserveForUsers(parsedUsers.size());
+      for (const auto &user : parsedUsers) {
+        duplicates += !storeItem(user);
       }
-
-      addItem(user);
     } else {
-      // Read book information.
-      std::string id, title, author, category;
-      int year;
-      bool available;
-      std::getline(iss, id, ',');
-      std::getline(iss, title, ',');
-      std::getline(iss, author, ',');
-      std::getline(iss, category, ',');
-      iss >> year;
-      iss.ignore();
-      iss >> available;
-
-      auto book =
-          std::make_shared<Book>(id, title, author, category, year, available);
-      addItem(book);
+      reserveForBooks(parsedBooks.size());
+      for (const auto &book : parsedBooks) {
+        duplicates += !storeItem(book);
+      }
     }
   }
-  file.close();
+  if (duplicates > 0) {
+    std::cerr << filename << ": skipped " << duplicates
+              << " records with an ID that was already taken" << std::endl;
+  }
+  metrics.recordIo(IoKind::LoadFile, bytes, start);
 }
 
-// Saves items (books or users) from the library system to a file.
-void LibrarySystem::saveItemsToFile(const std::string &filename,
+// Saves items (books or users) from the library system to a file. Holding
+// the catalog exclusively gives a consistent cut: no borrow or return is
+// half applied while the file is written.
+bool LibrarySystem::saveItemsToFile(const std::string &filename,
                                     bool isUserFile) const {
+  std::unique_lock<CatalogMutex> lock(catalogMutex);
+  return writeItemsFile(filename, isUserFile);
+}
+
+// Writes one data file with catalogMutex held.
+bool LibrarySystem::writeItemsFile(const std::string &filename,
+                                   bool isUserFile) const {
+  auto start = Metrics::Clock::now();
   std::ofstream file(filename);
   if (!file.is_open()) {
     std::cerr << "Error opening file for writing: " << filename << std::endl;
-    return;
+    return false;
   }
 
-  for (const auto &item : items) {
-    if (isUserFile && std::dynamic_pointer_cast<User>(item)) {
-      auto user = std::dynamic_pointer_cast<User>(item);
-      file << user->getId() << "," << user->getName() << "," << user->getEmail()
-           << "," << user->getPhone() << ",";
+  if (isUserFile) {
+    for (const auto &user : users) {
+      file << user->getIdView() << "," << user->getNameView() << ","
+           << user->getEmailView() << "," << user->getPhoneView() << ",";
 
-      // Save borrowed books.
-      const auto &borrowedBooks = user->getBorrowedBooks();
+      // Save borrowed books as bookId@borrowDate. The exclusive catalog
+      // lock keeps the list still.
+      const auto &borrowedBooks = user->getBorrowedBooksView();
       for (size_t i = 0; i < borrowedBooks.size(); ++i) {
-        file << borrowedBooks[i];
+        file << borrowedBooks[i] << "@"
+             << toEpochSeconds(user->getBorrowDate(borrowedBooks[i]));
         if (i < borrowedBooks.size() - 1) {
           file << ";"; // Separator between borrowed books.
         }
       }
       file << "\n";
-    } else if (!isUserFile && std::dynamic_pointer_cast<Book>(item)) {
-      auto book = std::dynamic_pointer_cast<Book>(item);
-      file << book->getId() << "," << book->getTitle() << ","
-           << book->getAuthor() << "," << book->getCategory() << ","
-           << book->getYear() << "," << book->isAvailable() << "\n";
+    }
+  } else {
+    for (const auto &book : books) {
+      file << book->getIdView() << "," << book->getTitleView() << ","
+           << book->getAuthorView() << "," << book->getCategoryView() << ","
+           << book->getYear() << "," << book->isAvailable() << ","
+           << book->getBorrowCount() << "\n";
     }
   }
+  auto bytes = file.tellp();
   file.close();
+  if (file.fail()) {
+    return false;
+  }
+  metrics.recordIo(IoKind::SaveFile, static_cast<uint64_t>(bytes), start);
+  return true;
+}
+
+// Saves all books, users and loans to a binary snapshot file.
+bool LibrarySystem::saveSnapshot(const std::string &filename) const {
+  auto start = Metrics::Clock::now();
+  std::unique_lock<CatalogMutex> lock(catalogMutex);
+  if (!Snapshot::write(filename, books, users)) {
+    return false;
+  }
+  metrics.recordIo(IoKind::SaveSnapshot, fileSize(filename), start);
+  return true;
 }
 
-// Prints details of library items based on the flag.
+// Loads a binary snapshot. The whole file is validated before anything is
+// added, so a bad snapshot leaves the library untouched.
+bool LibrarySystem::loadSnapshot(const std::string &filename) {
+  auto start = Metrics::Clock::now();
+  SnapshotView snapshot;
+  std::string error;
+  if (!snapshot.open(filename, error)) {
+    std::cerr << "Error loading snapshot " << filename << ": " << error
+              << std::endl;
+    return false;
+  }
+  for (size_t i = 0; i < snapshot.userCount(); ++i) {
+    const auto &record = snapshot.user(i);
+    if (static_cast<uint64_t>(record.firstLoan) + record.loanCount >
+        snapshot.loanCount()) {
+      std::cerr << "Error loading snapshot " << filename
+                << ": loan range out of bounds" << std::endl;
+      return false;
+    }
+  }
+
+  auto text = [&snapshot](SnapshotString ref) {
+    return snapshot.string(ref);
+  };
+
+  std::unique_lock<CatalogMutex> lock(catalogMutex);
+  reserveForBooks(snapshot.bookCount());
+  for (size_t i = 0; i < snapshot.bookCount(); ++i) {
+    const auto &record = snapshot.book(i);
+    auto book = createBook(text(record.id), text(record.title),
+                           text(record.author), text(record.category),
+                           record.year, record.available != 0);
+    book->setBorrowCount(record.borrowCount);
+    storeItem(book);
+  }
+
+  reserveForUsers(snapshot.userCount());
+  for (size_t i = 0; i < snapshot.userCount(); ++i) {
+    const auto &record = snapshot.user(i);
+    auto user = createUser(text(record.id), text(record.name),
+                           text(record.email), text(record.phone));
+
+    // Restore loans and their dates without touching borrow counts.
+    for (uint32_t n = 0; n < record.loanCount; ++n) {
+      const auto &loan = snapshot.loan(record.firstLoan + n);
+      user->addBorrowedBook(std::string(text(loan.bookId)),
+                            std::chrono::system_clock::time_point(
+                                std::chrono::seconds(loan.borrowedAt)));
+    }
+    storeItem(user);
+  }
+  metrics.recordIo(IoKind::LoadSnapshot, fileSize(filename), start);
+  return true;
+}
+
+// Replays the journal on top of the loaded files and reopens it for appends.
+bool LibrarySystem::openJournal(const std::string &filename) {
+  std::unique_lock<CatalogMutex> lock(catalogMutex);
+  journal.close();
+  Journal::replay(filename, [this](const std::vector<std::string> &fields) {
+    replayRecord(fields);
+  });
+  return journal.open(filename);
+}
+
+// Applies one journal record. Adds of an ID that already exists are
+// skipped, but borrows and returns are not idempotent: replaying them on
+// files that already include them would count every loan twice. The
+// compaction marker makes sure a folded journal is emptied before it can
+// be replayed.
+void LibrarySystem::replayRecord(const std::vector<std::string> &fields) {
+  if (fields.empty()) {
+    return;
+  }
+  try {
+    if (fields[0] == "B" && fields.size() >= 4) {
+      applyBorrow(fields[1], fields[2], fromEpochSeconds(fields[3]));
+    } else if (fields[0] == "R" && fields.size() >= 3) {
+      applyReturn(fields[1], fields[2]);
+    } else if (fields[0] == "D" && fields.size() >= 4) {
+      applyBorrowDate(fields[1], fields[2], fromEpochSeconds(fields[3]));
+    } else if (fields[0] == "AB" && fields.size() >= 7) {
+      if (!lookupBook(fields[1])) {
+        storeItem(createBook(fields[1], fields[2], fields[3], fields[4],
+                             std::stoi(fields[5]), fields[6] == "1"));
+      }
+    } else if (fields[0] == "AU" && fields.size() >= 5) {
+      if (!lookupUser(fields[1])) {
+        storeItem(createUser(fields[1], fields[2], fields[3], fields[4]));
+      }
+    } else if (fields[0] == "UB" && fields.size() >= 7) {
+      auto it = bookIndex.find(fields[1]);
+      if (it != bookIndex.end()) {
+        auto old = replaceBook(
+            it->second, createBook(fields[1], fields[2], fields[3], fields[4],
+                                   std::stoi(fields[5]), fields[6] == "1"));
+        reindexBooks({{it->second, old}});
+      }
+    } else if (fields[0] == "UU" && fields.size() >= 5) {
+      auto it = userIndex.find(fields[1]);
+      if (it != userIndex.end()) {
+        replaceUser(it->second,
+                    createUser(fields[1], fields[2], fields[3], fields[4]));
+      }
+    } else {
+      std::cerr << "Error: Unknown journal record " << fields[0] << std::endl;
+    }
+  } catch (const std::exception &) {
+    std::cerr << "Error: Malformed journal record " << fields[0] << std::endl;
+  }
+}
+
+// Writes fresh books / users files and empties the journal. The new files
+// are synced under temporary names, then a marker is made durable: from
+// that point they are the database and recoverCompaction finishes the
+// cut after a crash. Without the marker the old files plus the journal
+// stay authoritative. Refuses once a journal commit has failed.
+bool LibrarySystem::compactJournal(const std::string &booksFile,
+                                   const std::string &usersFile) {
+  // Exclusive, so no change can reach the journal between the snapshot and
+  // the marker's removal.
+  std::unique_lock<CatalogMutex> lock(catalogMutex);
+  if (journal.hasFailed()) {
+    // Memory holds changes that were reported as failed; keep them out.
+    std::cerr << "Error: not compacting after a failed journal commit."
+              << std::endl;
+    return false;
+  }
+
+  const std::string booksTmp = booksFile + ".tmp";
+  const std::string usersTmp = usersFile + ".tmp";
+  const std::string marker = compactionMarker(booksFile);
+  if (!writeItemsFile(booksTmp, false) || !writeItemsFile(usersTmp, true)) {
+    return false;
+  }
+  if (!syncFile(booksTmp) || !syncFile(usersTmp) ||
+      !syncDirectory(booksTmp) || !syncDirectory(usersTmp) ||
+      !writeMarker(marker)) {
+    std::cerr << "Error syncing compacted database files." << std::endl;
+    return false;
+  }
+  if (!installCompactedFiles(booksFile, usersFile)) {
+    std::cerr << "Error replacing database files." << std::endl;
+    return false;
+  }
+  if (journal.isOpen() && !journal.truncate()) {
+    return false;
+  }
+  if (!removeMarker(marker)) {
+    std::cerr << "Error removing compaction marker: " << marker << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// Completes or discards a compaction a crash interrupted. With the marker
+// present the temporary files are moved into place and the journal, which
+// they already include, is emptied; without it they are incomplete and
+// removed.
+bool LibrarySystem::recoverCompaction(const std::string &booksFile,
+                                      const std::string &usersFile,
+                                      const std::string &journalFile) {
+  const std::string marker = compactionMarker(booksFile);
+  std::error_code ec;
+  if (!std::filesystem::exists(marker, ec)) {
+    std::remove((booksFile + ".tmp").c_str());
+    std::remove((usersFile + ".tmp").c_str());
+    return true;
+  }
+  if (!installCompactedFiles(booksFile, usersFile)) {
+    std::cerr << "Error replacing database files." << std::endl;
+    return false;
+  }
+  if (std::filesystem::exists(journalFile, ec) &&
+      (::truncate(journalFile.c_str(), 0) != 0 || !syncFile(journalFile))) {
+    std::cerr << "Error emptying journal: " << journalFile << std::endl;
+    return false;
+  }
+  if (!removeMarker(marker)) {
+    std::cerr << "Error removing compaction marker: " << marker << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// Selects how journal records are committed.
+void LibrarySystem::setDurability(const DurabilityOptions &options) {
+  journal.setDurability(options);
+}
+
+// Returns how journal records are committed.
+DurabilityOptions LibrarySystem::getDurability() const {
+  return journal.getDurability();
+}
+
+// Commits every pending journal record right away.
+bool LibrarySystem::syncJournal() { return journal.sync(); }
+
+// Returns true once a journal commit has failed.
+bool LibrarySystem::hasJournalFailed() const { return journal.hasFailed(); }
+
+// Blocks until every journal record appended so far has been committed.
+bool LibrarySystem::waitForJournal() { return journal.waitForAll(); }
+
+// Returns journal batch size and commit latency counters.
+JournalStats LibrarySystem::getJournalStats() const {
+  return journal.getStats();
+}
+
+// Collects operation, I/O, lock and journal counters.
+LibraryMetrics LibrarySystem::getMetrics() const {
+  LibraryMetrics result;
+  metrics.collect(result);
+  auto contention = getLockContention();
+  result.locks = {{"catalog", contention.catalog},
+                  {"user-stripes", contention.userStripes},
+                  {"loans", contention.loans},
+                  {"ranking", contention.ranking}};
+  result.journal = journal.getStats();
+
+  std::shared_lock<CatalogMutex> lock(catalogMutex);
+  result.books = books.size();
+  result.users = users.size();
+  std::lock_guard<Mutex> loans(loanMutex);
+  result.openLoans = loanIndex.size();
+  return result;
+}
+
+// Writes the metrics in Prometheus text format. The file is written next to
+// its target and renamed over it, so a scraper never reads half a file.
+bool LibrarySystem::writeMetricsFile(const std::string &filename) const {
+  const std::string tmp = filename + ".tmp";
+  std::ofstream file(tmp);
+  if (!file.is_open()) {
+    std::cerr << "Error opening file for writing: " << tmp << std::endl;
+    return false;
+  }
+  getMetrics().writePrometheus(file);
+  file.close();
+  if (file.fail() || std::rename(tmp.c_str(), filename.c_str()) != 0) {
+    std::cerr << "Error writing metrics file: " << filename << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// Returns the time threads have spent waiting on each library lock.
+LibraryLockContention LibrarySystem::getLockContention() const {
+  LibraryLockContention result;
+  result.catalog = catalogMutex.getContention();
+  for (const auto &stripe : userStripes) {
+    result.userStripes += stripe.getContention();
+  }
+  result.loans = loanMutex.getContention();
+  result.ranking = rankingMutex.getContention();
+  return result;
+}
+
+// Prints library items as a table: users for flag 0, books for flag 1.
 void LibrarySystem::printLibraryItems(int flag) const {
-  for (const auto &item : items) {
-    if (flag == 0) {
-      std::shared_ptr<User> user = std::dynamic_pointer_cast<User>(item);
-      if (user) {
-        // Print user information.
-        std::cout << "User ID: " << user->getId()
-                  << ", Name: " << user->getName()
-                  << ", Email: " << user->getEmail()
-                  << ", Phone: " << user->getPhone() << ", Borrowed Books: ";
-        for (const auto &bookId : user->getBorrowedBooks()) {
-          std::cout << bookId << " ";
+  if (flag == 0 || flag == 1) {
+    exportListing(flag == 0 ? Listing::Users : Listing::Books, 0, std::cout,
+                  OutputFormat::Table);
+  }
+}
+
+// Returns the columns of the records listing writes.
+std::vector<RecordColumn> LibrarySystem::listingColumns(Listing listing) {
+  switch (listing) {
+  case Listing::Books:
+    return {{"id", 8},
+            {"title", 30},
+            {"author", 20},
+            {"category", 16},
+            {"year", 4},
+            {"available", 9},
+            {"borrow_count", 0}};
+  case Listing::Users:
+    return {{"id", 8},
+            {"name", 20},
+            {"email", 28},
+            {"phone", 12},
+            {"borrowed_books", 0}};
+  case Listing::MostBorrowed:
+    return {{"rank", 4},
+            {"id", 8},
+            {"title", 30},
+            {"author", 20},
+            {"borrow_count", 0}};
+  case Listing::Overdue:
+    return {{"book_id", 8},
+            {"title", 30},
+            {"author", 20},
+            {"user_id", 8},
+            {"borrowed", 0}};
+  case Listing::DueSoon:
+    return {{"book_id", 8},
+            {"title", 30},
+            {"author", 20},
+            {"user_id", 8},
+            {"due", 0}};
+  }
+  return {};
+}
+
+// Formats a time as a UTC calendar date, YYYY-MM-DD.
+static std::string calendarDate(std::chrono::system_clock::time_point time) {
+  std::time_t seconds = std::chrono::system_clock::to_time_t(time);
+  std::tm parts{};
+  gmtime_r(&seconds, &parts);
+  char text[16];
+  std::strftime(text, sizeof(text), "%Y-%m-%d", &parts);
+  return text;
+}
+
+// Writes one page of listing. Books and users resume at a catalog slot and
+// the most-borrowed report at a rank. The loan reports resume at a borrow
+// date, skipping the loans at that date already written, so a page costs
+// the same however deep into the listing it is.
+ListCursor LibrarySystem::writeListingPage(Listing listing, int parameter,
+                                           const ListCursor &cursor,
+                                           size_t limit,
+                                           RecordWriter &writer) const {
+  ListCursor next = cursor;
+  next.started = true;
+  if (cursor.done || limit == 0) {
+    return next;
+  }
+  std::shared_lock<CatalogMutex> lock(catalogMutex);
+  size_t written = 0;
+
+  switch (listing) {
+  case Listing::Books: {
+    auto slot = static_cast<size_t>(cursor.key);
+    for (; slot < books.size() && written < limit; ++slot, ++written) {
+      const auto &book = *books[slot];
+      writer.text(book.getIdView());
+      writer.text(book.getTitleView());
+      writer.text(book.getAuthorView());
+      writer.text(book.getCategoryView());
+      writer.number(book.getYear());
+      writer.flag(book.isAvailable());
+      writer.number(book.getBorrowCount());
+      writer.endRecord();
+    }
+    next.key = static_cast<int64_t>(slot);
+    next.done = slot >= books.size();
+    break;
+  }
+  case Listing::Users: {
+    auto slot = static_cast<size_t>(cursor.key);
+    std::string borrowed;
+    for (; slot < users.size() && written < limit; ++slot, ++written) {
+      const auto &user = *users[slot];
+      borrowed.clear();
+      {
+        std::lock_guard<Mutex> stripe(stripeOf(slot));
+        for (const auto &bookId : user.getBorrowedBooksView()) {
+          if (!borrowed.empty()) {
+            borrowed += ';';
+          }
+          borrowed += bookId;
         }
-        std::cout << "\n";
       }
-    } else if (flag == 1) {
-      std::shared_ptr<Book> book = std::dynamic_pointer_cast<Book>(item);
-      if (book) {
-        // Print book information.
-        std::cout << "Book ID: " << book->getId()
-                  << ", Title: " << book->getTitle()
-                  << ", Author: " << book->getAuthor()
-                  << ", Category: " << book->getCategory()
-                  << ", Year: " << book->getYear()
-                  << ", Available: " << (book->isAvailable() ? "Yes" : "No")
-                  << "\n";
+      writer.text(user.getIdView());
+      writer.text(user.getNameView());
+      writer.text(user.getEmailView());
+      writer.text(user.getPhoneView());
+      writer.text(borrowed);
+      writer.endRecord();
+    }
+    next.key = static_cast<int64_t>(slot);
+    next.done = slot >= users.size();
+    break;
+  }
+  case Listing::MostBorrowed: {
+    OperationTimer timer(metrics, LibraryOperation::MostBorrowed);
+    auto rank = static_cast<size_t>(cursor.key);
+    size_t end = std::min(static_cast<size_t>(std::max(parameter, 0)),
+                          rank + limit);
+    size_t seen = 0;
+    std::lock_guard<Mutex> ranking(rankingMutex);
+    popularity.forEachTop(end, [&](uint32_t doc) {
+      if (seen++ < rank) {
+        return;
       }
+      const auto &book = *books[doc];
+      writer.number(static_cast<int64_t>(seen));
+      writer.text(book.getIdView());
+      writer.text(book.getTitleView());
+      writer.text(book.getAuthorView());
+      writer.number(book.getBorrowCount());
+      writer.endRecord();
+    });
+    next.key = static_cast<int64_t>(seen);
+    next.done = seen < end || seen >= static_cast<size_t>(parameter);
+    break;
+  }
+  case Listing::Overdue:
+  case Listing::DueSoon: {
+    bool overdue = listing == Listing::Overdue;
+    OperationTimer timer(metrics, overdue ? LibraryOperation::Overdue
+                                          : LibraryOperation::DueSoon);
+    using std::chrono::system_clock;
+    auto period = std::chrono::hours(24) * loanPeriodDays.load();
+    auto now = system_clock::now();
+    // Same windows as getOverdueBooks and getBooksDueWithin.
+    const auto day = std::chrono::hours(24);
+    system_clock::time_point from = system_clock::time_point::min();
+    system_clock::time_point to = now - period + day * parameter;
+    if (overdue) {
+      to = now - day * (static_cast<long long>(parameter) + 1);
+    } else {
+      from = now - period;
     }
+    size_t skip = 0;
+    if (cursor.started) {
+      from = system_clock::time_point(system_clock::duration(cursor.key));
+      skip = cursor.offset;
+    }
+
+    next.done = true;
+    std::lock_guard<Mutex> loans(loanMutex);
+    loanIndex.forEachBorrowedFrom(
+        from, skip, to,
+        [&](LoanIndex::TimePoint date, const LoanIndex::Loan &loan) {
+          if (written == limit) {
+            next.done = false;
+            return false;
+          }
+          // Track the resume point: the date, and how many loans at it
+          // have been written, counting those skipped on this page.
+          if (date.time_since_epoch().count() != next.key) {
+            next.key = date.time_since_epoch().count();
+            next.offset = 0;
+          }
+          ++next.offset;
+          ++written;
+          auto book = lookupBook(loan.bookId);
+          writer.text(loan.bookId);
+          writer.text(book ? book->getTitleView() : std::string_view());
+          writer.text(book ? book->getAuthorView() : std::string_view());
+          writer.text(loan.userId);
+          writer.text(calendarDate(overdue ? date : date + period));
+          writer.endRecord();
+          return true;
+        });
+    break;
+  }
+  }
+  return next;
+}
+
+// Writes every page of listing to out, releasing the lock between pages so
+// a long export never holds off adds and loads for long.
+bool LibrarySystem::exportListing(Listing listing, int parameter,
+                                  std::ostream &out,
+                                  OutputFormat format) const {
+  const size_t pageRecords = 4096;
+  RecordWriter writer(out, format, listingColumns(listing));
+  ListCursor cursor;
+  while (!cursor.done) {
+    cursor = writeListingPage(listing, parameter, cursor, pageRecords, writer);
   }
+  return writer.flush();
 }
 
 // Handles borrowing a book for a user.
 bool LibrarySystem::borrowBook(const std::string &userId,
-                               const std::string &bookId) {
-  std::lock_guard<std::mutex> lock(libraryMutex);
+                               const std::string &bookId, bool waitForCommit) {
+  OperationTimer timer(metrics, LibraryOperation::Borrow);
+  uint64_t seq = 0;
+  {
+    std::shared_lock<CatalogMutex> lock(catalogMutex);
+    if (journal.hasFailed() ||
+        !applyBorrow(userId, bookId, std::chrono::system_clock::now(),
+                     &seq)) {
+      timer.fail();
+      return false;
+    }
+  }
+  if (journal.hasFailed()) {
+    timer.fail(); // This change's record will never be committed.
+    return false;
+  }
 
-  auto user = findUserById(userId);
-  auto book = findBookById(bookId);
+  // Wait outside the locks so other operations can join the same batch.
+  if (waitForCommit && seq != 0 && !journal.waitForCommit(seq)) {
+    timer.fail();
+    return false;
+  }
+  return true;
+}
 
-  if (user && book && book->isAvailable()) {
-    user->addBorrowedBook(bookId, *this);
-    book->setAvailable(false);
-    saveItemsToFile("./database/books.txt", false); // Update book file.
-    saveItemsToFile("./database/users.txt", true);  // Update user file.
-    return true;
+// Records a borrow. The book is claimed with a compare-and-swap on its
+// availability flag, so of several concurrent borrowers exactly one wins.
+bool LibrarySystem::applyBorrow(
+    const std::string &userId, const std::string &bookId,
+    std::chrono::system_clock::time_point borrowDate, uint64_t *journalSeq) {
+  size_t userSlot;
+  auto user = lookupUser(userId, &userSlot);
+  auto bookSlot = bookIndex.find(bookId);
+  if (!user || bookSlot == bookIndex.end()) {
+    return false;
   }
-  return false;
+
+  const auto &book = books[bookSlot->second];
+  auto doc = static_cast<uint32_t>(bookSlot->second);
+  if (!book->tryCheckOut()) {
+    return false;
+  }
+  // Before the loan is visible, so no return can flip the bit back first.
+  attributeIndex.setAvailable(doc, false);
+  {
+    std::lock_guard<Mutex> stripe(stripeOf(userSlot));
+    user->addBorrowedBook(bookId, borrowDate);
+    // Under the stripe, as in applyReturn, so a return of this loan cannot
+    // remove it from the loan index before it is added.
+    {
+      std::lock_guard<Mutex> loans(loanMutex);
+      loanIndex.add(userId, bookId, borrowDate);
+    }
+    if (journalSeq) {
+      *journalSeq =
+          journal.append({"B", userId, bookId, toEpochSeconds(borrowDate)});
+    }
+  }
+
+  book->incrementBorrowCount();
+  {
+    std::lock_guard<Mutex> ranking(rankingMutex);
+    popularity.update(doc, book->getBorrowCount());
+    titleCompletions.borrowed(doc);
+    authorCompletions.borrowed(doc);
+  }
+  return true;
 }
 
 // Handles returning a book from a user.
 bool LibrarySystem::returnBook(const std::string &userId,
-                               const std::string &bookId) {
-  std::lock_guard<std::mutex> lock(libraryMutex);
+                               const std::string &bookId, bool waitForCommit) {
+  OperationTimer timer(metrics, LibraryOperation::Return);
+  uint64_t seq = 0;
+  {
+    std::shared_lock<CatalogMutex> lock(catalogMutex);
+    if (journal.hasFailed() || !applyReturn(userId, bookId, &seq)) {
+      timer.fail();
+      return false;
+    }
+  }
+  if (journal.hasFailed()) {
+    timer.fail(); // This change's record will never be committed.
+    return false;
+  }
 
-  auto user = findUserById(userId);
-  auto book = findBookById(bookId);
+  // Wait outside the locks so other operations can join the same batch.
+  if (waitForCommit && seq != 0 && !journal.waitForCommit(seq)) {
+    timer.fail();
+    return false;
+  }
+  return true;
+}
+
+// Records a return. The book only becomes available again once the loan is
+// gone from every structure, so the next borrower starts from a clean state.
+bool LibrarySystem::applyReturn(const std::string &userId,
+                                const std::string &bookId,
+                                uint64_t *journalSeq) {
+  size_t userSlot;
+  auto user = lookupUser(userId, &userSlot);
+  auto bookSlot = bookIndex.find(bookId);
+  auto book = bookSlot != bookIndex.end() ? books[bookSlot->second] : nullptr;
 
-  if (!user || !book) {
-    // If user or book not found, return false.
+  if (!user || !book || book->isAvailable()) {
+    // If user or book not found, or the book is not out, return false.
     return false;
   }
 
-  if (!book->isAvailable() && user->hasBorrowedBook(bookId)) {
+  {
+    std::lock_guard<Mutex> stripe(stripeOf(userSlot));
+    if (!user->hasBorrowedBook(bookId)) {
+      // The user does not have the book.
+      return false;
+    }
     user->removeBorrowedBook(bookId);
-    book->setAvailable(true);
-    saveItemsToFile("./database/books.txt", false); // Update book file.
-    saveItemsToFile("./database/users.txt", true);  // Update user file.
-    return true;
+    if (journalSeq) {
+      *journalSeq = journal.append({"R", userId, bookId});
+    }
   }
-
-  // If book was not borrowed or user does not have it, return false.
-  return false;
+  {
+    std::lock_guard<Mutex> loans(loanMutex);
+    loanIndex.remove(userId, bookId);
+  }
+  // Before the book can be checked out again, so the next borrow's clear
+  // lands after this set.
+  attributeIndex.setAvailable(static_cast<uint32_t>(bookSlot->second), true);
+  book->setAvailable(true);
+  return true;
 }
 
 // Finds a user by their ID.
 std::shared_ptr<User>
 LibrarySystem::findUserById(const std::string &userId) const {
-  for (const auto &item : items) {
-    if (auto user = std::dynamic_pointer_cast<User>(item)) {
-      if (user->getId() == userId) {
-        return user;
-      }
-    }
-  }
-  return nullptr;
+  std::shared_lock<CatalogMutex> lock(catalogMutex);
+  return lookupUser(userId);
 }
 
 // Finds a book by its ID.
 std::shared_ptr<Book>
 LibrarySystem::findBookById(const std::string &bookId) const {
-  for (const auto &item : items) {
-    if (auto book = std::dynamic_pointer_cast<Book>(item)) {
-      if (book->getId() == bookId) {
-        return book;
-      }
-    }
+  std::shared_lock<CatalogMutex> lock(catalogMutex);
+  return lookupBook(bookId);
+}
+
+// Finds a user by ID with catalogMutex held, optionally reporting its slot.
+std::shared_ptr<User> LibrarySystem::lookupUser(const std::string &userId,
+                                                size_t *slot) const {
+  auto it = userIndex.find(userId);
+  if (it == userIndex.end()) {
+    return nullptr;
+  }
+  if (slot) {
+    *slot = it->second;
+  }
+  return users[it->second];
+}
+
+// Finds a book by ID with catalogMutex held.
+std::shared_ptr<Book>
+LibrarySystem::lookupBook(const std::string &bookId) const {
+  auto it = bookIndex.find(bookId);
+  if (it != bookIndex.end()) {
+    return books[it->second];
   }
   return nullptr;
 }
 
+// Returns the stripe guarding the loans of the user at slot.
+LibrarySystem::Mutex &LibrarySystem::stripeOf(size_t userSlot) const {
+  return userStripes[userSlot % userStripes.size()];
+}
+
+// Stores in key what to look up in a trigram index for a search of query.
+// The indexes hold the books' folded search keys, and folding works one
+// character at a time, so any text containing query has a key containing
+// its key. That needs query to be whole UTF-8 characters when it is matched
+// exactly, since a fragment could sit inside a character folding changed.
+// Returns false if the index cannot answer the search and the books must be
+// scanned: the key is shorter than a trigram, or query is such a fragment.
+static bool trigramKey(std::string_view query, SearchMode mode,
+                       std::string &key) {
+  foldText(query, key);
+  return key.size() >= TrigramIndex::gramLength &&
+         (mode == SearchMode::Normalized || isWholeUtf8(query));
+}
+
 // Searches for books based on the query and type (title, author, or category).
+// Queries with a trigram key are answered from the trigram index of the
+// field and confirmed against the text, or its search key in normalized
+// mode; others scan every book. Either way results come in catalog order,
+// matching a plain scan.
 std::vector<std::shared_ptr<Book>>
-LibrarySystem::searchBooks(const std::string &query,
-                           const std::string &type) const {
+LibrarySystem::searchBooks(const std::string &query, const std::string &type,
+                           SearchMode mode) const {
+  OperationTimer timer(metrics, LibraryOperation::Search);
+  std::shared_lock<CatalogMutex> lock(catalogMutex);
+
+  const TrigramIndex *index;
+  std::string_view (Book::*field)() const;
+  std::string_view (Book::*foldedField)() const;
+  if (type == "title") {
+    index = &titleIndex;
+    field = &Book::getTitleView;
+    foldedField = &Book::getFoldedTitleView;
+  } else if (type == "author") {
+    index = &authorIndex;
+    field = &Book::getAuthorView;
+    foldedField = &Book::getFoldedAuthorView;
+  } else if (type == "category") {
+    index = &categoryIndex;
+    field = &Book::getCategoryView;
+    foldedField = &Book::getFoldedCategoryView;
+  } else {
+    timer.fail();
+    return {};
+  }
+
+  std::string key;
+  bool indexed = trigramKey(query, mode, key);
+  std::string_view needle = query;
+  if (mode == SearchMode::Normalized) {
+    needle = key;
+    field = foldedField;
+  }
+
   std::vector<std::shared_ptr<Book>> results;
-  for (const auto &item : items) {
-    if (auto book = std::dynamic_pointer_cast<Book>(item)) {
-      if ((type == "title" &&
-           book->getTitle().find(query) != std::string::npos) ||
-          (type == "author" &&
-           book->getAuthor().find(query) != std::string::npos) ||
-          (type == "category" &&
-           book->getCategory().find(query) != std::string::npos)) {
+  if (!indexed) {
+    for (const auto &book : books) {
+      if (((*book).*field)().find(needle) != std::string_view::npos) {
         results.push_back(book);
       }
     }
+    return results;
+  }
+
+  std::vector<uint32_t> candidates;
+  index->candidates(key, candidates);
+  for (uint32_t doc : candidates) {
+    const auto &book = books[doc];
+    if (((*book).*field)().find(needle) != std::string_view::npos) {
+      results.push_back(book);
+    }
   }
   return results;
 }
 
-// Returns the top N most borrowed books.
+// Runs the fuzzy index of the field and maps its matches to books.
+std::vector<FuzzyMatch>
+LibrarySystem::fuzzySearchBooks(const std::string &query,
+                                const std::string &type, size_t k,
+                                int maxEdits) const {
+  OperationTimer timer(metrics, LibraryOperation::FuzzySearch);
+  const FuzzyIndex *index;
+  if (type == "title") {
+    index = &titleFuzzyIndex;
+  } else if (type == "author") {
+    index = &authorFuzzyIndex;
+  } else {
+    timer.fail();
+    return {};
+  }
+  std::shared_lock<CatalogMutex> lock(catalogMutex);
+  std::vector<FuzzyIndex::Match> matches;
+  if (!index->search(query, maxEdits, k, matches)) {
+    timer.fail();
+    return {};
+  }
+  std::vector<FuzzyMatch> results;
+  results.reserve(matches.size());
+  for (const auto &match : matches) {
+    results.push_back({books[match.doc], match.distance});
+  }
+  return results;
+}
+
+// Folds the prefix and runs the completion index of the field.
+std::vector<BookCompletion>
+LibrarySystem::completeBooks(const std::string &prefix,
+                             const std::string &type, size_t k) const {
+  OperationTimer timer(metrics, LibraryOperation::Complete);
+  CompletionIndex *index;
+  if (type == "title") {
+    index = &titleCompletions;
+  } else if (type == "author") {
+    index = &authorCompletions;
+  } else {
+    timer.fail();
+    return {};
+  }
+  std::string key = foldText(prefix);
+  std::shared_lock<CatalogMutex> lock(catalogMutex);
+  std::lock_guard<Mutex> ranking(rankingMutex);
+  std::vector<CompletionIndex::Match> matches;
+  if (!index->complete(key, k, matches)) {
+    timer.fail();
+    return {};
+  }
+  std::vector<BookCompletion> results;
+  results.reserve(matches.size());
+  for (const auto &match : matches) {
+    results.push_back(
+        {std::string(match.text), match.popularity, match.books});
+  }
+  return results;
+}
+
+// Finds the matching books through the attribute index.
 std::vector<std::shared_ptr<Book>>
-LibrarySystem::getMostBorrowedBooks(int topN) const {
-  std::unordered_map<std::string, int> borrowCount;
-  for (const auto &item : items) {
-    if (auto user = std::dynamic_pointer_cast<User>(item)) {
-      for (const auto &bookId : user->getBorrowedBooks()) {
-        borrowCount[bookId]++;
+LibrarySystem::findBooks(const BookFilter &filter) const {
+  OperationTimer timer(metrics, LibraryOperation::Find);
+  std::shared_lock<CatalogMutex> lock(catalogMutex);
+  std::vector<uint32_t> docs;
+  attributeIndex.find(filter, docs);
+  std::vector<std::shared_ptr<Book>> results;
+  results.reserve(docs.size());
+  for (uint32_t doc : docs) {
+    results.push_back(books[doc]);
+  }
+  return results;
+}
+
+// Counts the matching books through the attribute index.
+size_t LibrarySystem::countBooks(const BookFilter &filter) const {
+  OperationTimer timer(metrics, LibraryOperation::Find);
+  std::shared_lock<CatalogMutex> lock(catalogMutex);
+  return attributeIndex.count(filter);
+}
+
+// Returns the books per category.
+std::vector<CategoryCount> LibrarySystem::getCategoryCounts() const {
+  std::shared_lock<CatalogMutex> lock(catalogMutex);
+  return attributeIndex.categoryCounts();
+}
+
+// Returns the books per decade.
+std::vector<DecadeCount> LibrarySystem::getDecadeCounts() const {
+  std::shared_lock<CatalogMutex> lock(catalogMutex);
+  return attributeIndex.decadeCounts();
+}
+
+// Estimates every predicate and picks the access path with the fewest
+// expected candidates. A trigram estimate is the length of the shortest
+// posting list of the predicate's text; an attribute estimate is exact.
+// The attribute indexes walk the smallest set among their predicates, so
+// they win ties, since their candidates need no text check to be right.
+// The chosen index is then weighed against a scan, which a small limit
+// can cut short.
+QueryPlan LibrarySystem::planLocked(const BookQuery &query) const {
+  QueryPlan plan;
+  plan.books = books.size();
+  plan.indexes.resize(query.predicates.size());
+  plan.estimates.assign(query.predicates.size(), plan.books);
+  plan.access = QueryAccess::Scan;
+  plan.estimatedCandidates = plan.books;
+
+  BookFilter filter;
+  bool possible = query.toFilter(filter);
+  bool attributes = false;
+  size_t attributeEstimate = plan.books;
+  for (size_t i = 0; i < query.predicates.size(); ++i) {
+    const auto &predicate = query.predicates[i];
+    size_t &estimate = plan.estimates[i];
+    if (predicate.op == QueryOp::Contains) {
+      std::string key;
+      if (!trigramKey(predicate.text, SearchMode::Exact, key)) {
+        continue; // The trigram index cannot answer it.
+      }
+      static const std::string_view names[] = {
+          "title trigrams", "author trigrams", "category trigrams"};
+      static const QueryAccess accesses[] = {QueryAccess::TitleIndex,
+                                             QueryAccess::AuthorIndex,
+                                             QueryAccess::CategoryIndex};
+      const TrigramIndex *indexes[] = {&titleIndex, &authorIndex,
+                                       &categoryIndex};
+      auto field = static_cast<size_t>(predicate.field);
+      plan.indexes[i] = names[field];
+      estimate = indexes[field]->estimate(key);
+      if (estimate < plan.estimatedCandidates) {
+        plan.access = accesses[field];
+        plan.driver = i;
+        plan.estimatedCandidates = estimate;
       }
+    } else {
+      static const std::string_view names[] = {
+          "", "", "category index", "year index", "availability index"};
+      plan.indexes[i] = names[static_cast<size_t>(predicate.field)];
+      BookQuery single;
+      single.predicates.push_back(predicate);
+      BookFilter one;
+      estimate = single.toFilter(one) ? attributeIndex.count(one) : 0;
+      attributes = true;
+      attributeEstimate = std::min(attributeEstimate, estimate);
+    }
+    if (estimate == 0) {
+      possible = false;
+    }
+  }
+  if (attributes && attributeEstimate <= plan.estimatedCandidates) {
+    plan.access = QueryAccess::AttributeIndex;
+    plan.driver = SIZE_MAX;
+    plan.estimatedCandidates = attributeEstimate;
+  }
+
+  // An index lists all of its candidates before the first is checked, but
+  // a scan stops once it has found the limit. Taking the predicates as
+  // independent, a scan reads about limit * books / matches slots. Listing
+  // costs about twice as much per book as scanning, so the scan also wins
+  // when the index would let most of the catalog through.
+  if (plan.access != QueryAccess::Scan && plan.books > 0) {
+    double matches = static_cast<double>(plan.books);
+    for (size_t estimate : plan.estimates) {
+      matches *= static_cast<double>(estimate) / plan.books;
     }
+    double scanCost = static_cast<double>(plan.books);
+    if (query.limit != SIZE_MAX && matches > 0) {
+      scanCost = std::min(scanCost, static_cast<double>(query.limit) *
+                                       plan.books / matches);
+    }
+    if (2.0 * plan.estimatedCandidates >= scanCost) {
+      plan.access = QueryAccess::Scan;
+      plan.driver = SIZE_MAX;
+      plan.estimatedCandidates = plan.books;
+    }
+  }
+  if (!possible) {
+    plan.access = QueryAccess::Empty;
+    plan.driver = SIZE_MAX;
+    plan.estimatedCandidates = 0;
   }
+  return plan;
+}
 
-  std::vector<std::pair<std::string, int>> borrowVec(borrowCount.begin(),
-                                                     borrowCount.end());
-  std::sort(
-      borrowVec.begin(), borrowVec.end(), [](const auto &a, const auto &b) {
-        return b.second < a.second; // Sort by borrow count in descending order.
-      });
+// Plans a query against the current indexes.
+QueryPlan LibrarySystem::planQuery(const BookQuery &query) const {
+  std::shared_lock<CatalogMutex> lock(catalogMutex);
+  return planLocked(query);
+}
 
-  std::vector<std::shared_ptr<Book>> mostBorrowedBooks;
-  for (int i = 0; i < topN && i < borrowVec.size(); ++i) {
-    for (const auto &item : items) {
-      if (auto book = std::dynamic_pointer_cast<Book>(item)) {
-        if (book->getId() == borrowVec[i].first) {
-          mostBorrowedBooks.push_back(book);
-          break;
-        }
-      }
+// Plans the query and lists the candidates of its access path. Checking
+// them is left to the cursor.
+BookCursor LibrarySystem::queryBooks(const BookQuery &query) const {
+  OperationTimer timer(metrics, LibraryOperation::Query);
+  BookCursor cursor;
+  cursor.library = this;
+  cursor.query = query;
+  std::shared_lock<CatalogMutex> lock(catalogMutex);
+  cursor.plan = planLocked(query);
+  std::string key;
+  if (cursor.plan.driver != SIZE_MAX) {
+    foldText(query.predicates[cursor.plan.driver].text, key);
+  }
+  switch (cursor.plan.access) {
+  case QueryAccess::TitleIndex:
+    titleIndex.candidates(key, cursor.candidates);
+    break;
+  case QueryAccess::AuthorIndex:
+    authorIndex.candidates(key, cursor.candidates);
+    break;
+  case QueryAccess::CategoryIndex:
+    categoryIndex.candidates(key, cursor.candidates);
+    break;
+  case QueryAccess::AttributeIndex: {
+    BookFilter filter;
+    query.toFilter(filter);
+    attributeIndex.find(filter, cursor.candidates);
+    break;
+  }
+  default:
+    break;
+  }
+  return cursor;
+}
+
+// Describes the plan queryBooks would use.
+std::string LibrarySystem::explainQuery(const BookQuery &query) const {
+  return planQuery(query).explain(query);
+}
+
+// Checks candidates, or in a scan every slot, until one matches. Every
+// predicate is checked, including the one that chose the candidates: a
+// trigram candidate may not contain the text, and a book may have been
+// borrowed or replaced since the query was opened.
+std::shared_ptr<Book> BookCursor::next() {
+  if (!library || returned >= query.limit ||
+      plan.access == QueryAccess::Empty) {
+    return nullptr;
+  }
+  std::shared_lock<LibrarySystem::CatalogMutex> lock(library->catalogMutex);
+  const auto &books = library->books;
+  bool scan = plan.access == QueryAccess::Scan;
+  size_t end = scan ? books.size() : candidates.size();
+  while (position < end) {
+    const auto &book = books[scan ? position : candidates[position]];
+    ++position;
+    if (query.matches(*book)) {
+      ++returned;
+      return book;
     }
   }
+  return nullptr;
+}
+
+// Returns the plan the query runs under.
+const QueryPlan &BookCursor::getPlan() const { return plan; }
+
+// Copies every book into a struct-of-arrays catalog.
+CompactCatalog LibrarySystem::getCompactCatalog() const {
+  std::shared_lock<CatalogMutex> lock(catalogMutex);
+  return CompactCatalog::fromBooks(books);
+}
+
+// Returns the approximate memory used by the search indexes, in bytes.
+size_t LibrarySystem::getSearchIndexMemoryUsage() const {
+  std::shared_lock<CatalogMutex> lock(catalogMutex);
+  std::lock_guard<Mutex> ranking(rankingMutex);
+  return titleIndex.memoryUsage() + authorIndex.memoryUsage() +
+         categoryIndex.memoryUsage() + titleFuzzyIndex.memoryUsage() +
+         authorFuzzyIndex.memoryUsage() + attributeIndex.memoryUsage() +
+         titleCompletions.memoryUsage() + authorCompletions.memoryUsage();
+}
+
+// Returns the top N books by lifetime borrow count, read off the live
+// ranking in O(N).
+std::vector<std::shared_ptr<Book>>
+LibrarySystem::getMostBorrowedBooks(int topN) const {
+  OperationTimer timer(metrics, LibraryOperation::MostBorrowed);
+  std::vector<std::shared_ptr<Book>> mostBorrowedBooks;
+  if (topN <= 0) {
+    return mostBorrowedBooks;
+  }
+  mostBorrowedBooks.reserve(topN);
+
+  std::shared_lock<CatalogMutex> lock(catalogMutex);
+  std::lock_guard<Mutex> ranking(rankingMutex);
+  popularity.forEachTop(topN, [this, &mostBorrowedBooks](uint32_t doc) {
+    mostBorrowedBooks.push_back(books[doc]);
+  });
   return mostBorrowedBooks;
 }
 
-// Returns books that are overdue by a specified number of days.
+// Returns books that are overdue by a specified number of days. A loan is
+// overdue once more than days whole days have passed since it started, so
+// this is a range scan over loans borrowed at or before now - (days + 1).
 std::vector<std::shared_ptr<Book>>
 LibrarySystem::getOverdueBooks(int days) const {
+  OperationTimer timer(metrics, LibraryOperation::Overdue);
   std::vector<std::shared_ptr<Book>> overdueBooks;
-  auto now = std::chrono::system_clock::now();
-
-  for (const auto &item : items) {
-    if (auto user = std::dynamic_pointer_cast<User>(item)) {
-      for (const auto &bookId : user->getBorrowedBooks()) {
-        try {
-          auto borrowDate = user->getBorrowDate(bookId);
-          auto duration =
-              std::chrono::duration_cast<std::chrono::hours>(now - borrowDate)
-                  .count();
-          int daysOverdue = duration / 24; // Convert hours to days.
-          if (daysOverdue > days) {
-            for (const auto &item : items) {
-              if (auto book = std::dynamic_pointer_cast<Book>(item)) {
-                if (book->getId() == bookId) {
-                  overdueBooks.push_back(book);
-                  break;
-                }
-              }
-            }
-          }
-        } catch (const std::runtime_error &) {
-          std::cerr << "Error: Book not found in borrow dates." << std::endl;
+  auto cutoff = std::chrono::system_clock::now() -
+                std::chrono::hours(24) * (static_cast<long long>(days) + 1);
+
+  std::shared_lock<CatalogMutex> lock(catalogMutex);
+  std::lock_guard<Mutex> loans(loanMutex);
+  loanIndex.forEachBorrowedBefore(
+      cutoff, [this, &overdueBooks](LoanIndex::TimePoint,
+                                    const LoanIndex::Loan &loan) {
+        if (auto book = lookupBook(loan.bookId)) {
+          overdueBooks.push_back(book);
         }
-      }
+      });
+  return overdueBooks;
+}
+
+// Returns books whose loan period ends between now and days days from now.
+std::vector<std::shared_ptr<Book>>
+LibrarySystem::getBooksDueWithin(int days) const {
+  OperationTimer timer(metrics, LibraryOperation::DueSoon);
+  std::vector<std::shared_ptr<Book>> dueBooks;
+  auto period = std::chrono::hours(24) * loanPeriodDays.load();
+  auto from = std::chrono::system_clock::now() - period;
+  auto to = from + std::chrono::hours(24) * days;
+
+  std::shared_lock<CatalogMutex> lock(catalogMutex);
+  std::lock_guard<Mutex> loans(loanMutex);
+  loanIndex.forEachBorrowedBetween(
+      from, to,
+      [this, &dueBooks](LoanIndex::TimePoint, const LoanIndex::Loan &loan) {
+        if (auto book = lookupBook(loan.bookId)) {
+          dueBooks.push_back(book);
+        }
+      });
+  return dueBooks;
+}
+
+// Sets the number of days a book may be kept.
+void LibrarySystem::setLoanPeriod(int days) { loanPeriodDays = days; }
+
+// Returns the number of days a book may be kept.
+int LibrarySystem::getLoanPeriod() const { return loanPeriodDays; }
+
+// Changes the recorded borrow date of an open loan.
+bool LibrarySystem::setBorrowDate(
+    const std::string &userId, const std::string &bookId,
+    std::chrono::system_clock::time_point borrowDate) {
+  std::shared_lock<CatalogMutex> lock(catalogMutex);
+  uint64_t seq = 0;
+  return applyBorrowDate(userId, bookId, borrowDate, &seq);
+}
+
+// Records a changed borrow date.
+bool LibrarySystem::applyBorrowDate(
+    const std::string &userId, const std::string &bookId,
+    std::chrono::system_clock::time_point borrowDate, uint64_t *journalSeq) {
+  size_t userSlot;
+  auto user = lookupUser(userId, &userSlot);
+  if (!user) {
+    return false;
+  }
+  {
+    std::lock_guard<Mutex> stripe(stripeOf(userSlot));
+    if (!user->hasBorrowedBook(bookId)) {
+      return false;
+    }
+    user->setBorrowedBookDate(bookId, borrowDate);
+    {
+      // Under the stripe, so a concurrent return cannot be undone.
+      std::lock_guard<Mutex> loans(loanMutex);
+      loanIndex.add(userId, bookId, borrowDate);
+    }
+    if (journalSeq) {
+      *journalSeq =
+          journal.append({"D", userId, bookId, toEpochSeconds(borrowDate)});
     }
   }
-  return overdueBooks;
+  return true;
 }
 
 // Returns all items in the library system.
@@ -296,18 +1757,30 @@ const std::vector<std::shared_ptr<Item>> &LibrarySystem::getItems() const {
   return items;
 }
 
+// Returns all books in the library system.
+const std::vector<std::shared_ptr<Book>> &LibrarySystem::getBooks() const {
+  return books;
+}
+
+// Returns all users in the library system.
+const std::vector<std::shared_ptr<User>> &LibrarySystem::getUsers() const {
+  return users;
+}
+
 // Checks if a user has borrowed a specific book.
 bool LibrarySystem::hasBorrowedBook(const std::string &userId,
                                     const std::string &bookId) const {
-  std::lock_guard<std::mutex> lock(libraryMutex);
+  std::shared_lock<CatalogMutex> lock(catalogMutex);
 
   // Find user by userId.
-  auto user = findUserById(userId);
+  size_t userSlot;
+  auto user = lookupUser(userId, &userSlot);
   if (!user) {
     // If user not found, return false.
     return false;
   }
 
   // Check if the book is in the user's borrowed books.
+  std::lock_guard<Mutex> stripe(stripeOf(userSlot));
   return user->hasBorrowedBook(bookId);
 }
@@ -0,0 +1,41 @@
+#include "LoanIndex.hpp"
+
+// Builds the lookup key of a (user, book) pair. IDs never contain '\n',
+// since the data files are line based.
+std::string LoanIndex::keyFor(const std::string &userId,
+                              const std::string &bookId) {
+  std::string key;
+  key.reserve(userId.size() + bookId.size() + 1);
+  key += userId;
+  key += '\n';
+  key += bookId;
+  return key;
+}
+
+// Records a loan, replacing any existing entry for the same pair.
+void LoanIndex::add(const std::string &userId, const std::string &bookId,
+                    TimePoint borrowDate) {
+  auto key = keyFor(userId, bookId);
+  auto found = byKey.find(key);
+  if (found != byKey.end()) {
+    byDate.erase(found->second);
+    found->second = byDate.emplace(borrowDate, Loan{userId, bookId});
+  } else {
+    byKey.emplace(std::move(key),
+                  byDate.emplace(borrowDate, Loan{userId, bookId}));
+  }
+}
+
+// Forgets a loan.
+bool LoanIndex::remove(const std::string &userId, const std::string &bookId) {
+  auto found = byKey.find(keyFor(userId, bookId));
+  if (found == byKey.end()) {
+    return false;
+  }
+  byDate.erase(found->second);
+  byKey.erase(found);
+  return true;
+}
+
+// Returns the number of open loans.
+size_t LoanIndex::size() const { return byDate.size(); }
@@ -0,0 +1,54 @@
+#include "MappedFile.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Unmaps the file on destruction.
+MappedFile::~MappedFile() { close(); }
+
+// Maps the whole file read-only.
+bool MappedFile::open(const std::string &filename) {
+  close();
+
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat st;
+  if (::fstat(fd, &st) != 0) {
+    ::close(fd);
+    return false;
+  }
+
+  if (st.st_size > 0) {
+    void *mapped =
+        ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED) {
+      ::close(fd);
+      return false;
+    }
+    // The loaders read front to back.
+    ::madvise(mapped, st.st_size, MADV_SEQUENTIAL);
+    data = static_cast<const char *>(mapped);
+    length = st.st_size;
+  }
+
+  ::close(fd); // The mapping stays valid without the descriptor.
+  return true;
+}
+
+// Unmaps the file.
+void MappedFile::close() {
+  if (data) {
+    ::munmap(const_cast<char *>(data), length);
+    data = nullptr;
+    length = 0;
+  }
+}
+
+// Returns the mapped bytes.
+std::string_view MappedFile::view() const {
+  return std::string_view(data, length);
+}
@@ -0,0 +1,276 @@
+#include "Metrics.hpp"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+static const char *const operationNames[] = {
+    "add_item", "borrow", "return", "search", "most_borrowed", "overdue",
+    "due_soon", "import", "find", "query", "fuzzy_search",
+    "complete"};
+static const char *const ioKindNames[] = {"load_file", "save_file",
+                                          "load_snapshot", "save_snapshot"};
+
+const char *operationName(LibraryOperation operation) {
+  return operationNames[static_cast<size_t>(operation)];
+}
+
+const char *ioKindName(IoKind kind) {
+  return ioKindNames[static_cast<size_t>(kind)];
+}
+
+// Prometheus buckets: every power of two nanoseconds from 2 up to 2^40,
+// about 18 minutes.
+static const size_t prometheusBucketCount = 40;
+
+// Spreads threads over the shards round-robin, in order of first use.
+size_t Metrics::shardIndex() {
+  static std::atomic<size_t> nextShard{0};
+  thread_local size_t index =
+      nextShard.fetch_add(1, std::memory_order_relaxed) % shardCount;
+  return index;
+}
+
+// Records one call of operation that started at start.
+void Metrics::record(LibraryOperation operation, Clock::time_point start,
+                     bool succeeded) {
+  uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    Clock::now() - start)
+                    .count();
+  auto &counters =
+      shards[shardIndex()].operations[static_cast<size_t>(operation)];
+  counters.calls.fetch_add(1, std::memory_order_relaxed);
+  if (!succeeded) {
+    counters.failures.fetch_add(1, std::memory_order_relaxed);
+  }
+  counters.totalNs.fetch_add(ns, std::memory_order_relaxed);
+  counters.latency.record(ns);
+}
+
+// Records one file read or write.
+void Metrics::recordIo(IoKind kind, uint64_t bytes, Clock::time_point start) {
+  auto &counters = io[static_cast<size_t>(kind)];
+  counters.operations.fetch_add(1, std::memory_order_relaxed);
+  counters.bytes.fetch_add(bytes, std::memory_order_relaxed);
+  counters.totalNs.fetch_add(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                           start)
+          .count(),
+      std::memory_order_relaxed);
+}
+
+// Sums the shards into metrics.
+void Metrics::collect(LibraryMetrics &metrics) const {
+  for (size_t op = 0; op < operationCount; ++op) {
+    OperationMetrics &result = metrics.operations[op];
+    result = OperationMetrics();
+    for (const auto &shard : shards) {
+      const auto &counters = shard.operations[op];
+      result.calls += counters.calls.load(std::memory_order_relaxed);
+      result.failures += counters.failures.load(std::memory_order_relaxed);
+      result.totalNs += counters.totalNs.load(std::memory_order_relaxed);
+      counters.latency.addTo(result.latency);
+    }
+  }
+  for (size_t kind = 0; kind < ioKindCount; ++kind) {
+    metrics.io[kind].operations =
+        io[kind].operations.load(std::memory_order_relaxed);
+    metrics.io[kind].bytes = io[kind].bytes.load(std::memory_order_relaxed);
+    metrics.io[kind].totalNs =
+        io[kind].totalNs.load(std::memory_order_relaxed);
+  }
+}
+
+// Prints a human-readable table of every counter.
+void LibraryMetrics::writeSummary(std::ostream &out) const {
+  out << std::left << std::setw(15) << "Operation" << std::right
+      << std::setw(10) << "Calls" << std::setw(9) << "Failed" << std::setw(11)
+      << "Mean(us)" << std::setw(10) << "p50(us)" << std::setw(10)
+      << "p99(us)" << std::setw(11) << "Max(us)" << "\n";
+  out << std::fixed << std::setprecision(1);
+  for (size_t op = 0; op < operationCount; ++op) {
+    const auto &metrics = operations[op];
+    out << std::left << std::setw(15) << operationNames[op] << std::right
+        << std::setw(10) << metrics.calls << std::setw(9) << metrics.failures
+        << std::setw(11)
+        << (metrics.calls ? metrics.totalNs / 1e3 / metrics.calls : 0.0)
+        << std::setw(10) << metrics.latency.percentile(0.5) / 1e3
+        << std::setw(10) << metrics.latency.percentile(0.99) / 1e3
+        << std::setw(11) << metrics.latency.max() / 1e3 << "\n";
+  }
+
+  out << "\n"
+      << std::left << std::setw(15) << "File I/O" << std::right
+      << std::setw(10) << "Count" << std::setw(14) << "Bytes"
+      << std::setw(11) << "Time(ms)" << "\n";
+  for (size_t kind = 0; kind < ioKindCount; ++kind) {
+    out << std::left << std::setw(15) << ioKindNames[kind] << std::right
+        << std::setw(10) << io[kind].operations << std::setw(14)
+        << io[kind].bytes << std::setw(11) << io[kind].totalNs / 1e6 << "\n";
+  }
+
+  out << "\n"
+      << std::left << std::setw(15) << "Lock" << std::right << std::setw(10)
+      << "Contended" << std::setw(14) << "Wait(ms)" << "\n";
+  for (const auto &lock : locks) {
+    out << std::left << std::setw(15) << lock.first << std::right
+        << std::setw(10) << lock.second.contended << std::setw(14)
+        << lock.second.waitNs / 1e6 << "\n";
+  }
+
+  out << "\nJournal: " << journal.commits << " commits, " << journal.records
+      << " records, " << journal.bytes << " bytes, "
+      << journal.totalWriteNs / 1e6 << " ms writing\n";
+  out << "Books: " << books << ", Users: " << users
+      << ", Open loans: " << openLoans << "\n";
+  out << std::defaultfloat << std::setprecision(6);
+}
+
+// Writes one Prometheus sample line.
+template <typename Value>
+static void writeSample(std::ostream &out, const std::string &name,
+                        const std::string &labels, Value value) {
+  out << name;
+  if (!labels.empty()) {
+    out << '{' << labels << '}';
+  }
+  out << ' ' << value << '\n';
+}
+
+// Writes the HELP and TYPE lines of a metric family.
+static void writeFamily(std::ostream &out, const char *name, const char *type,
+                        const char *help) {
+  out << "# HELP " << name << ' ' << help << '\n';
+  out << "# TYPE " << name << ' ' << type << '\n';
+}
+
+// Writes every counter in the Prometheus text exposition format.
+void LibraryMetrics::writePrometheus(std::ostream &out) const {
+  auto precision = out.precision(12);
+
+  writeFamily(out, "library_operation_duration_seconds", "histogram",
+              "Time spent in library operations.");
+  for (size_t op = 0; op < operationCount; ++op) {
+    const auto &metrics = operations[op];
+    std::string label = std::string("operation=\"") + operationNames[op] + '"';
+    for (size_t i = 0; i < prometheusBucketCount; ++i) {
+      // Values below 2^(i+1) ns are exactly those of at most 2^(i+1) - 1.
+      uint64_t limit = uint64_t(2) << i;
+      std::ostringstream bound;
+      bound.precision(12);
+      bound << (limit - 1) / 1e9;
+      writeSample(out, "library_operation_duration_seconds_bucket",
+                  label + ",le=\"" + bound.str() + '"',
+                  metrics.latency.countBelow(limit));
+    }
+    writeSample(out, "library_operation_duration_seconds_bucket",
+                label + ",le=\"+Inf\"", metrics.calls);
+    writeSample(out, "library_operation_duration_seconds_sum", label,
+                metrics.totalNs / 1e9);
+    writeSample(out, "library_operation_duration_seconds_count", label,
+                metrics.calls);
+  }
+  writeFamily(out, "library_operation_failures_total", "counter",
+              "Library operations that returned false.");
+  for (size_t op = 0; op < operationCount; ++op) {
+    writeSample(out, "library_operation_failures_total",
+                std::string("operation=\"") + operationNames[op] + '"',
+                operations[op].failures);
+  }
+
+  writeFamily(out, "library_io_operations_total", "counter",
+              "Data file and snapshot reads and writes.");
+  for (size_t kind = 0; kind < ioKindCount; ++kind) {
+    writeSample(out, "library_io_operations_total",
+                std::string("kind=\"") + ioKindNames[kind] + '"',
+                io[kind].operations);
+  }
+  writeFamily(out, "library_io_bytes_total", "counter",
+              "Bytes read from or written to data files and snapshots.");
+  for (size_t kind = 0; kind < ioKindCount; ++kind) {
+    writeSample(out, "library_io_bytes_total",
+                std::string("kind=\"") + ioKindNames[kind] + '"',
+                io[kind].bytes);
+  }
+  writeFamily(out, "library_io_seconds_total", "counter",
+              "Time spent loading and saving data files and snapshots.");
+  for (size_t kind = 0; kind < ioKindCount; ++kind) {
+    writeSample(out, "library_io_seconds_total",
+                std::string("kind=\"") + ioKindNames[kind] + '"',
+                io[kind].totalNs / 1e9);
+  }
+
+  writeFamily(out, "library_lock_contended_total", "counter",
+              "Lock acquisitions that had to wait.");
+  for (const auto &lock : locks) {
+    writeSample(out, "library_lock_contended_total",
+                "lock=\"" + lock.first + '"', lock.second.contended);
+  }
+  writeFamily(out, "library_lock_wait_seconds_total", "counter",
+              "Time spent waiting for library locks.");
+  for (const auto &lock : locks) {
+    writeSample(out, "library_lock_wait_seconds_total",
+                "lock=\"" + lock.first + '"', lock.second.waitNs / 1e9);
+  }
+
+  writeFamily(out, "library_journal_commits_total", "counter",
+              "Journal batches written.");
+  writeSample(out, "library_journal_commits_total", "", journal.commits);
+  writeFamily(out, "library_journal_records_total", "counter",
+              "Journal records written.");
+  writeSample(out, "library_journal_records_total", "", journal.records);
+  writeFamily(out, "library_journal_bytes_total", "counter",
+              "Bytes appended to the journal.");
+  writeSample(out, "library_journal_bytes_total", "", journal.bytes);
+  writeFamily(out, "library_journal_write_seconds_total", "counter",
+              "Time spent writing and syncing the journal.");
+  writeSample(out, "library_journal_write_seconds_total", "",
+              journal.totalWriteNs / 1e9);
+  writeFamily(out, "library_journal_commit_latency_seconds_total", "counter",
+              "Sum over commits of how long the oldest record waited.");
+  writeSample(out, "library_journal_commit_latency_seconds_total", "",
+              journal.totalCommitLatencyNs / 1e9);
+
+  writeFamily(out, "library_books", "gauge", "Books in the catalog.");
+  writeSample(out, "library_books", "", books);
+  writeFamily(out, "library_users", "gauge", "Registered users.");
+  writeSample(out, "library_users", "", users);
+  writeFamily(out, "library_open_loans", "gauge", "Books currently lent.");
+  writeSample(out, "library_open_loans", "", openLoans);
+
+  out.precision(precision);
+}
+
+// Appends "name=value;..." for operations that ran, lock waits, the
+// journal and the catalog size.
+void LibraryMetrics::appendCompact(std::string &out) const {
+  bool first = true;
+  auto add = [&out, &first](const std::string &name, uint64_t value) {
+    if (!first) {
+      out += ';';
+    }
+    first = false;
+    out += name;
+    out += '=';
+    out += std::to_string(value);
+  };
+  for (size_t op = 0; op < operationCount; ++op) {
+    const auto &metrics = operations[op];
+    if (metrics.calls == 0) {
+      continue;
+    }
+    std::string prefix = operationNames[op];
+    add(prefix + "_calls", metrics.calls);
+    add(prefix + "_failures", metrics.failures);
+    add(prefix + "_p50_ns", metrics.latency.percentile(0.5));
+    add(prefix + "_p99_ns", metrics.latency.percentile(0.99));
+    add(prefix + "_max_ns", metrics.latency.max());
+  }
+  for (const auto &lock : locks) {
+    add("lock_" + lock.first + "_wait_ns", lock.second.waitNs);
+  }
+  add("journal_commits", journal.commits);
+  add("journal_bytes", journal.bytes);
+  add("books", books);
+  add("users", users);
+  add("open_loans", openLoans);
+}
@@ -0,0 +1,27 @@
+#include "PopularityRanking.hpp"
+
+// Registers a new document with its current count.
+void PopularityRanking::add(uint32_t doc, int count) {
+  if (doc >= counts.size()) {
+    counts.resize(doc + 1, 0);
+  }
+  counts[doc] = count;
+  if (count > 0) {
+    ranking.insert({count, doc});
+  }
+}
+
+// Moves a document to its new count.
+void PopularityRanking::update(uint32_t doc, int count) {
+  if (doc >= counts.size()) {
+    add(doc, count);
+    return;
+  }
+  if (counts[doc] > 0) {
+    ranking.erase({counts[doc], doc});
+  }
+  counts[doc] = count;
+  if (count > 0) {
+    ranking.insert({count, doc});
+  }
+}
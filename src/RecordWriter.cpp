@@ -0,0 +1,187 @@
+#include "RecordWriter.hpp"
+#include <algorithm>
+#include <charconv>
+
+// Parses the name of an output format.
+bool parseOutputFormat(std::string_view name, OutputFormat &format) {
+  if (name == "table") {
+    format = OutputFormat::Table;
+  } else if (name == "csv") {
+    format = OutputFormat::Csv;
+  } else if (name == "jsonl") {
+    format = OutputFormat::JsonLines;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+RecordWriter::RecordWriter(std::ostream &out, OutputFormat format,
+                           std::vector<RecordColumn> columns)
+    : out(out), format(format), columns(std::move(columns)) {
+  buffer.reserve(blockBytes + 4096);
+}
+
+// Writes out anything still buffered.
+RecordWriter::~RecordWriter() { flush(); }
+
+// Writes the column names, and in a table a rule under them.
+void RecordWriter::writeHeader() {
+  headerWritten = true;
+  if (format == OutputFormat::JsonLines) {
+    return;
+  }
+  size_t ruleWidth = 0;
+  for (size_t i = 0; i < columns.size(); ++i) {
+    column = i;
+    beginField();
+    appendText(columns[i].name, false);
+    ruleWidth += std::max(columns[i].width, columns[i].name.size()) +
+                 (i > 0 ? 2 : 0);
+  }
+  buffer += '\n';
+  if (format == OutputFormat::Table) {
+    buffer.append(ruleWidth, '-');
+    buffer += '\n';
+  }
+  column = 0;
+}
+
+// Emits what goes before a field: the separator from the previous one, and
+// in JSON the opening brace and the key.
+void RecordWriter::beginField() {
+  if (!headerWritten) {
+    writeHeader();
+  }
+  switch (format) {
+  case OutputFormat::Table:
+    if (column > 0) {
+      buffer += "  ";
+    }
+    break;
+  case OutputFormat::Csv:
+    if (column > 0) {
+      buffer += ',';
+    }
+    break;
+  case OutputFormat::JsonLines:
+    buffer += column == 0 ? "{\"" : ",\"";
+    if (column < columns.size()) {
+      buffer += columns[column].name;
+    }
+    buffer += "\":";
+    break;
+  }
+}
+
+// Appends value escaped for the format. Table cells are padded to their
+// column width, except the last, so lines carry no trailing blanks.
+void RecordWriter::appendText(std::string_view value, bool quoteInJson) {
+  switch (format) {
+  case OutputFormat::Table:
+    buffer += value;
+    if (column + 1 < columns.size() && value.size() < columns[column].width) {
+      buffer.append(columns[column].width - value.size(), ' ');
+    }
+    break;
+  case OutputFormat::Csv:
+    if (value.find_first_of(",\"\r\n") == std::string_view::npos) {
+      buffer += value;
+    } else {
+      buffer += '"';
+      for (char c : value) {
+        if (c == '"') {
+          buffer += '"'; // Quotes are doubled inside a quoted field.
+        }
+        buffer += c;
+      }
+      buffer += '"';
+    }
+    break;
+  case OutputFormat::JsonLines:
+    if (!quoteInJson) {
+      buffer += value;
+      break;
+    }
+    buffer += '"';
+    for (char c : value) {
+      auto byte = static_cast<unsigned char>(c);
+      if (c == '"' || c == '\\') {
+        buffer += '\\';
+        buffer += c;
+      } else if (byte < 0x20) {
+        static const char hex[] = "0123456789abcdef";
+        buffer += "\\u00";
+        buffer += hex[byte >> 4];
+        buffer += hex[byte & 0xf];
+      } else {
+        buffer += c; // UTF-8 passes through unchanged.
+      }
+    }
+    buffer += '"';
+    break;
+  }
+}
+
+// Adds a text field.
+void RecordWriter::text(std::string_view value) {
+  beginField();
+  appendText(value, true);
+  ++column;
+}
+
+// Adds a numeric field, unquoted in every format.
+void RecordWriter::number(int64_t value) {
+  char digits[24];
+  auto result = std::to_chars(digits, digits + sizeof(digits), value);
+  beginField();
+  appendText(std::string_view(digits, result.ptr - digits), false);
+  ++column;
+}
+
+// Adds a yes/no field: true / false in JSON, 1 / 0 in CSV as in the data
+// files, Yes / No in a table.
+void RecordWriter::flag(bool value) {
+  beginField();
+  switch (format) {
+  case OutputFormat::Table:
+    appendText(value ? "Yes" : "No", false);
+    break;
+  case OutputFormat::Csv:
+    appendText(value ? "1" : "0", false);
+    break;
+  case OutputFormat::JsonLines:
+    appendText(value ? "true" : "false", false);
+    break;
+  }
+  ++column;
+}
+
+// Ends the current record and writes a block out once enough is buffered.
+void RecordWriter::endRecord() {
+  if (format == OutputFormat::JsonLines) {
+    buffer += column == 0 ? "{}" : "}";
+  }
+  buffer += '\n';
+  column = 0;
+  ++rows;
+  if (buffer.size() >= blockBytes) {
+    flush();
+  }
+}
+
+// Hands the buffer to the stream.
+bool RecordWriter::flush() {
+  if (!headerWritten) {
+    writeHeader();
+  }
+  if (!buffer.empty()) {
+    out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    buffer.clear();
+  }
+  out.flush();
+  return out.good();
+}
+
+// Returns the number of records ended so far.
+size_t RecordWriter::recordCount() const { return rows; }
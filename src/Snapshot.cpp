@@ -0,0 +1,235 @@
+#include "Snapshot.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+
+static const char snapshotMagic[8] = {'B', 'M', 'S', 'N', 'A', 'P', 0, 0};
+
+// Builds the string pool, storing each distinct string once. The keys view
+// the strings being written, which must outlive the builder.
+class StringPoolBuilder {
+private:
+  std::string data;
+  std::unordered_map<std::string_view, SnapshotString> offsets;
+
+public:
+  // Returns a reference to text, adding it to the pool if needed.
+  SnapshotString add(std::string_view text) {
+    auto it = offsets.find(text);
+    if (it != offsets.end()) {
+      return it->second;
+    }
+    SnapshotString ref{static_cast<uint32_t>(data.size()),
+                       static_cast<uint32_t>(text.size())};
+    data += text;
+    offsets.emplace(text, ref);
+    return ref;
+  }
+
+  const std::string &bytes() const { return data; }
+};
+
+// Appends a fixed-width record to the body.
+template <typename Record>
+static void appendRecord(std::string &body, const Record &record) {
+  body.append(reinterpret_cast<const char *>(&record), sizeof(Record));
+}
+
+// Checksum used for the snapshot body: FNV-1a over 64-bit words with an
+// extra fold so high input bits reach the low output bits.
+uint64_t Snapshot::checksum(const char *data, size_t size) {
+  const uint64_t prime = 1099511628211ULL;
+  uint64_t hash = 1469598103934665603ULL;
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, data + i, sizeof(word));
+    hash ^= word;
+    hash *= prime;
+    hash ^= hash >> 32;
+  }
+  for (; i < size; ++i) {
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= prime;
+  }
+  return hash;
+}
+
+// Writes books and users (with their loans) to filename. The file is
+// written next to its target and renamed over it.
+bool Snapshot::write(const std::string &filename,
+                     const std::vector<std::shared_ptr<Book>> &books,
+                     const std::vector<std::shared_ptr<User>> &users) {
+  StringPoolBuilder pool;
+  std::vector<SnapshotBook> bookRecords;
+  std::vector<SnapshotUser> userRecords;
+  std::vector<SnapshotLoan> loanRecords;
+  bookRecords.reserve(books.size());
+  userRecords.reserve(users.size());
+
+  for (const auto &book : books) {
+    SnapshotBook record{};
+    record.id = pool.add(book->getIdView());
+    record.title = pool.add(book->getTitleView());
+    record.author = pool.add(book->getAuthorView());
+    record.category = pool.add(book->getCategoryView());
+    record.year = book->getYear();
+    record.borrowCount = book->getBorrowCount();
+    record.available = book->isAvailable() ? 1 : 0;
+    bookRecords.push_back(record);
+  }
+
+  for (const auto &user : users) {
+    SnapshotUser record{};
+    record.id = pool.add(user->getIdView());
+    record.name = pool.add(user->getNameView());
+    record.email = pool.add(user->getEmailView());
+    record.phone = pool.add(user->getPhoneView());
+    record.firstLoan = static_cast<uint32_t>(loanRecords.size());
+    for (const auto &bookId : user->getBorrowedBooksView()) {
+      SnapshotLoan loan{};
+      loan.bookId = pool.add(bookId);
+      loan.borrowedAt = std::chrono::duration_cast<std::chrono::seconds>(
+                            user->getBorrowDate(bookId).time_since_epoch())
+                            .count();
+      loanRecords.push_back(loan);
+    }
+    record.loanCount =
+        static_cast<uint32_t>(loanRecords.size()) - record.firstLoan;
+    userRecords.push_back(record);
+  }
+
+  if (pool.bytes().size() > UINT32_MAX || loanRecords.size() > UINT32_MAX) {
+    std::cerr << "Error: library too large for snapshot format." << std::endl;
+    return false;
+  }
+
+  std::string body;
+  body.reserve(bookRecords.size() * sizeof(SnapshotBook) +
+               userRecords.size() * sizeof(SnapshotUser) +
+               loanRecords.size() * sizeof(SnapshotLoan) + pool.bytes().size());
+  for (const auto &record : bookRecords) {
+    appendRecord(body, record);
+  }
+  for (const auto &record : userRecords) {
+    appendRecord(body, record);
+  }
+  for (const auto &record : loanRecords) {
+    appendRecord(body, record);
+  }
+  body += pool.bytes();
+
+  SnapshotHeader header{};
+  std::memcpy(header.magic, snapshotMagic, sizeof(header.magic));
+  header.version = currentVersion;
+  header.headerSize = sizeof(SnapshotHeader);
+  header.bookCount = bookRecords.size();
+  header.userCount = userRecords.size();
+  header.loanCount = loanRecords.size();
+  header.stringPoolSize = pool.bytes().size();
+  header.checksum = checksum(body.data(), body.size());
+
+  const std::string tmpName = filename + ".tmp";
+  std::ofstream file(tmpName, std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    std::cerr << "Error opening file for writing: " << tmpName << std::endl;
+    return false;
+  }
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  file.write(body.data(), body.size());
+  file.close();
+  if (file.fail() || std::rename(tmpName.c_str(), filename.c_str()) != 0) {
+    std::cerr << "Error writing snapshot: " << filename << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// Maps and validates the snapshot file.
+bool SnapshotView::open(const std::string &filename, std::string &error) {
+  header = nullptr;
+  if (!file.open(filename)) {
+    error = "cannot open " + filename;
+    return false;
+  }
+
+  auto data = file.view();
+  if (data.size() < sizeof(SnapshotHeader)) {
+    error = "file too short";
+    return false;
+  }
+  auto candidate = reinterpret_cast<const SnapshotHeader *>(data.data());
+  if (std::memcmp(candidate->magic, snapshotMagic, sizeof(snapshotMagic)) !=
+      0) {
+    error = "not a snapshot file";
+    return false;
+  }
+  if (candidate->version != Snapshot::currentVersion ||
+      candidate->headerSize != sizeof(SnapshotHeader)) {
+    error = "unsupported snapshot version " +
+            std::to_string(candidate->version);
+    return false;
+  }
+
+  // Check the declared sizes against the file before trusting them; each
+  // count is bounded by the file size so the sum cannot overflow.
+  const uint64_t bodySize = data.size() - sizeof(SnapshotHeader);
+  if (candidate->bookCount > bodySize || candidate->userCount > bodySize ||
+      candidate->loanCount > bodySize ||
+      candidate->stringPoolSize > bodySize ||
+      candidate->bookCount * sizeof(SnapshotBook) +
+              candidate->userCount * sizeof(SnapshotUser) +
+              candidate->loanCount * sizeof(SnapshotLoan) +
+              candidate->stringPoolSize !=
+          bodySize) {
+    error = "record counts do not match file size";
+    return false;
+  }
+
+  const char *body = data.data() + sizeof(SnapshotHeader);
+  if (Snapshot::checksum(body, bodySize) != candidate->checksum) {
+    error = "checksum mismatch";
+    return false;
+  }
+
+  header = candidate;
+  bookRecords = reinterpret_cast<const SnapshotBook *>(body);
+  userRecords =
+      reinterpret_cast<const SnapshotUser *>(bookRecords + header->bookCount);
+  loanRecords =
+      reinterpret_cast<const SnapshotLoan *>(userRecords + header->userCount);
+  pool = reinterpret_cast<const char *>(loanRecords + header->loanCount);
+  return true;
+}
+
+size_t SnapshotView::bookCount() const { return header->bookCount; }
+
+size_t SnapshotView::userCount() const { return header->userCount; }
+
+size_t SnapshotView::loanCount() const { return header->loanCount; }
+
+const SnapshotBook &SnapshotView::book(size_t index) const {
+  return bookRecords[index];
+}
+
+const SnapshotUser &SnapshotView::user(size_t index) const {
+  return userRecords[index];
+}
+
+// Returns the loan at index, which must be below the header's loan count.
+const SnapshotLoan &SnapshotView::loan(size_t index) const {
+  return loanRecords[index];
+}
+
+// Resolves a string reference against the pool. References outside the
+// pool resolve to an empty string.
+std::string_view SnapshotView::string(SnapshotString ref) const {
+  if (static_cast<uint64_t>(ref.offset) + ref.length >
+      header->stringPoolSize) {
+    return std::string_view();
+  }
+  return std::string_view(pool + ref.offset, ref.length);
+}
@@ -0,0 +1,138 @@
+#include "TextFold.hpp"
+#include <cstdint>
+
+// Folded form of each code point from U+00C0 to U+024F, and from U+1E00 to
+// U+1EFF, which holds the Vietnamese letters: the ASCII letter it is based
+// on, an upper-case code for two letters from ligatures, or '.' to keep it.
+// Derived from the Unicode character names.
+static const char latinFolds[] =
+    "aaaaaaAceeeeiiiidnooooo.ouuuuyKJ"  // U+00C0
+    "aaaaaaAceeeeiiiidnooooo.ouuuuyKy"  // U+00E0
+    "aaaaaaccccccccddddeeeeeeeeeegggg"  // U+0100
+    "gggghhhhiiiiiiiiiiDDjjkkklllllll"  // U+0120
+    "lllnnnnnn.nnooooooGGrrrrrrssssss"  // U+0140
+    "ssttttttuuuuuuuuuuuuwwyyyzzzzzzs"  // U+0160
+    "bbbb...cc.ddd....ffg.C.ikkl..nno"  // U+0180
+    "ooHHpp.....ttttuu.vyyzz........."  // U+01A0
+    "....BBBEEEFFFaaiioouuuuuuuuuu.aa"  // U+01C0
+    "aaAAggggkkoooo..jBBBgg..nnaaAAoo"  // U+01E0
+    "aaaaeeeeiiiioooorrrruuuusstt..hh"  // U+0200
+    "ndIIzzaaeeooooooooyylntj..acclts"  // U+0220
+    "z..b..eejj.qrryy";                 // U+0240
+static const char extendedFolds[] =
+    "aabbbbbbccddddddddddeeeeeeeeeeff"  // U+1E00
+    "gghhhhhhhhhhiiiikkkkkkllllllllmm"  // U+1E20
+    "mmmmnnnnnnnnoooooooopppprrrrrrrr"  // U+1E40
+    "ssssssssssttttttttuuuuuuuuuuvvvv"  // U+1E60
+    "wwwwwwwwwwxxxxyyzzzzzzhtwyasssJ."  // U+1E80
+    "aaaaaaaaaaaaaaaaaaaaaaaaeeeeeeee"  // U+1EA0
+    "eeeeeeeeiiiioooooooooooooooooooo"  // U+1EC0
+    "oooouuuuuuuuuuuuuuyyyyyyyy....yy"; // U+1EE0
+static const char *const ligatures[] = {"ae", "dz", "hv", "ij", "lj", "nj",
+                                        "oe", "oi", "ou", "ss", "th"};
+
+// Decodes the UTF-8 character at text[pos]. Returns its length, or 0 if the
+// bytes there are not a whole character.
+static size_t decodeUtf8(std::string_view text, size_t pos,
+                         uint32_t &codePoint) {
+  auto lead = static_cast<unsigned char>(text[pos]);
+  size_t length;
+  if (lead >= 0xC2 && lead <= 0xDF) {
+    length = 2;
+    codePoint = lead & 0x1F;
+  } else if (lead >= 0xE0 && lead <= 0xEF) {
+    length = 3;
+    codePoint = lead & 0x0F;
+  } else if (lead >= 0xF0 && lead <= 0xF4) {
+    length = 4;
+    codePoint = lead & 0x07;
+  } else {
+    return 0;
+  }
+  if (pos + length > text.size()) {
+    return 0;
+  }
+  for (size_t i = 1; i < length; ++i) {
+    auto byte = static_cast<unsigned char>(text[pos + i]);
+    if ((byte & 0xC0) != 0x80) {
+      return 0;
+    }
+    codePoint = (codePoint << 6) | (byte & 0x3F);
+  }
+  return length;
+}
+
+// Appends the folded form of a code point above U+007F to out. Returns
+// false if it folds to itself.
+static bool appendFolded(uint32_t codePoint, std::string &out) {
+  if (codePoint >= 0x0300 && codePoint <= 0x036F) {
+    return true; // Combining accent: dropped.
+  }
+  char folded = '.';
+  if (codePoint >= 0x00C0 && codePoint < 0x00C0 + sizeof(latinFolds) - 1) {
+    folded = latinFolds[codePoint - 0x00C0];
+  } else if (codePoint >= 0x1E00 &&
+             codePoint < 0x1E00 + sizeof(extendedFolds) - 1) {
+    folded = extendedFolds[codePoint - 0x1E00];
+  }
+  if (folded == '.') {
+    return false;
+  }
+  if (folded >= 'A' && folded <= 'Z') {
+    out += ligatures[folded - 'A'];
+  } else {
+    out += folded;
+  }
+  return true;
+}
+
+// Folds runs of ASCII a byte at a time and decodes the rest.
+void foldText(std::string_view text, std::string &out) {
+  out.clear();
+  out.reserve(text.size());
+  size_t pos = 0;
+  while (pos < text.size()) {
+    char c = text[pos];
+    if (static_cast<unsigned char>(c) < 0x80) {
+      out += c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+      ++pos;
+      continue;
+    }
+    uint32_t codePoint;
+    size_t length = decodeUtf8(text, pos, codePoint);
+    if (length == 0) {
+      out += c; // Not UTF-8: copied a byte at a time.
+      ++pos;
+      continue;
+    }
+    if (!appendFolded(codePoint, out)) {
+      out.append(text.data() + pos, length);
+    }
+    pos += length;
+  }
+}
+
+// Returns the search key of text.
+std::string foldText(std::string_view text) {
+  std::string folded;
+  foldText(text, folded);
+  return folded;
+}
+
+// Walks text one character at a time.
+bool isWholeUtf8(std::string_view text) {
+  size_t pos = 0;
+  while (pos < text.size()) {
+    if (static_cast<unsigned char>(text[pos]) < 0x80) {
+      ++pos;
+      continue;
+    }
+    uint32_t codePoint;
+    size_t length = decodeUtf8(text, pos, codePoint);
+    if (length == 0) {
+      return false;
+    }
+    pos += length;
+  }
+  return true;
+}
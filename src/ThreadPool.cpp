@@ -0,0 +1,52 @@
+#include "ThreadPool.hpp"
+#include <algorithm>
+
+// Starts the given number of workers (at least one).
+ThreadPool::ThreadPool(size_t threadCount) {
+  threadCount = std::max<size_t>(threadCount, 1);
+  workers.reserve(threadCount);
+  for (size_t i = 0; i < threadCount; ++i) {
+    workers.emplace_back(&ThreadPool::workerLoop, this);
+  }
+}
+
+// Finishes every queued task, then joins the workers.
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  ready.notify_all();
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+// Queues a task for the next free worker.
+void ThreadPool::submit(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    tasks.push_back(std::move(task));
+  }
+  ready.notify_one();
+}
+
+// Returns the number of workers.
+size_t ThreadPool::size() const { return workers.size(); }
+
+// Runs tasks until the pool is stopped and the queue is empty.
+void ThreadPool::workerLoop() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      ready.wait(lock, [this] { return stopping || !tasks.empty(); });
+      if (tasks.empty()) {
+        return; // Stopping and nothing left to do.
+      }
+      task = std::move(tasks.front());
+      tasks.pop_front();
+    }
+    task();
+  }
+}
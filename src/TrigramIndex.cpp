@@ -0,0 +1,190 @@
+#include "TrigramIndex.hpp"
+#include <algorithm>
+#include <iterator>
+
+// Packs three bytes into one key.
+static uint32_t packTrigram(const char *p) {
+  return static_cast<uint32_t>(static_cast<unsigned char>(p[0])) << 16 |
+         static_cast<uint32_t>(static_cast<unsigned char>(p[1])) << 8 |
+         static_cast<uint32_t>(static_cast<unsigned char>(p[2]));
+}
+
+// Appends the distinct trigrams of text to out.
+void TrigramIndex::trigramsOf(std::string_view text,
+                              std::vector<uint32_t> &out) {
+  size_t first = out.size();
+  for (size_t i = 0; i + gramLength <= text.size(); ++i) {
+    out.push_back(packTrigram(text.data() + i));
+  }
+  std::sort(out.begin() + first, out.end());
+  out.erase(std::unique(out.begin() + first, out.end()), out.end());
+}
+
+// Indexes text as document doc.
+void TrigramIndex::add(uint32_t doc, std::string_view text) {
+  std::vector<uint32_t> grams;
+  trigramsOf(text, grams);
+  for (uint32_t gram : grams) {
+    auto &list = postings[gram];
+    if (list.empty() || list.back() < doc) {
+      list.push_back(doc);
+    }
+  }
+}
+
+// Collects, per trigram, the documents to drop and to insert, then merges
+// them into each affected posting list in a single pass.
+void TrigramIndex::replace(const std::vector<TextChange> &changes) {
+  struct Edit {
+    uint32_t gram;
+    uint32_t doc;
+    bool insert;
+
+    bool operator<(const Edit &other) const {
+      return gram != other.gram ? gram < other.gram : doc < other.doc;
+    }
+  };
+  std::vector<Edit> edits;
+  std::vector<uint32_t> oldGrams, newGrams, changed;
+  for (const auto &change : changes) {
+    oldGrams.clear();
+    newGrams.clear();
+    trigramsOf(change.oldText, oldGrams);
+    trigramsOf(change.newText, newGrams);
+
+    changed.clear();
+    std::set_difference(oldGrams.begin(), oldGrams.end(), newGrams.begin(),
+                        newGrams.end(), std::back_inserter(changed));
+    for (uint32_t gram : changed) {
+      edits.push_back({gram, change.doc, false});
+    }
+    changed.clear();
+    std::set_difference(newGrams.begin(), newGrams.end(), oldGrams.begin(),
+                        oldGrams.end(), std::back_inserter(changed));
+    for (uint32_t gram : changed) {
+      edits.push_back({gram, change.doc, true});
+    }
+  }
+  std::sort(edits.begin(), edits.end());
+
+  std::vector<uint32_t> merged;
+  for (size_t first = 0; first < edits.size();) {
+    size_t last = first;
+    while (last < edits.size() && edits[last].gram == edits[first].gram) {
+      ++last;
+    }
+    auto &list = postings[edits[first].gram];
+    merged.clear();
+    merged.reserve(list.size() + (last - first));
+    auto it = list.begin();
+    for (size_t i = first; i < last; ++i) {
+      uint32_t doc = edits[i].doc;
+      while (it != list.end() && *it < doc) {
+        merged.push_back(*it++);
+      }
+      if (it != list.end() && *it == doc) {
+        ++it; // Dropped, or put back just below.
+      }
+      if (edits[i].insert) {
+        merged.push_back(doc);
+      }
+    }
+    merged.insert(merged.end(), it, list.end());
+    if (merged.empty()) {
+      postings.erase(edits[first].gram);
+    } else {
+      list.swap(merged);
+    }
+    first = last;
+  }
+}
+
+// Keeps the entries of candidates that also appear in list. Both are sorted.
+// When list is much longer, each candidate is found by binary search
+// instead of walking list.
+static void intersectInto(std::vector<uint32_t> &candidates,
+                          const std::vector<uint32_t> &list) {
+  size_t kept = 0;
+  if (list.size() > candidates.size() * 16) {
+    auto from = list.begin();
+    for (uint32_t doc : candidates) {
+      from = std::lower_bound(from, list.end(), doc);
+      if (from == list.end()) {
+        break;
+      }
+      if (*from == doc) {
+        candidates[kept++] = doc;
+      }
+    }
+  } else {
+    auto it = list.begin();
+    for (uint32_t doc : candidates) {
+      while (it != list.end() && *it < doc) {
+        ++it;
+      }
+      if (it == list.end()) {
+        break;
+      }
+      if (*it == doc) {
+        candidates[kept++] = doc;
+      }
+    }
+  }
+  candidates.resize(kept);
+}
+
+// Returns the length of the shortest posting list among query's trigrams.
+size_t TrigramIndex::estimate(std::string_view query) const {
+  std::vector<uint32_t> grams;
+  trigramsOf(query, grams);
+  size_t shortest = SIZE_MAX;
+  for (uint32_t gram : grams) {
+    auto it = postings.find(gram);
+    if (it == postings.end()) {
+      return 0;
+    }
+    shortest = std::min(shortest, it->second.size());
+  }
+  return grams.empty() ? 0 : shortest;
+}
+
+// Stores every document containing all trigrams of query in out.
+void TrigramIndex::candidates(std::string_view query,
+                              std::vector<uint32_t> &out) const {
+  out.clear();
+
+  std::vector<uint32_t> grams;
+  trigramsOf(query, grams);
+
+  // Intersect the shortest posting lists first to shrink the set quickly.
+  std::vector<const std::vector<uint32_t> *> lists;
+  lists.reserve(grams.size());
+  for (uint32_t gram : grams) {
+    auto it = postings.find(gram);
+    if (it == postings.end()) {
+      return; // Some trigram occurs nowhere, so nothing matches.
+    }
+    lists.push_back(&it->second);
+  }
+  if (lists.empty()) {
+    return;
+  }
+  std::sort(lists.begin(), lists.end(),
+            [](const auto *a, const auto *b) { return a->size() < b->size(); });
+
+  out = *lists[0];
+  for (size_t i = 1; i < lists.size() && !out.empty(); ++i) {
+    intersectInto(out, *lists[i]);
+  }
+}
+
+// Approximate heap memory used by the index: posting storage, one hash node
+// per trigram and the bucket array.
+size_t TrigramIndex::memoryUsage() const {
+  size_t bytes = postings.bucket_count() * sizeof(void *);
+  for (const auto &entry : postings) {
+    bytes += sizeof(entry) + sizeof(void *) +
+             entry.second.capacity() * sizeof(uint32_t);
+  }
+  return bytes;
+}
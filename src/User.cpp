@@ -1,26 +1,33 @@
 #include "User.hpp"
-#include "LibrarySystem.hpp"
 #include <algorithm>
 #include <iostream>
 
 // Constructor to initialize a User object with ID, name, email, and phone.
-User::User(const std::string &id, const std::string &name,
-           const std::string &email, const std::string &phone)
-    : id(id), name(name), email(email), phone(phone) {
-  // No need to set 'id' again; it's already initialized via member initializer
-  // list.
-}
+User::User(std::string_view id, std::string_view name, std::string_view email,
+           std::string_view phone, std::pmr::memory_resource *resource)
+    : text({id, name, email, phone}, resource) {}
+
+std::string User::getId() const { return std::string(text.get(0)); }
+std::string User::getName() const { return std::string(text.get(1)); }
+std::string User::getEmail() const { return std::string(text.get(2)); }
+std::string User::getPhone() const { return std::string(text.get(3)); }
 
-std::string User::getId() const { return id; }
-std::string User::getName() const { return name; }
-std::string User::getEmail() const { return email; }
-std::string User::getPhone() const { return phone; }
+// Non-copying views of the contact fields.
+std::string_view User::getIdView() const { return text.get(0); }
+std::string_view User::getNameView() const { return text.get(1); }
+std::string_view User::getEmailView() const { return text.get(2); }
+std::string_view User::getPhoneView() const { return text.get(3); }
 
 // Returns a list of borrowed books.
 std::vector<std::string> User::getBorrowedBooks() const {
   return borrowedBooks;
 }
 
+// Returns the borrowed list without copying it.
+const std::vector<std::string> &User::getBorrowedBooksView() const {
+  return borrowedBooks;
+}
+
 // Sets the list of borrowed books.
 void User::setBorrowedBooks(const std::vector<std::string> &books) {
   borrowedBooks = books;
@@ -28,28 +35,18 @@ void User::setBorrowedBooks(const std::vector<std::string> &books) {
 
 // Displays user details.
 void User::display() const {
-  std::cout << "User ID: " << id << ", Name: " << name << ", Email: " << email
-            << ", Phone: " << phone << std::endl;
+  std::cout << "User ID: " << getIdView() << ", Name: " << getNameView()
+            << ", Email: " << getEmailView() << ", Phone: " << getPhoneView()
+            << "\n";
 }
 
-// Adds a book to the borrowed books list and updates the book's borrow count in
-// the library system.
+// Adds a book to the borrowed books list with its borrow date. Borrow counts
+// are kept by the library system, so loans restored from storage do not
+// bump them.
 void User::addBorrowedBook(const std::string &bookId,
-                           LibrarySystem &librarySystem) {
+                           const std::chrono::system_clock::time_point &date) {
   borrowedBooks.push_back(bookId);
-
-  // Iterate through library items to find and update the borrowed book's count.
-  for (const auto &item : librarySystem.getItems()) {
-    if (auto book = std::dynamic_pointer_cast<Book>(item)) {
-      if (book->getId() == bookId) {
-        book->incrementBorrowCount(); // Increment the borrow count of the book.
-        break;
-      }
-    }
-  }
-
-  // Record the borrow date for the book.
-  borrowDates[bookId] = std::chrono::system_clock::now();
+  borrowDates[bookId] = date; // Record the borrow date for the book.
 }
 
 // Removes a book from the borrowed books list and clears its borrow date.
@@ -1,13 +1,18 @@
 #include "Book.hpp"
+#include "CommandProcessor.hpp"
+#include "LibraryServer.hpp"
 #include "LibrarySystem.hpp"
 #include "User.hpp"
 #include <chrono>
+#include <csignal>
 #include <cstdlib> // For system("clear") or system("cls")
+#include <filesystem>
+#include <fstream>
 #include <iomanip> // For std::setw
 #include <iostream>
 #include <memory>
+#include <optional>
 #include <string>
-#include <thread>
 #include <vector>
 
 void displayMenu() {
@@ -22,6 +27,15 @@ void displayMenu() {
   std::cout << "8. Get Most Borrowed Books\n";
   std::cout << "9. Get Overdue Books\n";
   std::cout << "10. Test Set Borrowed Book Date\n";
+  std::cout << "11. Get Books Due Soon\n";
+  std::cout << "12. Show Statistics\n";
+  std::cout << "13. Import Books or Users From File\n";
+  std::cout << "14. Export a Listing to a File\n";
+  std::cout << "15. Find Books by Category, Year and Availability\n";
+  std::cout << "16. Count Books by Category and Decade\n";
+  std::cout << "17. Query Books\n";
+  std::cout << "18. Fuzzy Search Books\n";
+  std::cout << "19. Complete a Title or Author\n";
   std::cout << "0. Exit\n";
 }
 
@@ -33,12 +47,200 @@ void clearScreen() {
 #endif
 }
 
-int main() {
-  LibrarySystem librarySystem;
+const std::string booksFile = "./database/books.txt";
+const std::string usersFile = "./database/users.txt";
+const std::string snapshotFile = "./database/library.snap";
+const std::string metricsFile = "./database/metrics.prom";
+const std::string journalFile = "./database/journal.log";
+
+// Returns true if the binary snapshot is at least as new as both text files,
+// i.e. the text files have not been edited since it was written.
+bool snapshotIsCurrent() {
+  namespace fs = std::filesystem;
+  std::error_code ec;
+  auto snapshotTime = fs::last_write_time(snapshotFile, ec);
+  if (ec) {
+    return false;
+  }
+  for (const auto &file : {booksFile, usersFile}) {
+    auto fileTime = fs::last_write_time(file, ec);
+    if (!ec && fileTime > snapshotTime) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Shows listing as a table a screenful at a time, until it ends or the user
+// types q.
+void pageListing(const LibrarySystem &librarySystem, Listing listing,
+                 int parameter) {
+  const size_t pageRecords = 20;
+  RecordWriter writer(std::cout, OutputFormat::Table,
+                      LibrarySystem::listingColumns(listing));
+  ListCursor cursor;
+  while (true) {
+    cursor = librarySystem.writeListingPage(listing, parameter, cursor,
+                                            pageRecords, writer);
+    writer.flush();
+    if (cursor.done) {
+      break;
+    }
+    std::cout << "-- Enter for more, q to stop --";
+    std::string answer;
+    std::getline(std::cin, answer);
+    if (answer == "q") {
+      break;
+    }
+  }
+  if (writer.recordCount() == 0) {
+    std::cout << "(none)\n";
+  }
+}
+
+// Shows books as a table with the columns of the books listing.
+void printBooks(const std::vector<std::shared_ptr<Book>> &books) {
+  RecordWriter writer(std::cout, OutputFormat::Table,
+                      LibrarySystem::listingColumns(Listing::Books));
+  for (const auto &book : books) {
+    writer.text(book->getIdView());
+    writer.text(book->getTitleView());
+    writer.text(book->getAuthorView());
+    writer.text(book->getCategoryView());
+    writer.number(book->getYear());
+    writer.flag(book->isAvailable());
+    writer.number(book->getBorrowCount());
+    writer.endRecord();
+  }
+}
+
+// Reads an optional year; a blank line leaves it unset. Returns false for
+// anything else that is not a number.
+bool readYear(const std::string &prompt, std::optional<int> &year) {
+  std::string line;
+  std::cout << prompt;
+  std::getline(std::cin, line);
+  if (line.empty()) {
+    return true;
+  }
+  try {
+    size_t used;
+    year = std::stoi(line, &used);
+    return used == line.size();
+  } catch (const std::exception &) {
+    return false;
+  }
+}
+
+// Folds the journal back into the files, then refreshes the snapshot so the
+// next start can skip parsing them. The metrics are written last so that
+// they include the save itself.
+void saveDatabase(LibrarySystem &librarySystem) {
+  if (librarySystem.compactJournal(booksFile, usersFile)) {
+    librarySystem.saveSnapshot(snapshotFile);
+  }
+  librarySystem.writeMetricsFile(metricsFile);
+}
+
+// Runs the commands in filename ("-" for standard input) and writes one
+// result line per command to standard output. Returns non-zero if the file
+// cannot be read or the changes could not be committed.
+int runBatchMode(LibrarySystem &librarySystem, const std::string &filename) {
+  std::ifstream file;
+  if (filename != "-") {
+    file.open(filename);
+    if (!file.is_open()) {
+      std::cerr << "Error opening file for reading: " << filename << std::endl;
+      return 1;
+    }
+  }
+  std::istream &in = filename == "-" ? std::cin : file;
+
+  std::ios::sync_with_stdio(false);
+  auto start = std::chrono::steady_clock::now();
+  CommandProcessor processor(librarySystem);
+  BatchResult result = processor.runBatch(in, std::cout);
+  size_t executed = result.executed;
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  std::cerr << "Executed " << executed << " commands in " << elapsed.count()
+            << " s (" << (elapsed.count() > 0 ? executed / elapsed.count() : 0)
+            << " ops/s)" << std::endl;
+  if (!result.committed) {
+    std::cerr << "Error: batch changes could not be committed to the journal"
+              << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+// Server stopped by SIGINT/SIGTERM.
+LibraryServer *activeServer = nullptr;
+
+void stopServer(int) {
+  if (activeServer) {
+    activeServer->stop();
+  }
+}
+
+// Serves kiosk clients until interrupted. target is a Unix socket path, or
+// "tcp:<port>" for a port on 127.0.0.1.
+int runServerMode(LibrarySystem &librarySystem, const std::string &target,
+                  size_t workerThreads) {
+  ServerOptions options;
+  options.workerThreads = workerThreads;
+  if (target.rfind("tcp:", 0) == 0) {
+    options.tcpPort = std::atoi(target.c_str() + 4);
+  } else {
+    options.socketPath = target;
+  }
+
+  LibraryServer server(librarySystem, options);
+  if (!server.start()) {
+    return 1;
+  }
+  activeServer = &server;
+  std::signal(SIGINT, stopServer);
+  std::signal(SIGTERM, stopServer);
+  std::cerr << "Serving on " << target << " (Ctrl-C to stop)" << std::endl;
+  server.run();
+  activeServer = nullptr;
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  // Every book and user lives as long as the library, so keep them in its
+  // arenas and free them together at exit.
+  LibrarySystem librarySystem(StorageMode::Arena);
+
+  // Settle a compaction that a crash cut short before reading its files.
+  LibrarySystem::recoverCompaction(booksFile, usersFile, journalFile);
+
+  // Load existing items, preferring the binary snapshot when it is current
+  if (!snapshotIsCurrent() || !librarySystem.loadSnapshot(snapshotFile)) {
+    librarySystem.loadItemsFromFile(booksFile, false);
+    librarySystem.loadItemsFromFile(usersFile, true);
+  }
+
+  // Replay changes made since the files were last written, then keep
+  // journaling every add, borrow and return.
+  librarySystem.openJournal(journalFile);
+
+  // Non-interactive mode: BookManagement --batch <file|->
+  if (argc >= 2 && std::string(argv[1]) == "--batch") {
+    int status = runBatchMode(librarySystem, argc >= 3 ? argv[2] : "-");
+    saveDatabase(librarySystem);
+    return status;
+  }
 
-  // Load existing items from files
-  librarySystem.loadItemsFromFile("./database/books.txt", false);
-  librarySystem.loadItemsFromFile("./database/users.txt", true);
+  // Server mode: BookManagement --server <socket|tcp:port> [workers]
+  if (argc >= 3 && std::string(argv[1]) == "--server") {
+    size_t workers = argc >= 4 ? std::strtoul(argv[3], nullptr, 10) : 0;
+    int status = runServerMode(librarySystem, argv[2], workers);
+    saveDatabase(librarySystem);
+    return status;
+  }
 
   bool running = true;
   while (running) {
@@ -71,10 +273,15 @@ int main() {
       std::cin >> available;
       std::cin.ignore(); // Clear newline from buffer
 
-      auto book =
-          std::make_shared<Book>(id, title, author, category, year, available);
-      librarySystem.addItem(book);
-      std::cout << "Book added successfully.\n";
+      auto book = librarySystem.createBook(id, title, author, category, year,
+                                           available);
+      if (librarySystem.addItem(book)) {
+        std::cout << "Book added successfully.\n";
+      } else if (librarySystem.hasJournalFailed()) {
+        std::cout << "Failed to add book: the journal cannot be written.\n";
+      } else {
+        std::cout << "A book with ID " << id << " already exists.\n";
+      }
       break;
     }
     case 2: {
@@ -90,9 +297,14 @@ int main() {
       std::cout << "Enter user phone: ";
       std::getline(std::cin, phone);
 
-      auto user = std::make_shared<User>(id, name, email, phone);
-      librarySystem.addItem(user);
-      std::cout << "User added successfully.\n";
+      auto user = librarySystem.createUser(id, name, email, phone);
+      if (librarySystem.addItem(user)) {
+        std::cout << "User added successfully.\n";
+      } else if (librarySystem.hasJournalFailed()) {
+        std::cout << "Failed to add user: the journal cannot be written.\n";
+      } else {
+        std::cout << "A user with ID " << id << " already exists.\n";
+      }
       break;
     }
     case 3: {
@@ -104,44 +316,28 @@ int main() {
       std::cout << "Enter book ID: ";
       std::getline(std::cin, bookId);
 
-      bool success = false;
-      std::shared_ptr<Book> borrowedBook;
-
-      std::thread borrowThread(
-          [&librarySystem, userId, bookId, &success, &borrowedBook]() {
-            success = librarySystem.borrowBook(userId, bookId);
-            if (success) {
-              borrowedBook = librarySystem.findBookById(bookId);
-            }
-          });
-
-      borrowThread.join();
-
-      std::thread printThread([success, borrowedBook, bookId]() {
-        if (success) {
-          std::cout << "Book borrowed successfully.\n";
-          if (borrowedBook) {
-            std::cout << "Details of the borrowed book:\n";
-            std::cout << "Book ID: " << std::setw(10) << borrowedBook->getId()
-                      << ", Title: " << std::setw(20)
-                      << borrowedBook->getTitle()
-                      << ", Author: " << std::setw(20)
-                      << borrowedBook->getAuthor()
-                      << ", Category: " << std::setw(15)
-                      << borrowedBook->getCategory()
-                      << ", Year: " << std::setw(4) << borrowedBook->getYear()
-                      << ", Available: "
-                      << (borrowedBook->isAvailable() ? "Yes" : "No") << "\n";
-          } else {
-            std::cout << "Book with ID " << bookId << " not found.\n";
-          }
+      if (librarySystem.borrowBook(userId, bookId)) {
+        std::cout << "Book borrowed successfully.\n";
+        if (auto borrowedBook = librarySystem.findBookById(bookId)) {
+          std::cout << "Details of the borrowed book:\n";
+          std::cout << "Book ID: " << std::setw(10)
+                    << borrowedBook->getIdView() << ", Title: " << std::setw(20)
+                    << borrowedBook->getTitleView()
+                    << ", Author: " << std::setw(20)
+                    << borrowedBook->getAuthorView()
+                    << ", Category: " << std::setw(15)
+                    << borrowedBook->getCategoryView()
+                    << ", Year: " << std::setw(4) << borrowedBook->getYear()
+                    << ", Available: "
+                    << (borrowedBook->isAvailable() ? "Yes" : "No") << "\n";
         } else {
-          std::cout << "Failed to borrow book.\n";
+          std::cout << "Book with ID " << bookId << " not found.\n";
         }
-      });
-
-      printThread.join();
-
+      } else if (librarySystem.hasJournalFailed()) {
+        std::cout << "Failed to borrow book: the journal cannot be written.\n";
+      } else {
+        std::cout << "Failed to borrow book.\n";
+      }
       break;
     }
 
@@ -154,75 +350,54 @@ int main() {
       std::cout << "Enter book ID: ";
       std::getline(std::cin, bookId);
 
-      bool success = false;
-      std::shared_ptr<Book> returnedBook;
-
-      std::thread returnThread(
-          [&librarySystem, userId, bookId, &success, &returnedBook]() {
-            success = librarySystem.returnBook(userId, bookId);
-            if (success) {
-              returnedBook = librarySystem.findBookById(bookId);
-            }
-          });
-
-      returnThread.join();
-
-      std::thread printThread([success, returnedBook, bookId]() {
-        if (success) {
-          std::cout << "Book returned successfully.\n";
-          if (returnedBook) {
-            std::cout << "Details of the returned book:\n";
-            std::cout << "Book ID: " << std::setw(10) << returnedBook->getId()
-                      << ", Title: " << std::setw(20)
-                      << returnedBook->getTitle()
-                      << ", Author: " << std::setw(20)
-                      << returnedBook->getAuthor()
-                      << ", Category: " << std::setw(15)
-                      << returnedBook->getCategory()
-                      << ", Year: " << std::setw(4) << returnedBook->getYear()
-                      << ", Available: "
-                      << (returnedBook->isAvailable() ? "Yes" : "No") << "\n";
-          } else {
-            std::cout << "Book with ID " << bookId << " not found.\n";
-          }
+      if (librarySystem.returnBook(userId, bookId)) {
+        std::cout << "Book returned successfully.\n";
+        if (auto returnedBook = librarySystem.findBookById(bookId)) {
+          std::cout << "Details of the returned book:\n";
+          std::cout << "Book ID: " << std::setw(10)
+                    << returnedBook->getIdView() << ", Title: " << std::setw(20)
+                    << returnedBook->getTitleView()
+                    << ", Author: " << std::setw(20)
+                    << returnedBook->getAuthorView()
+                    << ", Category: " << std::setw(15)
+                    << returnedBook->getCategoryView()
+                    << ", Year: " << std::setw(4) << returnedBook->getYear()
+                    << ", Available: "
+                    << (returnedBook->isAvailable() ? "Yes" : "No") << "\n";
         } else {
-          std::cout << "Failed to return book.\n";
+          std::cout << "Book with ID " << bookId << " not found.\n";
         }
-      });
-
-      printThread.join();
-
+      } else if (librarySystem.hasJournalFailed()) {
+        std::cout << "Failed to return book: the journal cannot be written.\n";
+      } else {
+        std::cout << "Failed to return book.\n";
+      }
       break;
     }
     case 5: {
-      std::string query, type;
+      std::string query, type, exact;
 
       std::cout << "Enter search query: ";
       std::getline(std::cin, query);
       std::cout << "Enter search type (title, author, category): ";
       std::getline(std::cin, type);
+      std::cout << "Match case and accents exactly? (y/n): ";
+      std::getline(std::cin, exact);
 
-      auto results = librarySystem.searchBooks(query, type);
+      SearchMode mode =
+          exact == "y" ? SearchMode::Exact : SearchMode::Normalized;
       std::cout << "Search Results:\n";
-      for (const auto &book : results) {
-        std::cout << "Book ID: " << std::setw(10) << book->getId()
-                  << ", Title: " << std::setw(20) << book->getTitle()
-                  << ", Author: " << std::setw(20) << book->getAuthor()
-                  << ", Category: " << std::setw(15) << book->getCategory()
-                  << ", Year: " << std::setw(4) << book->getYear()
-                  << ", Available: " << (book->isAvailable() ? "Yes" : "No")
-                  << "\n";
-      }
+      printBooks(librarySystem.searchBooks(query, type, mode));
       break;
     }
     case 6: {
       // Print all books
-      librarySystem.printLibraryItems(1); // 1 = books
+      pageListing(librarySystem, Listing::Books, 0);
       break;
     }
     case 7: {
       // Print all users
-      librarySystem.printLibraryItems(0); // 0 = users
+      pageListing(librarySystem, Listing::Users, 0);
       break;
     }
     case 8: {
@@ -232,15 +407,8 @@ int main() {
       std::cin >> topN;
       std::cin.ignore(); // Clear newline from buffer
 
-      auto mostBorrowedBooks = librarySystem.getMostBorrowedBooks(topN);
       std::cout << "Most Borrowed Books:\n";
-      for (const auto &book : mostBorrowedBooks) {
-        std::cout << "Book ID: " << std::setw(10) << book->getId()
-                  << ", Title: " << std::setw(20) << book->getTitle()
-                  << ", Author: " << std::setw(20) << book->getAuthor()
-                  << ", Borrow Count: " << std::setw(4)
-                  << book->getBorrowCount() << "\n";
-      }
+      pageListing(librarySystem, Listing::MostBorrowed, topN);
       break;
     }
     case 9: {
@@ -250,15 +418,8 @@ int main() {
       std::cin >> days;
       std::cin.ignore(); // Clear newline from buffer
 
-      auto overdueBooks = librarySystem.getOverdueBooks(days);
       std::cout << "Overdue Books:\n";
-      for (const auto &book : overdueBooks) {
-        std::cout << "Book ID: " << std::setw(10) << book->getId()
-                  << ", Title: " << std::setw(20) << book->getTitle()
-                  << ", Author: " << std::setw(20) << book->getAuthor()
-                  << ", Borrow Count: " << std::setw(4)
-                  << book->getBorrowCount() << "\n";
-      }
+      pageListing(librarySystem, Listing::Overdue, days);
       break;
     }
     case 10: {
@@ -269,24 +430,210 @@ int main() {
       std::cout << "Enter book ID to set borrowed date: ";
       std::getline(std::cin, bookId);
 
-      // Find the user by ID from the list of items
-      auto items = librarySystem.getItems();
-      auto userIt = std::find_if(items.begin(), items.end(),
-                                 [&userId](const std::shared_ptr<Item> &item) {
-                                   auto userPtr =
-                                       std::dynamic_pointer_cast<User>(item);
-                                   return userPtr && userPtr->getId() == userId;
-                                 });
-
-      if (userIt != items.end()) {
-        auto user = std::dynamic_pointer_cast<User>(*userIt);
-        // Set the current time as the borrowed date
-        auto now = std::chrono::system_clock::now();
-        user->setBorrowedBookDate(bookId, now);
+      // Set the current time as the borrowed date
+      auto now = std::chrono::system_clock::now();
+      if (librarySystem.setBorrowDate(userId, bookId, now)) {
         std::cout << "Borrowed date set for book ID " << bookId << " by user "
                   << userId << ".\n";
-      } else {
+      } else if (!librarySystem.findUserById(userId)) {
         std::cout << "User with ID " << userId << " not found.\n";
+      } else {
+        std::cout << "User " << userId << " has not borrowed book ID "
+                  << bookId << ".\n";
+      }
+      break;
+    }
+    case 11: {
+      // Get books due soon
+      int days;
+      std::cout << "Enter the number of days ahead: ";
+      std::cin >> days;
+      std::cin.ignore(); // Clear newline from buffer
+
+      std::cout << "Books Due Within " << days << " Days:\n";
+      pageListing(librarySystem, Listing::DueSoon, days);
+      break;
+    }
+    case 12: {
+      // Show operation counters and latencies
+      librarySystem.getMetrics().writeSummary(std::cout);
+      if (librarySystem.writeMetricsFile(metricsFile)) {
+        std::cout << "\nPrometheus metrics written to " << metricsFile << "\n";
+      }
+      break;
+    }
+
+    case 13: {
+      // Bulk import of a books or users file in the data file format
+      std::string filename, type, policy;
+      std::cout << "Enter file to import: ";
+      std::getline(std::cin, filename);
+      std::cout << "Does it hold books or users (b/u): ";
+      std::getline(std::cin, type);
+      std::cout << "Update existing records with the same ID (y/n): ";
+      std::getline(std::cin, policy);
+
+      ImportResult result = librarySystem.importItemsFromFile(
+          filename, type == "u",
+          policy == "y" ? DuplicatePolicy::Upsert : DuplicatePolicy::Reject);
+      std::cout << "Added: " << result.added
+                << ", Updated: " << result.updated
+                << ", Duplicate IDs skipped: " << result.duplicates
+                << ", Invalid records skipped: " << result.invalid << "\n";
+      if (!result.committed) {
+        std::cout << "The import could not be written to the journal.\n";
+      }
+      break;
+    }
+
+    case 14: {
+      // Write a whole listing or report to a file in a chosen format
+      std::string kind, formatName, filename;
+      int parameter = 0;
+      std::cout << "Listing (books, users, most-borrowed, overdue, due): ";
+      std::getline(std::cin, kind);
+      Listing listing;
+      if (kind == "books") {
+        listing = Listing::Books;
+      } else if (kind == "users") {
+        listing = Listing::Users;
+      } else if (kind == "most-borrowed" || kind == "overdue" ||
+                 kind == "due") {
+        listing = kind == "most-borrowed" ? Listing::MostBorrowed
+                  : kind == "overdue"     ? Listing::Overdue
+                                          : Listing::DueSoon;
+        std::cout << (kind == "most-borrowed" ? "Number of books: "
+                                              : "Number of days: ");
+        std::cin >> parameter;
+        std::cin.ignore(); // Clear newline from buffer
+      } else {
+        std::cout << "Unknown listing " << kind << ".\n";
+        break;
+      }
+      OutputFormat format;
+      std::cout << "Format (table, csv, jsonl): ";
+      std::getline(std::cin, formatName);
+      if (!parseOutputFormat(formatName, format)) {
+        std::cout << "Unknown format " << formatName << ".\n";
+        break;
+      }
+      std::cout << "File to write: ";
+      std::getline(std::cin, filename);
+
+      std::ofstream file(filename, std::ios::binary);
+      if (file.is_open() &&
+          librarySystem.exportListing(listing, parameter, file, format)) {
+        std::cout << "Listing written to " << filename << ".\n";
+      } else {
+        std::cout << "Failed to write " << filename << ".\n";
+      }
+      break;
+    }
+
+    case 15: {
+      // Structured query over the year, category and availability indexes
+      BookFilter filter;
+      std::string category, availability;
+      std::cout << "Category (blank for any): ";
+      std::getline(std::cin, category);
+      if (!category.empty()) {
+        filter.category = category;
+      }
+      if (!readYear("Published from year (blank for any): ",
+                    filter.yearFrom) ||
+          !readYear("Published up to year (blank for any): ", filter.yearTo)) {
+        std::cout << "Invalid year.\n";
+        break;
+      }
+      std::cout << "Only available / borrowed books (a/b, blank for any): ";
+      std::getline(std::cin, availability);
+      if (availability == "a" || availability == "b") {
+        filter.available = availability == "a";
+      }
+
+      auto results = librarySystem.findBooks(filter);
+      std::cout << results.size() << " matching books:\n";
+      printBooks(results);
+      break;
+    }
+
+    case 16: {
+      // Facet counts straight from the index counters
+      RecordWriter categories(
+          std::cout, OutputFormat::Table,
+          {{"category", 20}, {"books", 8}, {"available", 9}});
+      for (const auto &count : librarySystem.getCategoryCounts()) {
+        categories.text(count.category);
+        categories.number(static_cast<int64_t>(count.books));
+        categories.number(static_cast<int64_t>(count.available));
+        categories.endRecord();
+      }
+      categories.flush();
+      std::cout << "\n";
+      RecordWriter decades(std::cout, OutputFormat::Table,
+                           {{"decade", 8}, {"books", 8}, {"available", 9}});
+      for (const auto &count : librarySystem.getDecadeCounts()) {
+        decades.text(std::to_string(count.decade) + "s");
+        decades.number(static_cast<int64_t>(count.books));
+        decades.number(static_cast<int64_t>(count.available));
+        decades.endRecord();
+      }
+      break;
+    }
+
+    case 17: {
+      // Conjunctive query through the planner, with its plan shown first
+      std::string text, error;
+      std::cout << "Query, e.g. title ~ night and year >= 1990 and available "
+                   "= true limit 20:\n";
+      std::getline(std::cin, text);
+      BookQuery query;
+      if (!parseBookQuery(text, query, error)) {
+        std::cout << "Invalid query: " << error << ".\n";
+        break;
+      }
+      BookCursor cursor = librarySystem.queryBooks(query);
+      std::cout << cursor.getPlan().explain(query) << "\n";
+      std::vector<std::shared_ptr<Book>> results;
+      while (auto book = cursor.next()) {
+        results.push_back(std::move(book));
+      }
+      std::cout << results.size() << " matching books:\n";
+      printBooks(results);
+      break;
+    }
+
+    case 18: {
+      // Typo-tolerant search, closest ten first
+      std::string query, type;
+      std::cout << "Enter search query: ";
+      std::getline(std::cin, query);
+      std::cout << "Enter search type (title, author): ";
+      std::getline(std::cin, type);
+
+      std::vector<std::shared_ptr<Book>> results;
+      for (auto &match : librarySystem.fuzzySearchBooks(query, type, 10)) {
+        results.push_back(std::move(match.book));
+      }
+      std::cout << "Closest matches:\n";
+      printBooks(results);
+      break;
+    }
+
+    case 19: {
+      // Prefix suggestions, most borrowed ten first
+      std::string prefix, type;
+      std::cout << "Enter the start of a title or author: ";
+      std::getline(std::cin, prefix);
+      std::cout << "Enter completion type (title, author): ";
+      std::getline(std::cin, type);
+
+      auto completions = librarySystem.completeBooks(prefix, type, 10);
+      std::cout << "Suggestions:\n";
+      for (const auto &completion : completions) {
+        std::cout << completion.text << " (" << completion.books
+                  << " books, borrowed " << completion.popularity
+                  << " times)\n";
       }
       break;
     }
@@ -304,9 +651,8 @@ int main() {
     std::cin.get(); // Wait for user input before clearing screen
   }
 
-  // Save items to files before exiting
-  librarySystem.saveItemsToFile("./database/books.txt", false);
-  librarySystem.saveItemsToFile("./database/users.txt", true);
+  // Save everything before exiting
+  saveDatabase(librarySystem);
 
   return 0;
 }
@@ -0,0 +1,336 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Writes synthetic books.txt / users.txt files in the format
+// LibrarySystem::loadItemsFromFile reads.
+//
+//   library_datagen [options] <output-directory>
+//
+// The same options and seed always produce byte-identical files: all
+// randomness comes from a fixed xorshift generator and plain arithmetic
+// rather than std:: distributions, whose output varies between standard
+// libraries. For the same reason borrow dates are relative to --now, which
+// defaults to a fixed date instead of the clock.
+
+struct Options {
+  uint64_t books = 2000000;
+  uint64_t users = 500000;
+  uint64_t seed = 1;
+  uint64_t authors = 50000;
+  uint64_t categories = 200;
+  uint64_t titleWords = 20000;
+  double authorSkew = 1.0;   // Zipf exponents; 0 is uniform.
+  double categorySkew = 1.0;
+  double titleSkew = 1.0;
+  double loansPerUser = 1.5; // Mean open loans per user.
+  uint64_t maxLoans = 10;    // Most open loans one user may have.
+  uint64_t borrowDays = 60;  // Borrow dates fall within this many days.
+  double dateSkew = 2.0;     // 1 spreads dates evenly; larger is more recent.
+  uint64_t maxBorrowCount = 500;
+  int64_t now = 1767225600;  // 2026-01-01T00:00:00Z.
+};
+
+// xorshift64* generator; small, fast and identical on every platform.
+class Random {
+private:
+  uint64_t state;
+
+public:
+  explicit Random(uint64_t seed) : state(seed * 0x9E3779B97F4A7C15ull + 1) {}
+
+  uint64_t next() {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545F4914F6CDD1Dull;
+  }
+
+  // Uniform in [0, 1).
+  double unit() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+
+  // Uniform in [0, bound).
+  uint64_t below(uint64_t bound) {
+    return static_cast<uint64_t>(unit() * static_cast<double>(bound));
+  }
+};
+
+// Samples ranks 0..n-1 with probability proportional to 1 / (rank + 1)^s.
+class Zipf {
+private:
+  std::vector<double> cumulative;
+
+public:
+  Zipf(uint64_t n, double s) : cumulative(n) {
+    double total = 0;
+    for (uint64_t rank = 0; rank < n; ++rank) {
+      total += 1.0 / std::pow(static_cast<double>(rank + 1), s);
+      cumulative[rank] = total;
+    }
+    for (double &value : cumulative) {
+      value /= total;
+    }
+  }
+
+  uint64_t sample(Random &random) const {
+    double target = random.unit();
+    size_t low = 0, high = cumulative.size() - 1;
+    while (low < high) {
+      size_t middle = (low + high) / 2;
+      if (cumulative[middle] <= target) {
+        low = middle + 1;
+      } else {
+        high = middle;
+      }
+    }
+    return low;
+  }
+};
+
+static const char *const syllables[] = {
+    "an",  "ba", "ca", "da", "el", "fa", "go", "ha", "in", "ka", "la",
+    "ma",  "na", "or", "pa", "qui", "ra", "sa", "ta", "un", "va", "wen",
+    "xa",  "yo", "zen", "bri", "cho", "dre", "fli", "gra", "ste", "tho"};
+static const uint64_t syllableCount = sizeof(syllables) / sizeof(syllables[0]);
+
+static const char *const familyNames[] = {
+    "Nguyen", "Tran",   "Le",     "Pham",  "Hoang", "Vu",     "Dang",
+    "Bui",    "Do",     "Ho",     "Ngo",   "Duong", "Ly",     "Smith",
+    "Garcia", "Muller", "Rossi",  "Silva", "Kim",   "Tanaka", "Ivanov",
+    "Dubois", "Novak",  "Jensen", "Brown", "Wilson", "Khan",  "Chen"};
+static const char *const givenNames[] = {
+    "An",    "Binh",  "Chau",  "Dung",   "Hoa",   "Huong", "Khanh", "Lan",
+    "Linh",  "Minh",  "Nam",   "Phuong", "Quang", "Son",   "Thao",  "Tuan",
+    "Anna",  "Ben",   "Clara", "David",  "Elena", "Felix", "Grace", "Hugo",
+    "Ivy",   "Jonas", "Kai",   "Lea",    "Marco", "Nina",  "Omar",  "Paula"};
+static const uint64_t familyCount =
+    sizeof(familyNames) / sizeof(familyNames[0]);
+static const uint64_t givenCount = sizeof(givenNames) / sizeof(givenNames[0]);
+
+// Makes the index-th word from syllables, capitalised.
+static void appendWord(uint64_t index, std::string &out) {
+  size_t start = out.size();
+  do {
+    out += syllables[index % syllableCount];
+    index /= syllableCount;
+  } while (index > 0);
+  out[start] = static_cast<char>(out[start] - 'a' + 'A');
+}
+
+// Makes a distinct author name for every index.
+static void appendAuthor(uint64_t index, std::string &out) {
+  out += givenNames[index % givenCount];
+  out += ' ';
+  out += familyNames[(index / givenCount) % familyCount];
+  uint64_t generation = index / (givenCount * familyCount);
+  if (generation > 0) {
+    out += ' ';
+    appendWord(generation, out);
+  }
+}
+
+// Appends every buffered line to file once the buffer is large.
+static void flushIfFull(std::string &buffer, FILE *file, bool force = false) {
+  if (force || buffer.size() >= (1u << 20)) {
+    std::fwrite(buffer.data(), 1, buffer.size(), file);
+    buffer.clear();
+  }
+}
+
+static void printUsage() {
+  std::cerr
+      << "Usage: library_datagen [options] <output-directory>\n"
+         "  --books N            books to write (2000000)\n"
+         "  --users N            users to write (500000)\n"
+         "  --seed N             random seed (1)\n"
+         "  --authors N          distinct authors (50000)\n"
+         "  --categories N       distinct categories (200)\n"
+         "  --title-words N      title vocabulary size (20000)\n"
+         "  --author-skew S      Zipf exponent of author popularity (1.0)\n"
+         "  --category-skew S    Zipf exponent of category sizes (1.0)\n"
+         "  --title-skew S       Zipf exponent of title word use (1.0)\n"
+         "  --loans-per-user F   mean open loans per user (1.5)\n"
+         "  --max-loans N        most open loans per user (10)\n"
+         "  --borrow-days N      borrow dates span this many days (60)\n"
+         "  --date-skew F        1 = even spread, larger = more recent (2.0)\n"
+         "  --max-borrow-count N largest lifetime borrow count (500)\n"
+         "  --now SECONDS        reference time for borrow dates "
+         "(1767225600)\n";
+}
+
+int main(int argc, char *argv[]) {
+  Options options;
+  std::string directory;
+  for (int i = 1; i < argc; ++i) {
+    std::string option = argv[i];
+    if (option.rfind("--", 0) != 0) {
+      directory = option;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      printUsage();
+      return 1;
+    }
+    const char *value = argv[++i];
+    if (option == "--books") {
+      options.books = std::strtoull(value, nullptr, 10);
+    } else if (option == "--users") {
+      options.users = std::strtoull(value, nullptr, 10);
+    } else if (option == "--seed") {
+      options.seed = std::strtoull(value, nullptr, 10);
+    } else if (option == "--authors") {
+      options.authors = std::strtoull(value, nullptr, 10);
+    } else if (option == "--categories") {
+      options.categories = std::strtoull(value, nullptr, 10);
+    } else if (option == "--title-words") {
+      options.titleWords = std::strtoull(value, nullptr, 10);
+    } else if (option == "--author-skew") {
+      options.authorSkew = std::strtod(value, nullptr);
+    } else if (option == "--category-skew") {
+      options.categorySkew = std::strtod(value, nullptr);
+    } else if (option == "--title-skew") {
+      options.titleSkew = std::strtod(value, nullptr);
+    } else if (option == "--loans-per-user") {
+      options.loansPerUser = std::strtod(value, nullptr);
+    } else if (option == "--max-loans") {
+      options.maxLoans = std::strtoull(value, nullptr, 10);
+    } else if (option == "--borrow-days") {
+      options.borrowDays = std::strtoull(value, nullptr, 10);
+    } else if (option == "--date-skew") {
+      options.dateSkew = std::strtod(value, nullptr);
+    } else if (option == "--max-borrow-count") {
+      options.maxBorrowCount = std::strtoull(value, nullptr, 10);
+    } else if (option == "--now") {
+      options.now = std::strtoll(value, nullptr, 10);
+    } else {
+      printUsage();
+      return 1;
+    }
+  }
+  if (directory.empty() || options.authors == 0 || options.categories == 0 ||
+      options.titleWords == 0) {
+    printUsage();
+    return 1;
+  }
+
+  Random random(options.seed);
+  Zipf authorZipf(options.authors, options.authorSkew);
+  Zipf categoryZipf(options.categories, options.categorySkew);
+  Zipf titleZipf(options.titleWords, options.titleSkew);
+
+  // Each user has maxLoans chances of holding a loan, so the count is
+  // binomial with the requested mean, capped by the books available.
+  double loanChance =
+      options.maxLoans > 0
+          ? std::min(options.loansPerUser / options.maxLoans, 1.0)
+          : 0.0;
+  std::vector<uint32_t> loanCounts(options.users);
+  uint64_t totalLoans = 0;
+  for (auto &count : loanCounts) {
+    for (uint64_t i = 0; i < options.maxLoans; ++i) {
+      count += random.unit() < loanChance;
+    }
+    count = static_cast<uint32_t>(
+        std::min<uint64_t>(count, options.books - totalLoans));
+    totalLoans += count;
+  }
+
+  // Lends distinct books: a partial Fisher-Yates shuffle picks them.
+  std::vector<uint32_t> bookOrder(options.books);
+  for (uint64_t i = 0; i < options.books; ++i) {
+    bookOrder[i] = static_cast<uint32_t>(i);
+  }
+  std::vector<bool> onLoan(options.books);
+  for (uint64_t i = 0; i < totalLoans; ++i) {
+    uint64_t j = i + random.below(options.books - i);
+    std::swap(bookOrder[i], bookOrder[j]);
+    onLoan[bookOrder[i]] = true;
+  }
+
+  std::string booksFile = directory + "/books.txt";
+  std::string usersFile = directory + "/users.txt";
+  FILE *books = std::fopen(booksFile.c_str(), "wb");
+  FILE *users = std::fopen(usersFile.c_str(), "wb");
+  if (!books || !users) {
+    std::cerr << "Error opening files for writing in " << directory
+              << std::endl;
+    return 1;
+  }
+
+  std::string buffer;
+  for (uint64_t i = 0; i < options.books; ++i) {
+    buffer += 'B';
+    buffer += std::to_string(i + 1);
+    buffer += ',';
+    uint64_t wordCount = 1 + random.below(4);
+    for (uint64_t w = 0; w < wordCount; ++w) {
+      if (w > 0) {
+        buffer += ' ';
+      }
+      appendWord(titleZipf.sample(random), buffer);
+    }
+    buffer += ',';
+    appendAuthor(authorZipf.sample(random), buffer);
+    buffer += ",Category ";
+    appendWord(categoryZipf.sample(random), buffer);
+    buffer += ',';
+    buffer += std::to_string(1900 + random.below(126));
+    buffer += onLoan[i] ? ",0," : ",1,";
+    // Lifetime counts are heavily skewed towards zero; lent books have at
+    // least the current loan.
+    double share = random.unit();
+    uint64_t borrowCount = static_cast<uint64_t>(
+        options.maxBorrowCount * share * share * share * share);
+    buffer += std::to_string(borrowCount + (onLoan[i] ? 1 : 0));
+    buffer += '\n';
+    flushIfFull(buffer, books);
+  }
+  flushIfFull(buffer, books, true);
+
+  uint64_t nextLoan = 0;
+  double span = static_cast<double>(options.borrowDays) * 86400.0;
+  for (uint64_t i = 0; i < options.users; ++i) {
+    std::string id = std::to_string(i + 1);
+    buffer += 'U';
+    buffer += id;
+    buffer += ',';
+    appendAuthor(random.below(givenCount * familyCount), buffer);
+    buffer += ",user";
+    buffer += id;
+    buffer += "@example.com,09";
+    std::string phone = std::to_string(random.below(100000000));
+    buffer.append(8 - phone.size(), '0');
+    buffer += phone;
+    buffer += ',';
+    for (uint32_t loan = 0; loan < loanCounts[i]; ++loan) {
+      if (loan > 0) {
+        buffer += ';';
+      }
+      buffer += 'B';
+      buffer += std::to_string(bookOrder[nextLoan++] + 1);
+      buffer += '@';
+      // age = span * u^skew, so skew > 1 favours recent loans.
+      double age = span * std::pow(random.unit(), options.dateSkew);
+      buffer += std::to_string(options.now - static_cast<int64_t>(age));
+    }
+    buffer += '\n';
+    flushIfFull(buffer, users);
+  }
+  flushIfFull(buffer, users, true);
+
+  bool ok = std::fclose(books) == 0;
+  ok = std::fclose(users) == 0 && ok;
+  if (!ok) {
+    std::cerr << "Error writing files in " << directory << std::endl;
+    return 1;
+  }
+  std::cout << "Wrote " << options.books << " books and " << options.users
+            << " users with " << totalLoans << " open loans to " << directory
+            << ".\n";
+  return 0;
+}
@@ -0,0 +1,46 @@
+#include "LibrarySystem.hpp"
+#include <iostream>
+#include <string>
+
+// Converts between the CSV data files and the binary snapshot format.
+//
+//   snapshot_convert to-snapshot <books.txt> <users.txt> <out.snap>
+//   snapshot_convert to-csv <in.snap> <books.txt> <users.txt>
+
+void printUsage() {
+  std::cerr << "Usage:\n"
+            << "  snapshot_convert to-snapshot <books.txt> <users.txt> "
+               "<out.snap>\n"
+            << "  snapshot_convert to-csv <in.snap> <books.txt> <users.txt>\n";
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 5) {
+    printUsage();
+    return 1;
+  }
+
+  const std::string command = argv[1];
+  LibrarySystem librarySystem(StorageMode::Arena); // Loaded once, freed once.
+
+  if (command == "to-snapshot") {
+    librarySystem.loadItemsFromFile(argv[2], false);
+    librarySystem.loadItemsFromFile(argv[3], true);
+    if (!librarySystem.saveSnapshot(argv[4])) {
+      return 1;
+    }
+  } else if (command == "to-csv") {
+    if (!librarySystem.loadSnapshot(argv[2]) ||
+        !librarySystem.saveItemsToFile(argv[3], false) ||
+        !librarySystem.saveItemsToFile(argv[4], true)) {
+      return 1;
+    }
+  } else {
+    printUsage();
+    return 1;
+  }
+
+  std::cout << "Converted " << librarySystem.getBooks().size() << " books and "
+            << librarySystem.getUsers().size() << " users.\n";
+  return 0;
+}